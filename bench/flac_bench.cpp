@@ -0,0 +1,529 @@
+#include "Decode_scheduler.hpp"
+#include "Flac.hpp"
+#include "Mapped_file.hpp"
+#include "Parallel_decoder.hpp"
+#include "Read_ahead_file.hpp"
+#include "Resampler.hpp"
+#include "crc.hpp"
+#include "frame_scanner.hpp"
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#ifndef FLAC_BENCH_AUDIO_DIR
+#define FLAC_BENCH_AUDIO_DIR "audio/input"
+#endif
+
+enum class Input_mode
+{
+    MEMORY,
+    MAPPED,
+    STREAM,
+    ASYNC, ///< Read_ahead_file, io_uring if available.
+    PREAD  ///< Read_ahead_file on the pread thread pool.
+};
+
+struct Bench_input
+{
+    std::string name;
+    std::string path; ///< Empty for generated corpora.
+    std::vector<uint8_t> data;
+};
+
+struct Bench_result
+{
+    uint64_t input_bytes{};
+    uint64_t samples{};
+    double seconds{};
+    Stream_info stream_info{};
+    Stage_timings stages{};
+    Md5_status md5{};
+    uint64_t max_wait_ns{}; ///< Longest time a stream waited for a worker, with --streams.
+    std::string codec_stats; ///< Decode_stats as JSON, with --stats.
+};
+
+std::vector<uint8_t> read_file(const std::string &path)
+{
+    mc::Mapped_file file(path);
+    return {file.bytes().begin(), file.bytes().end()};
+}
+
+void write_utf8_number(std::vector<uint8_t> &out, uint64_t value)
+{
+    if (value < 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value));
+        return;
+    }
+
+    int continuation_bytes = 1;
+    while (continuation_bytes < 6 && value >= (1ULL << (5 * continuation_bytes + 6)))
+    {
+        continuation_bytes++;
+    }
+    out.push_back(static_cast<uint8_t>((0xFF00 >> (continuation_bytes + 1)) | (value >> (6 * continuation_bytes))));
+    for (int i = continuation_bytes - 1; i >= 0; i--)
+    {
+        out.push_back(static_cast<uint8_t>(0x80 | ((value >> (6 * i)) & 0x3F)));
+    }
+}
+
+/**
+ * Builds a longer stream by repeating the full-size frames of a real file, renumbering
+ * every frame and recomputing its CRCs, so the corpus keeps realistic LPC content.
+ */
+std::vector<uint8_t> generate_corpus(std::span<const uint8_t> source, double seconds)
+{
+    mc::Flac decoder(source);
+    decoder.initialize();
+    Stream_info info = decoder.get_stream_info();
+    size_t frames_offset = decoder.get_reader().byte_position();
+    std::vector<mc::Frame_location> frames = mc::scan_frames(source.subspan(frames_offset), info);
+
+    // a shorter final frame may only appear at the end of a fixed-blocksize stream
+    if (frames.size() > 1 && frames.back().block_size != frames.front().block_size)
+    {
+        frames.pop_back();
+    }
+
+    // the marker and STREAMINFO, now flagged as the last metadata block
+    std::vector<uint8_t> corpus(source.begin(), source.begin() + 8 + 34);
+    corpus[4] = 0x80;
+    size_t stream_info_offset = 8;
+
+    uint64_t target_samples = static_cast<uint64_t>(seconds * info.sample_rate);
+    uint64_t samples = 0;
+    uint64_t frame_number = 0;
+    Frame_info header;
+    for (size_t i = 0; samples < target_samples; i = (i + 1) % frames.size(), frame_number++)
+    {
+        std::span<const uint8_t> frame = source.subspan(frames_offset + frames[i].offset, frames[i].size);
+        size_t header_size = mc::parse_frame_header(frame, info, header);
+        size_t number_size = frame[4] < 0x80 ? 1 : std::countl_one(frame[4]);
+
+        size_t start = corpus.size();
+        corpus.insert(corpus.end(), frame.begin(), frame.begin() + 4);
+        write_utf8_number(corpus, header.blocking_strategy ? samples : frame_number);
+        corpus.insert(corpus.end(), frame.begin() + 4 + number_size, frame.begin() + header_size - 1);
+        corpus.push_back(mc::crc8(corpus.data() + start, corpus.size() - start));
+        corpus.insert(corpus.end(), frame.begin() + header_size, frame.end() - 2);
+        uint16_t crc = mc::crc16(corpus.data() + start, corpus.size() - start);
+        corpus.push_back(static_cast<uint8_t>(crc >> 8));
+        corpus.push_back(static_cast<uint8_t>(crc));
+
+        samples += frames[i].block_size;
+    }
+
+    // patch the 36-bit sample count and clear the MD5, which no longer matches
+    uint8_t *total = corpus.data() + stream_info_offset + 13;
+    total[0] = static_cast<uint8_t>((total[0] & 0xF0) | ((samples >> 32) & 0x0F));
+    for (int i = 0; i < 4; i++)
+    {
+        total[1 + i] = static_cast<uint8_t>(samples >> (24 - 8 * i));
+    }
+    std::memset(total + 5, 0, 16);
+    return corpus;
+}
+
+Crc_policy crc_policy = Crc_policy::VERIFY;
+bool check_md5 = false;
+uint32_t resample_rate = 0;
+bool collect_stats = false;
+
+template <typename Input>
+Bench_result decode_input(Input &input)
+{
+    Bench_result result{};
+    mc::Flac decoder(input);
+    decoder.set_crc_policy(crc_policy);
+    decoder.initialize();
+    if (check_md5)
+    {
+        decoder.enable_md5_check();
+    }
+    mc::Decode_stats stats;
+    if (collect_stats)
+    {
+        decoder.set_stats(&stats);
+    }
+    const Stream_info &info = decoder.get_stream_info();
+    if (resample_rate == 0 || resample_rate == info.sample_rate)
+    {
+        while (!decoder.eos())
+        {
+            decoder.decode_frame();
+            result.samples += decoder.get_frame_info().block_size;
+        }
+    }
+    else
+    {
+        // each frame goes through the resampler as the player would do it, into one period-sized buffer
+        mc::Resampler resampler(info.sample_rate, resample_rate, info.channels, info.max_block_size);
+        std::vector<std::byte> period(1024 * info.channels * pcm_format_bytes(Pcm_format::S32_LE));
+        std::array<std::span<const int32_t>, 8> channels;
+        while (!decoder.eos())
+        {
+            decoder.decode_frame();
+            result.samples += decoder.get_frame_info().block_size;
+            for (uint8_t channel = 0; channel < info.channels; channel++)
+            {
+                channels[channel] = decoder.get_channel_samples(channel);
+            }
+            resampler.push(std::span(channels.data(), info.channels), decoder.get_frame_info().bits_per_sample);
+            while (resampler.pull(period, Pcm_format::S32_LE, 1024) == 1024)
+            {
+            }
+        }
+        resampler.finish();
+        while (resampler.pull(period, Pcm_format::S32_LE, 1024) > 0)
+        {
+        }
+    }
+    result.stream_info = decoder.get_stream_info();
+    result.stages = decoder.get_stage_timings();
+    result.md5 = decoder.get_md5_status();
+    if (collect_stats)
+    {
+        mc::append_stats_json(result.codec_stats, stats);
+    }
+    return result;
+}
+
+Bench_result decode_serial(const Bench_input &input, Input_mode mode)
+{
+    Bench_result result{};
+    auto start = std::chrono::steady_clock::now();
+
+    if (mode == Input_mode::MEMORY || input.path.empty())
+    {
+        std::span<const uint8_t> bytes(input.data);
+        result = decode_input(bytes);
+    }
+    else if (mode == Input_mode::MAPPED)
+    {
+        mc::Mapped_file flac_file(input.path);
+        std::span<const uint8_t> bytes = flac_file.bytes();
+        result = decode_input(bytes);
+    }
+    else if (mode == Input_mode::ASYNC || mode == Input_mode::PREAD)
+    {
+        mc::Read_ahead_file flac_file(input.path, mc::Read_ahead_file::default_chunk_size, mc::Read_ahead_file::default_depth,
+                                      mode == Input_mode::PREAD ? mc::Read_ahead_file::Backend::PREAD : mc::Read_ahead_file::Backend::AUTO);
+        result = decode_input(flac_file);
+    }
+    else
+    {
+        std::ifstream flac_stream(input.path, std::ios::binary);
+        if (!flac_stream)
+        {
+            throw std::runtime_error("Cannot open " + input.path);
+        }
+        result = decode_input(flac_stream);
+    }
+
+    result.input_bytes = input.data.size();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+Bench_result decode_parallel(const Bench_input &input, size_t threads)
+{
+    Bench_result result{};
+    auto start = std::chrono::steady_clock::now();
+
+    mc::Parallel_decoder decoder(input.data, threads);
+    decoder.initialize();
+    std::vector<std::byte> pcm(decoder.pcm_bytes(Pcm_format::S32_LE));
+    decoder.decode(pcm, Pcm_format::S32_LE);
+    result.samples = decoder.get_total_samples();
+    result.stream_info = decoder.get_stream_info();
+
+    result.input_bytes = input.data.size();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+Bench_result decode_streams(const Bench_input &input, size_t streams, size_t threads)
+{
+    Bench_result result{};
+    auto start = std::chrono::steady_clock::now();
+
+    mc::Scheduler_config config;
+    config.thread_count = threads;
+    config.format = Pcm_format::S32_LE;
+    config.crc_policy = crc_policy;
+    mc::Decode_scheduler scheduler(config);
+
+    std::vector<mc::Decode_scheduler::Stream_id> ids;
+    for (size_t i = 0; i < streams; i++)
+    {
+        ids.push_back(scheduler.open_stream(input.data));
+    }
+
+    // one consumer drains every stream round-robin, blocking on the first one behind
+    std::vector<std::byte> period(config.period_frames * scheduler.frame_bytes(ids[0]));
+    std::vector<bool> finished(streams);
+    size_t remaining = streams;
+    while (remaining > 0)
+    {
+        for (size_t i = 0; i < streams; i++)
+        {
+            size_t frames;
+            if (!finished[i] && scheduler.read_period(ids[i], period, frames))
+            {
+                result.samples += frames;
+                if (frames == 0)
+                {
+                    finished[i] = true;
+                    remaining--;
+                }
+            }
+        }
+    }
+
+    for (auto id : ids)
+    {
+        result.max_wait_ns = std::max(result.max_wait_ns, scheduler.get_stream_stats(id).max_wait_ns);
+    }
+    result.stream_info = scheduler.get_stream_info(ids[0]);
+    result.input_bytes = input.data.size() * streams;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+const char *md5_status_name(Md5_status status)
+{
+    switch (status)
+    {
+    case Md5_status::NO_SIGNATURE:
+        return "none";
+    case Md5_status::MATCH:
+        return "match";
+    case Md5_status::MISMATCH:
+        return "mismatch";
+    default:
+        return "unchecked";
+    }
+}
+
+std::string json_string(const std::string &text)
+{
+    std::string escaped = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = 5;
+    size_t threads = 0;
+    size_t streams = 0;
+    bool parallel = false;
+    Input_mode mode = Input_mode::MEMORY;
+    double corpus_seconds = 60;
+    std::string json_path;
+    std::string label;
+    std::vector<std::string> filenames;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "-n" && i + 1 < argc)
+        {
+            iterations = std::stoi(argv[++i]);
+        }
+        else if (argument == "-j" && i + 1 < argc)
+        {
+            threads = std::stoul(argv[++i]);
+            parallel = true;
+        }
+        else if (argument == "--streams" && i + 1 < argc)
+        {
+            streams = std::stoul(argv[++i]);
+        }
+        else if (argument == "--input" && i + 1 < argc)
+        {
+            std::string name = argv[++i];
+            mode = name == "mmap"     ? Input_mode::MAPPED
+                   : name == "stream" ? Input_mode::STREAM
+                   : name == "async"  ? Input_mode::ASYNC
+                   : name == "pread"  ? Input_mode::PREAD
+                                      : Input_mode::MEMORY;
+        }
+        else if (argument == "--crc" && i + 1 < argc)
+        {
+            crc_policy = std::string(argv[++i]) == "ignore" ? Crc_policy::IGNORE : Crc_policy::VERIFY;
+        }
+        else if (argument == "--md5")
+        {
+            check_md5 = true;
+        }
+        else if (argument == "--stats")
+        {
+            collect_stats = true;
+        }
+        else if (argument == "--resample" && i + 1 < argc)
+        {
+            resample_rate = std::stoul(argv[++i]);
+        }
+        else if (argument == "--corpus" && i + 1 < argc)
+        {
+            corpus_seconds = std::stod(argv[++i]);
+        }
+        else if (argument == "--json" && i + 1 < argc)
+        {
+            json_path = argv[++i];
+        }
+        else if (argument == "--label" && i + 1 < argc)
+        {
+            label = argv[++i];
+        }
+        else
+        {
+            filenames.push_back(argument);
+        }
+    }
+
+    if (filenames.empty())
+    {
+        filenames = {FLAC_BENCH_AUDIO_DIR "/8bit.flac", FLAC_BENCH_AUDIO_DIR "/12bit.flac",
+                     FLAC_BENCH_AUDIO_DIR "/16bit.flac", FLAC_BENCH_AUDIO_DIR "/24bit.flac"};
+    }
+
+    bool md5_mismatch = false;
+    std::ostringstream json;
+    json << "{\n  \"label\": " << json_string(label) << ",\n  \"iterations\": " << iterations
+         << ",\n  \"threads\": " << (parallel || streams > 0 ? threads : 1)
+         << ",\n  \"streams\": " << std::max<size_t>(streams, 1)
+         << ",\n  \"crc\": " << (crc_policy == Crc_policy::IGNORE ? "false" : "true") << ",\n  \"results\": [";
+
+    try
+    {
+        std::vector<Bench_input> inputs;
+        for (const auto &filename : filenames)
+        {
+            inputs.push_back({filename, filename, read_file(filename)});
+        }
+        if (corpus_seconds > 0)
+        {
+            size_t file_count = inputs.size();
+            for (size_t i = 0; i < file_count; i++)
+            {
+                std::string name = "generated:" + std::filesystem::path(inputs[i].name).filename().string() + ":" +
+                                   std::to_string(static_cast<int>(corpus_seconds)) + "s";
+                inputs.push_back({name, "", generate_corpus(inputs[i].data, corpus_seconds)});
+            }
+        }
+
+        for (size_t index = 0; index < inputs.size(); index++)
+        {
+            const Bench_input &input = inputs[index];
+            auto run = [&]
+            {
+                if (streams > 0)
+                {
+                    return decode_streams(input, streams, threads);
+                }
+                return parallel ? decode_parallel(input, threads) : decode_serial(input, mode);
+            };
+
+            // the first run only warms up caches
+            run();
+
+            Bench_result best{};
+            for (int i = 0; i < iterations; i++)
+            {
+                Bench_result result = run();
+                if (i == 0 || result.seconds < best.seconds)
+                {
+                    best = result;
+                }
+            }
+
+            const Stream_info &info = best.stream_info;
+            const Stage_timings &stages = best.stages;
+            double pcm_bytes = static_cast<double>(best.samples) * info.channels * ((info.bits_per_sample + 7) / 8);
+            double samples_per_second = best.samples / best.seconds;
+            double realtime = samples_per_second / info.sample_rate;
+            uint64_t other_stages_ns = stages.residual_ns + stages.prediction_ns + stages.decorrelation_ns;
+            uint64_t bit_reading_ns = stages.frame_ns - std::min(stages.frame_ns, other_stages_ns);
+
+            std::cout << input.name << ": " << samples_per_second / 1e6 << " Msamples/s, "
+                      << best.input_bytes / best.seconds / 1e6 << " MB/s flac in, "
+                      << pcm_bytes / best.seconds / 1e6 << " MB/s pcm out, "
+                      << realtime << "x realtime (" << best.seconds * 1e3 << " ms)";
+            if (streams > 0)
+            {
+                std::cout << ", max worker wait " << best.max_wait_ns / 1e6 << " ms";
+            }
+            if (check_md5 && !parallel && streams == 0)
+            {
+                std::cout << ", MD5 " << md5_status_name(best.md5);
+                md5_mismatch |= best.md5 == Md5_status::MISMATCH;
+            }
+            std::cout << '\n';
+            if (stages.frame_ns > 0)
+            {
+                std::cout << "    bit reading " << bit_reading_ns / 1e6 << " ms, residuals " << stages.residual_ns / 1e6
+                          << " ms, prediction " << stages.prediction_ns / 1e6 << " ms, decorrelation "
+                          << stages.decorrelation_ns / 1e6 << " ms\n";
+            }
+
+            json << (index == 0 ? "\n" : ",\n")
+                 << "    {\"name\": " << json_string(input.name)
+                 << ", \"bits_per_sample\": " << static_cast<int>(info.bits_per_sample)
+                 << ", \"channels\": " << static_cast<int>(info.channels)
+                 << ", \"sample_rate\": " << info.sample_rate
+                 << ", \"samples\": " << best.samples
+                 << ", \"input_bytes\": " << best.input_bytes
+                 << ", \"seconds\": " << best.seconds
+                 << ", \"samples_per_second\": " << samples_per_second
+                 << ", \"flac_mb_per_second\": " << best.input_bytes / best.seconds / 1e6
+                 << ", \"pcm_mb_per_second\": " << pcm_bytes / best.seconds / 1e6
+                 << ", \"realtime\": " << realtime
+                 << ", \"md5\": \"" << md5_status_name(best.md5) << '"'
+                 << ", \"max_wait_ns\": " << best.max_wait_ns
+                 << ", \"stages_ns\": {\"bit_reading\": " << bit_reading_ns
+                 << ", \"residuals\": " << stages.residual_ns
+                 << ", \"prediction\": " << stages.prediction_ns
+                 << ", \"decorrelation\": " << stages.decorrelation_ns << '}';
+            if (!best.codec_stats.empty())
+            {
+                json << ", \"codec\": " << best.codec_stats;
+            }
+            json << '}';
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    json << "\n  ]\n}\n";
+    if (!json_path.empty())
+    {
+        std::ofstream json_file(json_path);
+        json_file << json.str();
+        if (!json_file)
+        {
+            std::cerr << "Error: cannot write " << json_path << '\n';
+            return 1;
+        }
+    }
+
+    return md5_mismatch ? 1 : 0;
+}
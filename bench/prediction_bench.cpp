@@ -0,0 +1,219 @@
+#include "Flac_constants.hpp"
+#include "predictors.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+constexpr size_t block_size = 4096;
+constexpr size_t block_count = 256;
+constexpr uint8_t channels = 2;
+
+struct Test_signal
+{
+    std::vector<int32_t> samples;
+    std::vector<int32_t> residuals;
+    int32_t coefficients[32]{};
+    uint8_t order{};
+    uint8_t shift{};
+    uint8_t bits_per_sample{};
+};
+
+// The generic loop Flac::linear_prediction used before the specialized kernels:
+// interleaved int64 samples, stride and division by the channel count in the inner loop.
+void reference_linear_prediction(std::vector<int64_t> &buffer, uint8_t channel_index, uint8_t predictor_order,
+                                 const int16_t *predictor_coefficients, int8_t qlp_shift)
+{
+    for (uint16_t i = channels * predictor_order; i < buffer.size(); i += channels)
+    {
+        int64_t prediction{};
+        for (uint16_t j = 0; j < channels * predictor_order; j += channels)
+        {
+            prediction += buffer[i - channels - j + channel_index] * predictor_coefficients[j / channels];
+        }
+        buffer[i + channel_index] += (prediction >> qlp_shift);
+    }
+}
+
+// Quantized Levinson-Durbin predictor of a noisy two-tone signal, so the restored
+// values stay within bits_per_sample like those of a real encoder would.
+Test_signal make_signal(uint8_t order, uint8_t bits_per_sample, bool fixed)
+{
+    Test_signal signal;
+    signal.order = order;
+    signal.bits_per_sample = bits_per_sample;
+
+    std::mt19937 generator(order * 97 + bits_per_sample);
+    std::normal_distribution<double> noise(0.0, 0.01);
+    double peak = std::ldexp(1.0, bits_per_sample - 1) - 1;
+    std::vector<double> signal_double(block_size);
+    signal.samples.resize(block_size);
+    for (size_t i = 0; i < block_size; i++)
+    {
+        signal_double[i] = 0.45 * std::sin(i * 0.031) + 0.3 * std::sin(i * 0.173 + 1.0) + noise(generator);
+        signal.samples[i] = static_cast<int32_t>(std::lround(signal_double[i] * peak));
+    }
+
+    if (fixed)
+    {
+        for (uint8_t j = 0; j < order; j++)
+        {
+            signal.coefficients[j] = Flac_constants::fixed_prediction_coefficients[order][j];
+        }
+    }
+    else
+    {
+        std::vector<double> autocorrelation(order + 1);
+        for (size_t lag = 0; lag <= order; lag++)
+        {
+            for (size_t i = lag; i < block_size; i++)
+            {
+                autocorrelation[lag] += signal_double[i] * signal_double[i - lag];
+            }
+        }
+        autocorrelation[0] *= 1.0001;
+
+        std::vector<double> lpc(order), previous(order);
+        double error = autocorrelation[0];
+        for (uint8_t i = 0; i < order; i++)
+        {
+            double reflection = autocorrelation[i + 1];
+            for (uint8_t j = 0; j < i; j++)
+            {
+                reflection -= lpc[j] * autocorrelation[i - j];
+            }
+            reflection /= error;
+            previous = lpc;
+            lpc[i] = reflection;
+            for (uint8_t j = 0; j < i; j++)
+            {
+                lpc[j] = previous[j] - reflection * previous[i - 1 - j];
+            }
+            error *= 1 - reflection * reflection;
+        }
+
+        double largest = 0;
+        for (double coefficient : lpc)
+        {
+            largest = std::max(largest, std::abs(coefficient));
+        }
+        int exponent = 0;
+        std::frexp(largest, &exponent);
+        signal.shift = static_cast<uint8_t>(std::clamp(11 - exponent, 0, 15));
+        for (uint8_t j = 0; j < order; j++)
+        {
+            signal.coefficients[j] = static_cast<int32_t>(std::lround(std::ldexp(lpc[j], signal.shift)));
+        }
+    }
+
+    signal.residuals = signal.samples;
+    for (size_t i = order; i < block_size; i++)
+    {
+        int64_t prediction = 0;
+        for (uint8_t j = 0; j < order; j++)
+        {
+            prediction += static_cast<int64_t>(signal.coefficients[j]) * signal.samples[i - 1 - j];
+        }
+        signal.residuals[i] = static_cast<int32_t>(signal.samples[i] - (prediction >> signal.shift));
+    }
+    return signal;
+}
+
+template <typename Function>
+double time_per_sample(Function &&restore)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < block_count; i++)
+    {
+        restore();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (block_count * block_size);
+}
+
+int main()
+{
+    const mc::Simd_level levels[] = {mc::Simd_level::SCALAR, mc::Simd_level::SSE4_1, mc::Simd_level::AVX2};
+    const char *level_names[] = {"scalar", "sse4.1", "avx2"};
+    mc::Simd_level detected = mc::detect_simd_level();
+    bool all_match = true;
+
+    std::cout << "ns/sample    kind  bps order   reference";
+    for (mc::Simd_level level : levels)
+    {
+        if (level <= detected)
+        {
+            std::cout << "  " << level_names[static_cast<int>(level)];
+        }
+    }
+    std::cout << '\n';
+
+    for (uint8_t bits_per_sample : {16, 24})
+    {
+        for (uint8_t order : {1, 2, 3, 4, 6, 8, 12, 16, 20, 24, 32})
+        {
+            for (bool fixed : {true, false})
+            {
+                if (fixed && order > 4)
+                {
+                    continue;
+                }
+
+                Test_signal signal = make_signal(order, bits_per_sample, fixed);
+
+                int16_t reference_coefficients[32]{};
+                for (uint8_t j = 0; j < order; j++)
+                {
+                    reference_coefficients[j] = static_cast<int16_t>(signal.coefficients[j]);
+                }
+                std::vector<int64_t> interleaved(block_size * channels);
+                double reference_time = time_per_sample([&]
+                                                        {
+                    for (size_t i = 0; i < block_size; i++)
+                    {
+                        interleaved[i * channels] = signal.residuals[i];
+                    }
+                    reference_linear_prediction(interleaved, 0, order, reference_coefficients, signal.shift); });
+
+                std::cout << "         " << (fixed ? "fixed" : "  lpc") << "   " << +bits_per_sample
+                          << "    " << (order < 10 ? " " : "") << +order << "   " << reference_time;
+
+                for (mc::Simd_level level : levels)
+                {
+                    if (level > detected)
+                    {
+                        continue;
+                    }
+                    mc::set_simd_level(level);
+
+                    std::vector<int32_t> restored(block_size);
+                    double kernel_time = time_per_sample([&]
+                                                         {
+                        std::copy(signal.residuals.begin(), signal.residuals.end(), restored.begin());
+                        if (fixed)
+                        {
+                            mc::restore_fixed(restored.data(), block_size, order, bits_per_sample);
+                        }
+                        else
+                        {
+                            mc::restore_lpc(restored.data(), block_size, signal.coefficients, order, signal.shift, bits_per_sample);
+                        } });
+
+                    bool match = restored == signal.samples;
+                    for (size_t i = 0; i < block_size; i++)
+                    {
+                        match = match && interleaved[i * channels] == signal.samples[i];
+                    }
+                    all_match = all_match && match;
+                    std::cout << "  " << kernel_time << (match ? "" : " MISMATCH");
+                }
+                std::cout << '\n';
+            }
+        }
+    }
+
+    mc::set_simd_level(detected);
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace mc
+{
+    /**
+     * @brief Allocator returning storage aligned to a cache line (or any power of two).
+     *
+     * Used for the decoder's sample buffers so that every channel starts on its own
+     * cache line and vector loads never straddle two lines at the start of a channel.
+     *
+     * @tparam T The element type.
+     * @tparam Alignment The alignment in bytes.
+     */
+    template <typename T, size_t Alignment = 64>
+    struct Aligned_allocator
+    {
+        using value_type = T;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = Aligned_allocator<U, Alignment>;
+        };
+
+        Aligned_allocator() noexcept = default;
+
+        template <typename U>
+        Aligned_allocator(const Aligned_allocator<U, Alignment> &) noexcept {}
+
+        T *allocate(size_t count)
+        {
+            return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t{Alignment}));
+        }
+
+        void deallocate(T *pointer, size_t) noexcept
+        {
+            ::operator delete(pointer, std::align_val_t{Alignment});
+        }
+
+        template <typename U>
+        bool operator==(const Aligned_allocator<U, Alignment> &) const noexcept { return true; }
+    };
+} // namespace mc
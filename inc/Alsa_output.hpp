@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Decode_stats.hpp"
+#include "Flac_types.hpp"
+
+struct _snd_pcm;
+
+namespace mc
+{
+    /**
+     * @brief An ALSA playback device opened for interleaved PCM.
+     *
+     * Wraps the hardware parameter setup and the write/recover loop, so callers only
+     * deal with whole buffers of frames. Every write is timed, so the latency of the
+     * device can be watched from another thread through get_stats().
+     */
+    class Alsa_output
+    {
+    private:
+        _snd_pcm *m_handle{};
+        Pcm_format m_format{};
+        uint8_t m_channels{};
+        uint32_t m_sample_rate{};
+        size_t m_buffer_frames{};
+        Output_stats m_stats;
+
+    public:
+        /**
+         * @brief Opens and configures a playback device.
+         *
+         * If the device cannot take `format`, S32_LE is used instead.
+         *
+         * @param device The ALSA device name (e.g. "default").
+         * @param format The preferred sample format.
+         * @param channels The number of interleaved channels.
+         * @param sample_rate The requested sample rate; the device may pick a nearby one, since
+         *                    ALSA's own rate conversion is turned off.
+         * @throws std::runtime_error If the device cannot be opened or configured.
+         */
+        Alsa_output(const std::string &device, Pcm_format format, uint8_t channels, uint32_t sample_rate);
+
+        /**
+         * @brief Closes the device without draining it.
+         */
+        ~Alsa_output();
+
+        Alsa_output(const Alsa_output &) = delete;
+        Alsa_output &operator=(const Alsa_output &) = delete;
+
+        /**
+         * @brief Gets the sample format the device was configured with.
+         */
+        Pcm_format get_format() const { return m_format; }
+
+        /**
+         * @brief Gets the sample rate the device actually runs at.
+         */
+        uint32_t get_sample_rate() const { return m_sample_rate; }
+
+        /**
+         * @brief Gets the size of the device buffer in frames.
+         */
+        size_t get_buffer_frames() const { return m_buffer_frames; }
+
+        /**
+         * @brief Gets the number of device underruns recovered from so far.
+         */
+        uint64_t get_underruns() const { return m_stats.underruns.get(); }
+
+        /**
+         * @brief Gets the counters of the writes so far. Safe to read from any thread.
+         */
+        const Output_stats &get_stats() const { return m_stats; }
+
+        /**
+         * @brief Writes interleaved frames, blocking until the device took all of them.
+         *
+         * Underruns are recovered from and counted.
+         *
+         * @param data The interleaved samples in get_format().
+         * @param frames The number of frames to write.
+         * @return False if the device failed and could not be recovered.
+         */
+        bool write(const std::byte *data, size_t frames);
+
+        /**
+         * @brief Blocks until everything written so far has been played.
+         */
+        void drain();
+    };
+} // namespace mc
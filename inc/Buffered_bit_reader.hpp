@@ -0,0 +1,754 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "Read_ahead_file.hpp"
+#include "crc.hpp"
+
+namespace mc
+{
+    /**
+     * @brief A bit reader operating on a contiguous window of bytes.
+     *
+     * Unlike Bit_reader, which pulls every byte through the stream, this reader consumes
+     * a contiguous byte window and refills its 64-bit bit buffer with a single byte-swapped
+     * load. Only the last few bytes of a window go through a bounds-checked byte-wise path.
+     * The window is either a span supplied by the caller (e.g. a whole file in memory or
+     * a mapping), a large chunk read from a stream, refilled when it runs out, or a chunk
+     * of a Read_ahead_file, consumed in place while the next ones are read asynchronously.
+     */
+    class Buffered_bit_reader
+    {
+    private:
+        static constexpr size_t default_chunk_size = 1 << 16;
+
+        const uint8_t *m_data{};
+        size_t m_size{};
+        size_t m_position{};
+        uint64_t m_window_offset{}; ///< Input offset of the first byte of the window.
+        uint64_t m_bit_buffer{};
+        uint8_t m_bits_in_buffer{};
+        std::istream *m_stream{};
+        Read_ahead_file *m_file{};
+        std::vector<uint8_t> m_chunk;
+        std::vector<uint8_t> m_scratch;
+        bool m_stream_exhausted{true};
+        bool m_overrun{}; ///< Set by the non-throwing reads when they ran past the end of the input.
+
+        // running frame checksums, folded in whenever consumed bytes are about to leave the window
+        bool m_crc_active{};
+        bool m_crc8_active{};
+        uint8_t m_crc8{};
+        uint16_t m_crc16{};
+        size_t m_crc_position{}; ///< First byte of the window not yet folded into the CRCs.
+        uint8_t m_crc_carry[8]{}; ///< Bytes of an earlier window not yet folded, oldest first.
+        size_t m_crc_carry_size{};
+
+        static uint64_t load_big_endian_64(const uint8_t *data)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                word = __builtin_bswap64(word);
+            }
+            return word;
+        }
+
+        void crc_fold(const uint8_t *data, size_t size)
+        {
+            m_crc16 = crc16_update(m_crc16, data, size);
+            if (m_crc8_active)
+            {
+                m_crc8 = crc8_update(m_crc8, data, size);
+            }
+        }
+
+        /**
+         * @brief Folds every byte read since the last fold into the CRCs.
+         *
+         * Whole bytes still sitting in the bit buffer have not been consumed and are
+         * left for the next fold; a partially read byte counts as consumed.
+         */
+        void crc_fold_consumed()
+        {
+            size_t pending = m_crc_carry_size + (m_position - m_crc_position) - m_bits_in_buffer / 8;
+            size_t from_carry = std::min(pending, m_crc_carry_size);
+            crc_fold(m_crc_carry, from_carry);
+            std::memmove(m_crc_carry, m_crc_carry + from_carry, m_crc_carry_size - from_carry);
+            m_crc_carry_size -= from_carry;
+
+            crc_fold(m_data + m_crc_position, pending - from_carry);
+            m_crc_position += pending - from_carry;
+        }
+
+        /**
+         * @brief Reads the next chunk of the underlying stream or file into the window.
+         *
+         * @return True if at least one byte was read, false if there is no more data.
+         */
+        bool fetch_chunk()
+        {
+            if ((m_stream == nullptr && m_file == nullptr) || m_stream_exhausted)
+            {
+                return false;
+            }
+
+            if (m_crc_active)
+            {
+                // the unread tail of this window lives on in the bit buffer; keep a copy to fold later
+                crc_fold_consumed();
+                size_t tail = m_size - m_crc_position;
+                std::memcpy(m_crc_carry + m_crc_carry_size, m_data + m_crc_position, tail);
+                m_crc_carry_size += tail;
+                m_crc_position = 0;
+            }
+
+            if (m_file != nullptr)
+            {
+                std::span<const uint8_t> chunk = m_file->next_chunk();
+                m_window_offset += m_size;
+                m_data = chunk.data();
+                m_size = chunk.size();
+                m_position = 0;
+                m_stream_exhausted = chunk.empty() || m_file->at_end();
+                return !chunk.empty();
+            }
+
+            m_stream->read(reinterpret_cast<char *>(m_chunk.data()), m_chunk.size());
+            size_t bytes_read = m_stream->gcount();
+
+            m_window_offset += m_size;
+            m_data = m_chunk.data();
+            m_size = bytes_read;
+            m_position = 0;
+            m_stream_exhausted = bytes_read < m_chunk.size() || m_stream->peek() == EOF;
+
+            return bytes_read > 0;
+        }
+
+        void clear_input()
+        {
+            m_data = nullptr;
+            m_size = 0;
+            m_position = 0;
+            m_window_offset = 0;
+            m_bit_buffer = 0;
+            m_bits_in_buffer = 0;
+            m_stream = nullptr;
+            m_file = nullptr;
+            m_stream_exhausted = true;
+            m_overrun = false;
+            m_crc_active = false;
+            m_crc8_active = false;
+            m_crc_carry_size = 0;
+        }
+
+        /**
+         * @brief Bounds-checked refill used near the end of the window.
+         */
+        void refill_slow()
+        {
+            while (m_bits_in_buffer <= 56)
+            {
+                if (m_position == m_size && !fetch_chunk())
+                {
+                    break;
+                }
+                m_bit_buffer = (m_bit_buffer << 8) | m_data[m_position++];
+                m_bits_in_buffer += 8;
+            }
+        }
+
+        /**
+         * @brief Tops up the bit buffer to at least 56 bits if the input allows it.
+         *
+         * Must only be called with fewer than 56 bits in the buffer.
+         */
+        void refill()
+        {
+            if (m_size - m_position >= 8)
+            {
+                uint8_t bytes = (63 - m_bits_in_buffer) >> 3;
+                uint64_t word = load_big_endian_64(m_data + m_position);
+                m_bit_buffer = (m_bit_buffer << (bytes * 8)) | (word >> (64 - bytes * 8));
+                m_position += bytes;
+                m_bits_in_buffer += bytes * 8;
+            }
+            else
+            {
+                refill_slow();
+            }
+        }
+
+    public:
+        /**
+         * @brief Constructs a reader over a contiguous byte buffer.
+         *
+         * The buffer must outlive the reader.
+         *
+         * @param data The bytes to read from.
+         */
+        explicit Buffered_bit_reader(std::span<const uint8_t> data)
+            : m_data(data.data()), m_size(data.size()) {}
+
+        /**
+         * @brief Constructs a reader that pulls chunks of the given size from a stream.
+         *
+         * @param stream The input stream to read from.
+         * @param chunk_size The number of bytes read from the stream at once.
+         */
+        explicit Buffered_bit_reader(std::istream &stream, size_t chunk_size = default_chunk_size)
+            : m_stream(&stream), m_chunk(chunk_size), m_stream_exhausted(false) {}
+
+        /**
+         * @brief Constructs a reader over a file read ahead asynchronously.
+         *
+         * The chunks of the file become the window without being copied.
+         *
+         * @param file The file to read from; must outlive the reader.
+         */
+        explicit Buffered_bit_reader(Read_ahead_file &file)
+            : m_file(&file), m_stream_exhausted(file.size() == 0) {}
+
+        /**
+         * @brief Sizes the read-ahead of a Read_ahead_file input for a FLAC stream.
+         *
+         * Does nothing for other inputs.
+         *
+         * @param stream_info The stream information of the stream being read.
+         */
+        void tune_read_ahead(const Stream_info &stream_info)
+        {
+            if (m_file != nullptr)
+            {
+                m_file->tune(stream_info);
+            }
+        }
+
+        /**
+         * @brief Switches the reader to a contiguous byte buffer, keeping its scratch buffers.
+         *
+         * @param data The bytes to read from; must outlive the reader.
+         */
+        void open(std::span<const uint8_t> data)
+        {
+            clear_input();
+            m_data = data.data();
+            m_size = data.size();
+        }
+
+        /**
+         * @brief Switches the reader to a file read ahead asynchronously.
+         *
+         * @param file The file to read from; must outlive the reader.
+         */
+        void open(Read_ahead_file &file)
+        {
+            clear_input();
+            m_file = &file;
+            m_stream_exhausted = file.size() == 0;
+        }
+
+        /**
+         * @brief Checks if the end of the input has been reached.
+         *
+         * @return True if no whole byte is left to read, false otherwise.
+         */
+        bool eos() const
+        {
+            return m_bits_in_buffer < 8 && m_position == m_size && m_stream_exhausted;
+        }
+
+        /**
+         * @brief Gets the input offset of the byte holding the next unread bit.
+         *
+         * @return The number of whole bytes consumed since the start of the input.
+         */
+        uint64_t byte_position() const
+        {
+            return m_window_offset + m_position - (m_bits_in_buffer + 7) / 8;
+        }
+
+        /**
+         * @brief Gets the input offset of the next unread bit, in bits.
+         *
+         * @return The number of bits consumed since the start of the input.
+         */
+        uint64_t bit_position() const
+        {
+            return (m_window_offset + m_position) * 8 - m_bits_in_buffer;
+        }
+
+        /**
+         * @brief Reads an unsigned integer without any checks, for the decoding hot path.
+         *
+         * Reading past the end of the input does not throw: the missing bits read as
+         * zero and overrun() turns true, so a caller can validate a whole frame once.
+         *
+         * @param num_bits The number of bits to read, between 1 and 56.
+         * @return The unsigned integer read from the input.
+         */
+        uint64_t read_bits(uint8_t num_bits)
+        {
+            if (m_bits_in_buffer < num_bits)
+            {
+                refill();
+                if (m_bits_in_buffer < num_bits)
+                {
+                    m_overrun = true;
+                    m_bits_in_buffer = 0;
+                    return 0;
+                }
+            }
+
+            m_bits_in_buffer -= num_bits;
+            return (m_bit_buffer >> m_bits_in_buffer) & ((1ULL << num_bits) - 1);
+        }
+
+        /**
+         * @brief Checks if a non-throwing read ran past the end of the input.
+         *
+         * @return True if some bits read since the last seek were missing.
+         */
+        bool overrun() const { return m_overrun; }
+
+        /**
+         * @brief Reads an unsigned integer from the input with the specified number of bits.
+         *
+         * Checked wrapper around read_bits(), used where speed does not matter.
+         *
+         * @param num_bits The number of bits to read (must be between 0 and 64).
+         * @return The unsigned integer read from the input.
+         * @throws std::invalid_argument If num_bits is not between 0 and 64.
+         * @throws std::runtime_error If the end of the input is reached.
+         */
+        uint64_t read_bits_unsigned(uint8_t num_bits)
+        {
+            if (num_bits > 64)
+            {
+                throw std::invalid_argument("Number of bits to read must be between 1 and 64.");
+            }
+
+            if (num_bits == 0)
+            {
+                return 0;
+            }
+
+            if (num_bits > 56)
+            {
+                uint64_t high = read_bits_unsigned(num_bits - 32);
+                return (high << 32) | read_bits_unsigned(32);
+            }
+
+            uint64_t result = read_bits(num_bits);
+            if (m_overrun)
+            {
+                m_overrun = false;
+                throw std::runtime_error("End of stream reached.");
+            }
+            return result;
+        }
+
+        /**
+         * @brief Reads a signed (two's complement) integer with the specified number of bits.
+         *
+         * Like read_bits(), does not check for the end of the input.
+         *
+         * @param num_bits The number of bits to read, between 0 and 56.
+         * @return The signed integer read from the input.
+         */
+        int64_t read_bits_signed(uint8_t num_bits)
+        {
+            if (num_bits == 0)
+            {
+                return 0;
+            }
+
+            uint64_t result = read_bits(num_bits);
+            return static_cast<int64_t>(result << (64 - num_bits)) >> (64 - num_bits);
+        }
+
+        /**
+         * @brief Reads a unary coded integer (n zero bits followed by a one bit).
+         *
+         * The zero run is measured with a count-leading-zeros on the bit buffer
+         * instead of reading the bits one at a time.
+         *
+         * Does not check for the end of the input, see read_bits().
+         *
+         * @return The number of zero bits before the terminating one bit.
+         */
+        uint64_t read_unary()
+        {
+            uint64_t result = 0;
+            while (true)
+            {
+                if (m_bits_in_buffer == 0)
+                {
+                    refill();
+                    if (m_bits_in_buffer == 0)
+                    {
+                        m_overrun = true;
+                        return result;
+                    }
+                }
+
+                uint64_t window = m_bit_buffer << (64 - m_bits_in_buffer);
+                if (window != 0)
+                {
+                    uint8_t zeros = std::countl_zero(window);
+                    m_bits_in_buffer -= zeros + 1;
+                    return result + zeros;
+                }
+                result += m_bits_in_buffer;
+                m_bits_in_buffer = 0;
+            }
+        }
+
+        /**
+         * @brief Decodes a run of Rice coded residuals, unfolding them to signed values.
+         *
+         * The whole partition is decoded in one loop that keeps the bit buffer in
+         * locals and only leaves it to refill.
+         *
+         * @tparam Sample The integer type of the destination samples.
+         * @param destination The first sample to write.
+         * @param count The number of residuals to decode.
+         * @param stride The distance between consecutive destination samples.
+         * @param rice_parameter The Rice parameter of the partition (at most 30).
+         *
+         * Stops early and sets overrun() if the end of the input is reached.
+         */
+        template <typename Sample>
+        void read_rice_block(Sample *destination, size_t count, size_t stride, uint8_t rice_parameter)
+        {
+            uint64_t bit_buffer = m_bit_buffer;
+            uint8_t bits_in_buffer = m_bits_in_buffer;
+            const uint64_t remainder_mask = (1ULL << rice_parameter) - 1;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                uint64_t quotient = 0;
+                while (true)
+                {
+                    uint64_t window = bits_in_buffer == 0 ? 0 : bit_buffer << (64 - bits_in_buffer);
+                    if (window != 0)
+                    {
+                        uint8_t zeros = std::countl_zero(window);
+                        quotient += zeros;
+                        bits_in_buffer -= zeros + 1;
+                        break;
+                    }
+
+                    quotient += bits_in_buffer;
+                    m_bits_in_buffer = 0;
+                    refill();
+                    if (m_bits_in_buffer == 0)
+                    {
+                        m_overrun = true;
+                        return;
+                    }
+                    bit_buffer = m_bit_buffer;
+                    bits_in_buffer = m_bits_in_buffer;
+                }
+
+                if (bits_in_buffer < rice_parameter)
+                {
+                    m_bit_buffer = bit_buffer;
+                    m_bits_in_buffer = bits_in_buffer;
+                    refill();
+                    if (m_bits_in_buffer < rice_parameter)
+                    {
+                        m_overrun = true;
+                        m_bits_in_buffer = 0;
+                        return;
+                    }
+                    bit_buffer = m_bit_buffer;
+                    bits_in_buffer = m_bits_in_buffer;
+                }
+
+                bits_in_buffer -= rice_parameter;
+                uint64_t folded = (quotient << rice_parameter) | ((bit_buffer >> bits_in_buffer) & remainder_mask);
+                destination[i * stride] = static_cast<Sample>((folded >> 1) ^ (0 - (folded & 1)));
+            }
+
+            m_bit_buffer = bit_buffer;
+            m_bits_in_buffer = bits_in_buffer;
+        }
+
+        /**
+         * @brief Reads a run of signed integers of a fixed bit width.
+         *
+         * Used for escaped Rice partitions, where the residuals are stored verbatim.
+         *
+         * @tparam Sample The integer type of the destination samples.
+         * @param destination The first sample to write.
+         * @param count The number of values to read.
+         * @param stride The distance between consecutive destination samples.
+         * @param num_bits The width of every value (0 means all values are zero).
+         *
+         * Does not check for the end of the input, see read_bits().
+         */
+        template <typename Sample>
+        void read_signed_block(Sample *destination, size_t count, size_t stride, uint8_t num_bits)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                destination[i * stride] = static_cast<Sample>(read_bits_signed(num_bits));
+            }
+        }
+
+        /**
+         * @brief Reads a 32-bit little-endian integer, as used by VORBIS_COMMENT blocks.
+         *
+         * The reader must be aligned to a byte boundary.
+         *
+         * @return The integer read from the input.
+         */
+        uint32_t read_uint32_le()
+        {
+            return __builtin_bswap32(static_cast<uint32_t>(read_bits_unsigned(32)));
+        }
+
+        /**
+         * @brief Copies raw bytes from the input, stopping early at its end.
+         *
+         * The reader must be aligned to a byte boundary.
+         *
+         * @param destination The buffer to copy into.
+         * @param count The maximum number of bytes to copy.
+         * @return The number of bytes copied.
+         */
+        size_t read_some_bytes(uint8_t *destination, size_t count)
+        {
+            size_t copied = 0;
+            while (copied < count && m_bits_in_buffer >= 8)
+            {
+                destination[copied++] = static_cast<uint8_t>(read_bits(8));
+            }
+
+            while (copied < count)
+            {
+                if (m_position == m_size && !fetch_chunk())
+                {
+                    break;
+                }
+                size_t available = std::min(count - copied, m_size - m_position);
+                std::memcpy(destination + copied, m_data + m_position, available);
+                m_position += available;
+                copied += available;
+            }
+            return copied;
+        }
+
+        /**
+         * @brief Reads raw bytes without copying them when they are contiguous in the window.
+         *
+         * Always zero-copy for span (e.g. memory-mapped) input. Stream input falls back to
+         * copying into an internal buffer when the bytes straddle two chunks. The reader
+         * must be aligned to a byte boundary.
+         *
+         * @param count The number of bytes to read.
+         * @return The bytes, valid until the next call on this reader.
+         * @throws std::runtime_error If the end of the input is reached.
+         */
+        std::span<const uint8_t> read_view(size_t count)
+        {
+            // bytes already in the bit buffer were loaded from the window and can be re-read there
+            size_t buffered = m_bits_in_buffer / 8;
+            if (m_bits_in_buffer % 8 == 0 && m_position >= buffered && m_size - (m_position - buffered) >= count)
+            {
+                m_position -= buffered;
+                m_bit_buffer = 0;
+                m_bits_in_buffer = 0;
+
+                std::span<const uint8_t> view(m_data + m_position, count);
+                m_position += count;
+                return view;
+            }
+
+            m_scratch.resize(count);
+            read_bytes(m_scratch.data(), count);
+            return m_scratch;
+        }
+
+        /**
+         * @brief Copies raw bytes from the input.
+         *
+         * The reader must be aligned to a byte boundary.
+         *
+         * @param destination The buffer to copy into.
+         * @param count The number of bytes to copy.
+         * @throws std::runtime_error If the end of the input is reached.
+         */
+        void read_bytes(uint8_t *destination, size_t count)
+        {
+            if (read_some_bytes(destination, count) < count)
+            {
+                throw std::runtime_error("End of stream reached.");
+            }
+        }
+
+        /**
+         * @brief Skips raw bytes of the input without reading them.
+         *
+         * The reader must be aligned to a byte boundary. Skips that reach past the
+         * current window seek the underlying stream instead of reading it.
+         *
+         * @param count The number of bytes to skip.
+         */
+        void skip_bytes(size_t count)
+        {
+            while (count > 0 && m_bits_in_buffer >= 8)
+            {
+                m_bits_in_buffer -= 8;
+                count--;
+            }
+
+            size_t available = std::min(count, m_size - m_position);
+            m_position += available;
+            count -= available;
+
+            if (count > 0 && m_file != nullptr && !m_stream_exhausted)
+            {
+                m_file->seek(m_window_offset + m_size + count);
+                m_window_offset += count;
+                m_stream_exhausted = m_file->at_end();
+            }
+            else if (count > 0 && m_stream != nullptr && !m_stream_exhausted)
+            {
+                m_stream->seekg(count, std::ios::cur);
+                m_window_offset += count;
+                m_stream_exhausted = m_stream->peek() == EOF;
+            }
+        }
+
+        /**
+         * @brief Moves the reader to a byte offset of the input, dropping buffered bits.
+         *
+         * @param offset The offset from the start of the input.
+         */
+        void seek(uint64_t offset)
+        {
+            m_bit_buffer = 0;
+            m_bits_in_buffer = 0;
+            m_crc_active = false;
+            m_overrun = false;
+
+            if (m_file != nullptr)
+            {
+                m_file->seek(offset);
+                m_window_offset = offset;
+                m_size = 0;
+                m_position = 0;
+                m_stream_exhausted = m_file->at_end();
+                return;
+            }
+
+            if (m_stream == nullptr)
+            {
+                m_position = std::min<uint64_t>(offset, m_size);
+                return;
+            }
+
+            m_stream->clear();
+            m_stream->seekg(offset);
+            m_window_offset = offset;
+            m_data = m_chunk.data();
+            m_size = 0;
+            m_position = 0;
+            m_stream_exhausted = m_stream->peek() == EOF;
+        }
+
+        /**
+         * @brief Gets the total size of the input in bytes.
+         */
+        uint64_t input_size()
+        {
+            if (m_file != nullptr)
+            {
+                return m_file->size();
+            }
+            if (m_stream == nullptr)
+            {
+                return m_size;
+            }
+
+            m_stream->clear();
+            std::streampos position = m_stream->tellg();
+            m_stream->seekg(0, std::ios::end);
+            uint64_t size = m_stream->tellg();
+            m_stream->seekg(position);
+            return size;
+        }
+
+        /**
+         * @brief Starts computing the FLAC CRC-8 and CRC-16 over the bytes read from here on.
+         *
+         * The bytes are checksummed in bulk when they are about to leave the window (or
+         * when a CRC is requested), so checking costs one pass over bytes that are still
+         * in cache. The reader must be aligned to a byte boundary.
+         */
+        void start_crc()
+        {
+            size_t buffered = m_bits_in_buffer / 8;
+            m_crc_active = true;
+            m_crc8_active = true;
+            m_crc8 = 0;
+            m_crc16 = 0;
+            m_crc_carry_size = 0;
+            m_crc_position = m_position - std::min(buffered, m_position);
+
+            // after a refill across chunks, the oldest unread bytes are only in the bit buffer
+            for (size_t i = 0; i + m_position < buffered; i++)
+            {
+                m_crc_carry[m_crc_carry_size++] = static_cast<uint8_t>(m_bit_buffer >> (m_bits_in_buffer - 8 * (i + 1)));
+            }
+        }
+
+        /**
+         * @brief Gets the CRC-8 of the bytes read since start_crc() and stops computing it.
+         *
+         * The CRC-16 goes on, so the header CRC-8 can be checked before the frame body is read.
+         *
+         * @return The CRC-8 of the bytes read so far.
+         */
+        uint8_t finish_crc8()
+        {
+            crc_fold_consumed();
+            m_crc8_active = false;
+            return m_crc8;
+        }
+
+        /**
+         * @brief Gets the CRC-16 of the bytes read since start_crc() and stops computing it.
+         *
+         * @return The CRC-16 of the bytes read so far.
+         */
+        uint16_t finish_crc16()
+        {
+            crc_fold_consumed();
+            m_crc_active = false;
+            return m_crc16;
+        }
+
+        /**
+         * @brief Aligns the bit reader to the next byte boundary.
+         *
+         * This method discards any remaining bits in the buffer that do not
+         * align to a full byte.
+         */
+        void align_to_byte()
+        {
+            m_bits_in_buffer -= m_bits_in_buffer % 8;
+        }
+    };
+} // namespace mc
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Flac.hpp"
+#include "Flac_types.hpp"
+#include "Mapped_file.hpp"
+#include "Spsc_ring.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Sizing of a Decode_scheduler and the streams it decodes.
+     */
+    struct Scheduler_config
+    {
+        size_t thread_count{};                       ///< Worker threads, 0 for one per hardware thread.
+        size_t max_streams{};                        ///< Streams open at once, 0 for no limit.
+        size_t period_frames{4096};                  ///< Frames per output queue slot.
+        size_t queue_periods{8};                     ///< Slots per stream output queue (rounded up to a power of two).
+        Pcm_format format{Pcm_format::S16_LE};       ///< PCM format of the output queues.
+        Crc_policy crc_policy{Crc_policy::CONCEAL};  ///< How damaged frames are handled.
+    };
+
+    /**
+     * @brief A snapshot of one stream's counters.
+     */
+    struct Stream_stats
+    {
+        size_t queue_capacity{};      ///< Number of output queue slots.
+        size_t queue_depth{};         ///< Periods currently queued.
+        size_t max_queue_depth{};     ///< Highest number of periods queued so far.
+        size_t buffer_bytes{};        ///< Memory held by the output queue.
+        uint64_t frames_decoded{};    ///< FLAC frames decoded.
+        uint64_t periods_queued{};    ///< Periods the workers have queued.
+        uint64_t periods_read{};      ///< Periods the consumer has taken.
+        uint64_t backpressure_stalls{}; ///< Times the stream was parked on a full output queue.
+        uint64_t decode_ns{};         ///< Time spent decoding, summed over all frames.
+        uint64_t max_decode_ns{};     ///< Longest single frame decode.
+        uint64_t wait_ns{};           ///< Time spent ready to run but waiting for a worker, summed.
+        uint64_t max_wait_ns{};       ///< Longest wait for a worker.
+        bool finished{};              ///< The end of the stream has been queued.
+    };
+
+    /**
+     * @brief Decodes many FLAC streams concurrently on a fixed number of worker threads.
+     *
+     * Every stream gets its own decoder and a bounded output queue of PCM periods,
+     * both allocated when it is opened. Ready streams wait in a single FIFO run queue;
+     * a worker takes the stream at the front, decodes at most one frame into its output
+     * queue and puts it at the back again, so streams take turns frame by frame and no
+     * stream starves. A stream whose output queue is full is parked until its consumer
+     * reads a period, so slow consumers cost no worker time (backpressure).
+     *
+     * Each stream has a single consumer; different streams can be read from different
+     * threads.
+     */
+    class Decode_scheduler
+    {
+    public:
+        using Stream_id = uint64_t;
+
+    private:
+        struct Period
+        {
+            std::vector<std::byte> data;
+            size_t frames{}; ///< 0 marks the end of the stream.
+        };
+
+        struct Stream
+        {
+            std::unique_ptr<Mapped_file> file;
+            std::unique_ptr<Flac> decoder;
+            Spsc_ring<Period> queue;
+            size_t frame_bytes{};
+            uint16_t frame_position{};
+            uint16_t frame_samples{};
+            size_t period_fill{};          ///< Frames already in the slot being filled.
+            bool parked{};                 ///< Waiting for a free slot; guarded by the scheduler mutex.
+            bool closed{};                 ///< Guarded by the scheduler mutex.
+            std::chrono::steady_clock::time_point ready_since;
+            std::exception_ptr error;      ///< Set before the end marker is queued.
+            std::atomic<bool> finished{};
+            std::atomic<uint64_t> max_queue_depth{};
+            std::atomic<uint64_t> frames_decoded{};
+            std::atomic<uint64_t> periods_queued{};
+            std::atomic<uint64_t> periods_read{};
+            std::atomic<uint64_t> backpressure_stalls{};
+            std::atomic<uint64_t> decode_ns{};
+            std::atomic<uint64_t> max_decode_ns{};
+            std::atomic<uint64_t> wait_ns{};
+            std::atomic<uint64_t> max_wait_ns{};
+
+            explicit Stream(size_t queue_periods) : queue(queue_periods) {}
+        };
+
+        Scheduler_config m_config;
+        std::unordered_map<Stream_id, std::shared_ptr<Stream>> m_streams;
+        std::deque<std::shared_ptr<Stream>> m_run_queue;
+        std::vector<std::thread> m_threads;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_stream_ready;
+        Stream_id m_next_id{1};
+        bool m_stopping{};
+
+        Stream_id add_stream(std::unique_ptr<Mapped_file> file, std::span<const uint8_t> data);
+        std::shared_ptr<Stream> find_stream(Stream_id id) const;
+        bool run_step(Stream &stream);
+        void worker_loop();
+
+    public:
+        /**
+         * @brief Starts the worker threads.
+         *
+         * @param config The thread count and the sizing of every stream.
+         */
+        explicit Decode_scheduler(const Scheduler_config &config = {});
+
+        /**
+         * @brief Stops the workers; streams still open are abandoned.
+         */
+        ~Decode_scheduler();
+
+        Decode_scheduler(const Decode_scheduler &) = delete;
+        Decode_scheduler &operator=(const Decode_scheduler &) = delete;
+
+        /**
+         * @brief Gets the number of worker threads.
+         */
+        size_t get_thread_count() const { return m_threads.size(); }
+
+        /**
+         * @brief Opens a FLAC file and starts decoding it.
+         *
+         * The metadata is read on the calling thread; the frames are decoded by the workers.
+         *
+         * @param path The file to open.
+         * @return The id of the new stream.
+         * @throws std::runtime_error If the file is not a valid FLAC file or max_streams are open.
+         */
+        Stream_id open_stream(const std::string &path);
+
+        /**
+         * @brief Starts decoding a FLAC file held in memory.
+         *
+         * @param data The whole FLAC file; must outlive the stream.
+         * @return The id of the new stream.
+         * @throws std::runtime_error If the data is not a valid FLAC file or max_streams are open.
+         */
+        Stream_id open_stream(std::span<const uint8_t> data);
+
+        /**
+         * @brief Stops decoding a stream and releases it.
+         *
+         * Must not be called while the stream is being read.
+         *
+         * @param id The stream to close; unknown ids are ignored.
+         */
+        void close_stream(Stream_id id);
+
+        /**
+         * @brief Gets the number of bytes one sample of every channel of a stream takes.
+         *
+         * @throws std::invalid_argument If the stream is not open.
+         */
+        size_t frame_bytes(Stream_id id) const { return find_stream(id)->frame_bytes; }
+
+        /**
+         * @brief Gets the stream information of a stream.
+         *
+         * @throws std::invalid_argument If the stream is not open.
+         */
+        const Stream_info &get_stream_info(Stream_id id) const { return find_stream(id)->decoder->get_stream_info(); }
+
+        /**
+         * @brief Takes the next period of a stream from its output queue.
+         *
+         * @param id The stream to read.
+         * @param destination The buffer to copy to, at least period_frames * frame_bytes(id) bytes large.
+         * @param frames Set to the number of samples per channel copied; 0 at the end of the stream.
+         * @param wait Whether to block until a period is queued.
+         * @return False if wait is false and no period is queued yet.
+         * @throws std::invalid_argument If the stream is not open or the destination is too small.
+         * @throws std::runtime_error If the stream was damaged and the CRC policy does not recover.
+         */
+        bool read_period(Stream_id id, std::span<std::byte> destination, size_t &frames, bool wait = true);
+
+        /**
+         * @brief Gets a snapshot of a stream's counters. Safe to call from any thread.
+         *
+         * @throws std::invalid_argument If the stream is not open.
+         */
+        Stream_stats get_stream_stats(Stream_id id) const;
+
+        /**
+         * @brief Gets the number of streams waiting for a worker.
+         */
+        size_t get_run_queue_depth() const
+        {
+            std::lock_guard lock(m_mutex);
+            return m_run_queue.size();
+        }
+    };
+} // namespace mc
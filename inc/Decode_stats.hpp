@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mc
+{
+    /**
+     * @brief A counter written by a single thread and readable from any thread.
+     *
+     * An update is a relaxed load and store rather than a locked read-modify-write,
+     * so counting costs about as much as incrementing a plain integer, while a reader
+     * on another thread still sees every value whole. Each thread therefore owns its
+     * counters, and totals over threads are summed by the reader.
+     */
+    class Stat_counter
+    {
+    private:
+        std::atomic<uint64_t> m_value{};
+
+    public:
+        /**
+         * @brief Adds to the counter; only the owning thread may call it.
+         */
+        void add(uint64_t amount) { m_value.store(m_value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); }
+
+        /**
+         * @brief Raises the counter to a value if it is below it; only the owning thread may call it.
+         */
+        void raise_to(uint64_t value)
+        {
+            if (value > m_value.load(std::memory_order_relaxed))
+            {
+                m_value.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief Gets the current value. Safe to call from any thread.
+         */
+        uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+    };
+
+    /**
+     * @brief Counts values by their order of magnitude: bucket i holds values in [2^(i-1), 2^i).
+     */
+    struct Log2_histogram
+    {
+        static constexpr size_t bucket_count = 32;
+        std::array<Stat_counter, bucket_count> buckets;
+
+        void record(uint64_t value) { buckets[std::min<size_t>(std::bit_width(value), bucket_count - 1)].add(1); }
+    };
+
+    /**
+     * @brief What one decoder thread spent its time and bits on, collected by Flac::set_stats().
+     *
+     * The bits of a frame are split into its header, the subframe headers with the
+     * warm-up samples, LPC coefficients and constant or verbatim samples, the residuals,
+     * and the footer (byte padding and CRC-16).
+     */
+    struct Decode_stats
+    {
+        Stat_counter frames;
+        Stat_counter samples;                       ///< Samples per channel decoded.
+        Stat_counter frame_ns;                      ///< Total time in decode_frame().
+        Stat_counter max_frame_ns;
+        Log2_histogram frame_time;                  ///< Frames by decode time in ns.
+        Stat_counter constant_subframes;
+        Stat_counter verbatim_subframes;
+        std::array<Stat_counter, 5> fixed_subframes; ///< By predictor order.
+        std::array<Stat_counter, 33> lpc_subframes;  ///< By predictor order, 1 to 32.
+        std::array<Stat_counter, 16> partition_orders; ///< Residual blocks by Rice partition order.
+        Stat_counter escaped_partitions;            ///< Partitions stored as plain binary.
+        Stat_counter header_bits;
+        Stat_counter subframe_bits;
+        Stat_counter residual_bits;
+        Stat_counter footer_bits;
+
+        /**
+         * @brief Adds another thread's counters to these; only the owning thread may call it.
+         */
+        void add(const Decode_stats &other);
+    };
+
+    /**
+     * @brief Device writes of one output thread.
+     */
+    struct Output_stats
+    {
+        Stat_counter writes;
+        Stat_counter frames;       ///< Frames written.
+        Stat_counter write_ns;     ///< Total time blocked in writes.
+        Stat_counter max_write_ns;
+        Log2_histogram write_time; ///< Writes by latency in ns.
+        Stat_counter underruns;    ///< Underruns the device reported and recovered from.
+
+        /**
+         * @brief Adds another thread's counters to these; only the owning thread may call it.
+         */
+        void add(const Output_stats &other);
+    };
+
+    /**
+     * @brief Appends the counters as a JSON object.
+     *
+     * Histograms become arrays of bucket counts with trailing empty buckets dropped.
+     */
+    void append_stats_json(std::string &out, const Decode_stats &stats);
+
+    /**
+     * @brief Appends the counters as a JSON object.
+     */
+    void append_stats_json(std::string &out, const Output_stats &stats);
+} // namespace mc
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "Flac.hpp"
+#include "Read_ahead_file.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Keeps idle Flac decoders so that opening a file reuses the buffers of an earlier one.
+     *
+     * Meant for workloads that open many files in turn, such as library scans. A handle
+     * returns its decoder to the pool when it goes out of scope, where it waits to be
+     * reset for the next file. Safe to use from any number of threads; the pool must
+     * outlive its handles.
+     */
+    class Decoder_pool
+    {
+    public:
+        /**
+         * @brief Deleter returning a decoder to its pool.
+         */
+        struct Releaser
+        {
+            Decoder_pool *pool{};
+
+            void operator()(Flac *decoder) const { pool->release(decoder); }
+        };
+
+        using Handle = std::unique_ptr<Flac, Releaser>;
+
+    private:
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<Flac>> m_idle;
+        size_t m_max_idle{};
+
+        void release(Flac *decoder);
+        std::unique_ptr<Flac> take_idle();
+
+    public:
+        /**
+         * @brief Constructs an empty pool.
+         *
+         * @param max_idle The number of idle decoders kept, 0 for no limit; further
+         *                 returned decoders are destroyed.
+         */
+        explicit Decoder_pool(size_t max_idle = 0) : m_max_idle(max_idle) {}
+
+        /**
+         * @brief Gets a decoder for a file held in memory and reads its metadata.
+         *
+         * @param data The whole FLAC file; must outlive the handle.
+         * @return The initialized decoder; the CRC policy can still be set before decoding.
+         * @throws std::runtime_error If the data is not a valid FLAC file; the decoder goes back to the pool.
+         */
+        Handle acquire(std::span<const uint8_t> data);
+
+        /**
+         * @brief Gets a decoder for a file read ahead asynchronously and reads its metadata.
+         *
+         * @param input The file to read; must outlive the handle.
+         * @return The initialized decoder.
+         * @throws std::runtime_error If the file is not a valid FLAC file; the decoder goes back to the pool.
+         */
+        Handle acquire(Read_ahead_file &input);
+
+        /**
+         * @brief Gets the number of decoders waiting to be reused.
+         */
+        size_t get_idle_count()
+        {
+            std::lock_guard lock(m_mutex);
+            return m_idle.size();
+        }
+    };
+} // namespace mc
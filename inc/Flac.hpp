@@ -1,13 +1,23 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
+#include <memory>
+#include <span>
 #include <unordered_map>
 #include <vector>
 
-#include "Bit_reader.hpp"
+#include "Aligned_allocator.hpp"
+#include "Buffered_bit_reader.hpp"
+#include "Decode_stats.hpp"
 #include "Flac_constants.hpp"
 #include "Flac_types.hpp"
+#include "Md5_worker.hpp"
+#include "Metadata_arena.hpp"
 #include "decoders.hpp"
+#include "metadata.hpp"
+#include "predictors.hpp"
 namespace mc
 {
     /**
@@ -19,15 +29,47 @@ namespace mc
     class Flac
     {
     private:
+        enum class Frame_status : uint8_t
+        {
+            DECODED,
+            DROPPED, ///< Failed its CRC-16 and was skipped.
+            CORRUPT  ///< Could not be decoded; the reader has to resynchronize.
+        };
+
         uint8_t m_channel_index{};
         uint64_t m_sample_count{};
         uint64_t m_frame_count{};
         Stream_info m_stream_info{};
         Frame_info m_frame_info{};
+        Metadata_arena m_metadata_arena;
         Vorbis_comment m_vorbis_comment;
-        std::ifstream &m_flac_stream;
-        Bit_reader<std::ifstream> m_reader;
+        std::vector<Picture> m_pictures;
+        Cue_sheet m_cue_sheet;
+        std::vector<Seek_point> m_seek_table;
+        std::vector<uint8_t> m_header_window; ///< Input searched for frame headers when seeking or resynchronizing.
+        uint64_t m_first_frame_offset{};
+        std::ifstream *m_flac_stream{};
+        Buffered_bit_reader m_reader;
+        std::vector<int32_t, Aligned_allocator<int32_t>> m_channel_samples;
+        size_t m_channel_stride{};
+        std::vector<int64_t> m_wide_subframe_buffer;
         std::vector<buffer_sample_type> m_audio_buffer;
+        bool m_audio_buffer_valid{};
+        Stage_timings m_stage_timings{};
+        Decode_stats *m_stats{};
+        uint64_t m_residual_bits{}; ///< Residual bits of the frame being read, while collecting statistics.
+        Crc_policy m_crc_policy{Crc_policy::VERIFY};
+        Decode_errors m_decode_errors{};
+        uint64_t m_next_sample{};     ///< First sample of the frame after the last one decoded.
+        uint64_t m_pending_silence{}; ///< Concealed samples still to be output.
+        uint64_t m_range_start{};     ///< First sample of the selected range.
+        uint64_t m_range_end{UINT64_MAX}; ///< Sample after the selected range.
+        bool m_frame_pending{};       ///< The current frame has not been handed out by decode_frame() yet.
+        const char *m_error{};        ///< Why the last subframe failed to decode.
+        bool m_md5_check{};
+        uint64_t m_md5_samples{};
+        Md5_status m_md5_status{Md5_status::UNCHECKED};
+        std::unique_ptr<Md5_worker> m_md5_worker; ///< Started by the first enable_md5_check(), then kept.
 
         // internal functions
         // decoding values from bit codes
@@ -37,18 +79,32 @@ namespace mc
         // stream decoding functions that have to be used in a specific order and shouldn't be accessible to user
         void check_flac_marker();
         void read_metadata();
-        void read_metadata_block_STREAMINFO();
         void read_metadata_block_PADDING();
         void read_metadata_block_APPLICATION();
-        void read_metadata_block_SEEKTABLE();
-        void read_metadata_block_VORBIS_COMMENT();
-        void read_metadata_block_CUESHEET();
-        void read_metadata_block_PICTURE();
-        void decode_subframe(uint8_t bits_per_sample);
-        void decode_subframe_fixed(uint8_t predictor_order, uint8_t bits_per_sample);
-        void decode_subframe_lpc(uint8_t predictor_order, uint8_t bits_per_sample);
-        void linear_prediction(uint8_t predictor_order, const int16_t *predictor_coefficients, int8_t qlp_shift);
-        void decode_residuals(uint8_t predictor_order);
+        void read_metadata_block_SEEKTABLE(uint32_t block_length);
+        void clear_state();
+        void allocate_channel_buffers(uint16_t block_size);
+        Frame_status read_frame(bool recovering);
+        Frame_status frame_error(bool recovering, const char *message);
+        bool fail(const char *message);
+        void resynchronize(uint64_t offset);
+        void emit_silence();
+        void decode_next_frame();
+        void trim_frame(uint16_t offset);
+        void update_md5();
+        uint64_t first_sample_of(const Frame_info &header) const;
+        bool find_frame_header(uint64_t offset, uint64_t end, uint64_t min_sample, uint64_t &frame_offset, uint64_t &first_sample);
+        int32_t *channel_samples(uint8_t channel) { return m_channel_samples.data() + channel * m_channel_stride; }
+        bool decode_subframe(uint8_t bits_per_sample);
+        void decorrelate_stereo();
+        template <typename Sample>
+        bool decode_subframe_samples(Sample *samples, uint8_t subframe_type_code, uint8_t wasted_bits_per_sample, uint8_t bits_per_sample);
+        template <typename Sample>
+        bool decode_subframe_fixed(Sample *samples, uint8_t predictor_order, uint8_t bits_per_sample);
+        template <typename Sample>
+        bool decode_subframe_lpc(Sample *samples, uint8_t predictor_order, uint8_t bits_per_sample);
+        template <typename Sample>
+        bool decode_residuals(Sample *samples, uint8_t predictor_order);
 
     public:
         /**
@@ -56,7 +112,26 @@ namespace mc
          *
          * @param flac_stream The input stream to read the FLAC file from.
          */
-        explicit Flac(std::ifstream &flac_stream) : m_flac_stream(flac_stream), m_reader(m_flac_stream) {};
+        explicit Flac(std::ifstream &flac_stream) : m_flac_stream(&flac_stream), m_reader(flac_stream) {};
+
+        /**
+         * @brief Constructs a Flac decoder reading from memory.
+         *
+         * The bytes are either a whole FLAC file, to be opened with initialize(), or a
+         * run of frames, to be opened with initialize(const Stream_info &).
+         *
+         * @param data The encoded bytes; must outlive the decoder.
+         */
+        explicit Flac(std::span<const uint8_t> data) : m_reader(data) {};
+
+        /**
+         * @brief Constructs a Flac decoder reading a file ahead asynchronously.
+         *
+         * initialize() sizes the read-ahead from the STREAMINFO frame and block sizes.
+         *
+         * @param input The file to read; must outlive the decoder.
+         */
+        explicit Flac(Read_ahead_file &input) : m_reader(input) {};
 
         /**
          * @brief Destructor for the Flac class.
@@ -77,26 +152,213 @@ namespace mc
          */
         const Frame_info &get_frame_info() { return m_frame_info; }
 
+        /**
+         * @brief Gets the first sample of the current frame, as its header numbers it.
+         *
+         * @return The sample, counted from the start of the stream.
+         */
+        uint64_t get_frame_first_sample() const { return first_sample_of(m_frame_info); }
+
+        /**
+         * @brief Gets the first sample of the range select_range() restricted the decoder to.
+         *
+         * @return The sample, counted from the start of the stream, or 0 without a range.
+         */
+        uint64_t get_range_start() const { return m_range_start; }
+
         /**
          * @brief Gets the Vorbis comments of the FLAC file.
          *
-         * @return A reference to the Vorbis_comment structure containing the Vorbis comments.
+         * @return A reference to the Vorbis_comment structure containing the Vorbis comments,
+         *         valid until the decoder is reset or destroyed.
          */
         const Vorbis_comment &get_vorbis_comment() { return m_vorbis_comment; }
 
+        /**
+         * @brief Gets the pictures embedded in the FLAC file, such as cover art.
+         *
+         * Only the descriptors are read; initialize() skips over the image data itself.
+         * Flac_decoder::get_picture_data() and read_picture_data() fetch it on demand.
+         *
+         * @return The pictures in file order, valid until the decoder is reset or destroyed.
+         */
+        const std::vector<Picture> &get_pictures() const { return m_pictures; }
+
+        /**
+         * @brief Gets the CUESHEET of the FLAC file, e.g. the table of contents of a CD image.
+         *
+         * @return The cue sheet, without tracks if the file has none; valid until the
+         *         decoder is reset or destroyed.
+         */
+        const Cue_sheet &get_cue_sheet() const { return m_cue_sheet; }
+
+        /**
+         * @brief Gets the time spent in each decoding stage so far.
+         *
+         * @return The accumulated timings; all zero unless built with MC_STAGE_TIMING.
+         */
+        const Stage_timings &get_stage_timings() const { return m_stage_timings; }
+
+        /**
+         * @brief Starts or stops collecting statistics about the decoded frames.
+         *
+         * Records the time every decode_frame() call takes, the subframe types and
+         * predictor orders, the Rice partition orders and where the bits of each frame
+         * go. Without statistics the decoder only tests a null pointer now and then.
+         * The counters can be read from other threads while the decoder runs, and may
+         * be shared by several decoders used by the same thread.
+         *
+         * @param stats The counters to add to, or nullptr to stop; must outlive their use.
+         */
+        void set_stats(Decode_stats *stats) { m_stats = stats; }
+
+        /**
+         * @brief Sets how frames failing their CRC check are handled.
+         *
+         * @param policy The policy; Crc_policy::VERIFY by default.
+         */
+        void set_crc_policy(Crc_policy policy) { m_crc_policy = policy; }
+
+        /**
+         * @brief Gets the damage recovered from so far.
+         *
+         * @return The error counters; only CRC policies that recover can make them non-zero.
+         */
+        const Decode_errors &get_decode_errors() const { return m_decode_errors; }
+
+        /**
+         * @brief Checks if every sample of the stream has been output.
+         *
+         * Unlike get_reader().eos(), this waits for the silence concealing a truncated
+         * end of the stream.
+         *
+         * @return True if decode_frame() has nothing more to output.
+         */
+        bool eos() const
+        {
+            return !m_frame_pending && ((m_pending_silence == 0 && m_reader.eos()) || m_next_sample >= m_range_end);
+        }
+
+        /**
+         * @brief Starts hashing the decoded audio to check it against the STREAMINFO MD5 signature.
+         *
+         * Every decoded frame is packed right after it is decoded into the little-endian
+         * layout the signature is defined over, so no second pass is needed, and hashed
+         * on a thread of the decoder's own while decoding carries on. Must be called
+         * before the first frame is decoded; seeking stops the check.
+         */
+        void enable_md5_check()
+        {
+            if (m_md5_worker == nullptr)
+            {
+                m_md5_worker = std::make_unique<Md5_worker>();
+            }
+            m_md5_check = true;
+        }
+
+        /**
+         * @brief Checks the audio decoded so far against the STREAMINFO MD5 signature.
+         *
+         * @return Md5_status::MATCH or MISMATCH once the whole stream has been decoded
+         *         with the check enabled, otherwise why it could not be checked.
+         */
+        Md5_status get_md5_status();
+
+        /**
+         * @brief Gets the seek points of the FLAC file.
+         *
+         * @return The seek points sorted by sample number, placeholders removed.
+         */
+        const std::vector<Seek_point> &get_seek_table() const { return m_seek_table; }
+
         /**
          * @brief Gets the bit reader used for reading the FLAC file.
          *
          * @return A reference to the Bit_reader object used for reading the FLAC file.
          */
-        const Bit_reader<std::ifstream> &get_reader() const { return m_reader; }
+        const Buffered_bit_reader &get_reader() const { return m_reader; }
+
+        /**
+         * @brief Gets the decoded samples of one channel of the current frame.
+         *
+         * The samples are planar and right-aligned at the frame's bit depth, which is
+         * the cheapest way to consume a frame.
+         *
+         * @param channel The channel index.
+         * @return A span of Frame_info::block_size samples.
+         */
+        std::span<const int32_t> get_channel_samples(uint8_t channel) const
+        {
+            return {m_channel_samples.data() + channel * m_channel_stride, m_frame_info.block_size};
+        }
 
         /**
          * @brief Gets the audio buffer containing the decoded audio samples.
          *
+         * The samples are interleaved and shifted to the top of 32 bits. They are
+         * produced from the channel buffers in a single pass on the first call after
+         * each decode_frame(). Prefer decode_frame_into(), which needs no copy.
+         *
          * @return A reference to the vector containing the decoded audio samples.
          */
-        const std::vector<buffer_sample_type> &get_audio_buffer() const { return m_audio_buffer; }
+        const std::vector<buffer_sample_type> &get_audio_buffer();
+
+        /**
+         * @brief Gets the number of bytes the largest frame of the stream takes in a PCM format.
+         *
+         * @param format The PCM format.
+         * @return The buffer size decode_frame_into() needs for any frame of the stream.
+         */
+        size_t max_frame_bytes(Pcm_format format) const
+        {
+            return static_cast<size_t>(std::max<size_t>(m_stream_info.max_block_size, m_channel_stride)) *
+                   m_stream_info.channels * pcm_format_bytes(format);
+        }
+
+        /**
+         * @brief Writes part of the current frame as interleaved PCM.
+         *
+         * Converts straight from the planar channel buffers, touching every sample once.
+         *
+         * @param destination The buffer to write count * channels samples to.
+         * @param format The PCM format to write.
+         * @param offset The first sample of the frame to write.
+         * @param count The number of samples per channel to write.
+         * @throws std::invalid_argument If the range exceeds the frame or the destination is too small.
+         */
+        void write_pcm(std::span<std::byte> destination, Pcm_format format, uint16_t offset, uint16_t count) const;
+
+        /**
+         * @brief Decodes the next frame directly into a caller-provided PCM buffer.
+         *
+         * Does not allocate, so the same buffer can be reused for the whole stream.
+         *
+         * @param destination The buffer to write the interleaved samples to, at least
+         *                    max_frame_bytes(format) bytes large.
+         * @param format The PCM format to write.
+         * @return The number of samples per channel written, 0 at the end of the stream.
+         */
+        size_t decode_frame_into(std::span<std::byte> destination, Pcm_format format);
+
+        /**
+         * @brief Points the decoder at another file held in memory, keeping its buffers.
+         *
+         * Returns the decoder to the state of a freshly constructed one, CRC policy
+         * and statistics included, except that channel buffers, the seek table, the
+         * header search window and the metadata arena keep their capacity. Reusing one
+         * decoder for many files therefore stops allocating once it has seen the largest
+         * of them. Call initialize() next.
+         *
+         * @param data The encoded bytes; must outlive the decoder.
+         */
+        void reset(std::span<const uint8_t> data);
+
+        /**
+         * @brief Points the decoder at another file read ahead asynchronously, keeping its buffers.
+         *
+         * @param input The file to read; must outlive the decoder.
+         */
+        void reset(Read_ahead_file &input);
 
         /**
          * @brief Initializes the FLAC decoder.
@@ -105,11 +367,69 @@ namespace mc
          */
         void initialize();
 
+        /**
+         * @brief Initializes the decoder for input that starts at a frame header.
+         *
+         * Used to decode a slice of frames of a stream whose metadata has already been
+         * read elsewhere, e.g. by one worker of a parallel decode.
+         *
+         * @param stream_info The stream information of the stream the frames belong to.
+         */
+        void initialize(const Stream_info &stream_info);
+
+        /**
+         * @brief Makes the frame holding the given sample the current frame.
+         *
+         * Jumps to the nearest seek point before the sample, narrows the distance by
+         * bisecting over frame headers while it is still large (which also covers files
+         * without a SEEKTABLE), and decodes forward to the frame holding the sample.
+         * The next decode_frame() continues with the frame after it. If the frame holding
+         * the sample is dropped under Crc_policy::SKIP, the next frame becomes current.
+         *
+         * @param sample The sample to seek to, counted from the start of the stream, or of
+         *               the range select_range() restricted the decoder to.
+         * @return The index of the sample within the current frame, e.g. the offset to
+         *         pass to write_pcm().
+         * @throws std::out_of_range If the sample is past the end of the stream or range.
+         */
+        uint16_t seek_to_sample(uint64_t sample);
+
+        /**
+         * @brief Restricts the decoder to a range of samples, as if it were a stream of its own.
+         *
+         * Seeks to the first sample like seek_to_sample(), without decoding the frames
+         * before it. From then on decode_frame() hands out frames trimmed to the range,
+         * starting with the one holding the first sample, eos() turns true at the end of
+         * the range, and seek_to_sample() counts from its start. The MD5 check stops.
+         *
+         * @param first_sample The first sample of the range, counted from the start of the stream.
+         * @param end_sample The sample after the last one of the range.
+         * @throws std::out_of_range If the range is empty or starts past the end of the stream.
+         */
+        void select_range(uint64_t first_sample, uint64_t end_sample);
+
+        /**
+         * @brief Restricts the decoder to one track of the CUESHEET, e.g. one song of a CD image.
+         *
+         * The track runs from its index point 1 up to the next track, as find_cue_track()
+         * describes, and is then decoded like select_range() does.
+         *
+         * @param track_number The number of the track, as in Cue_track::number.
+         * @throws std::out_of_range If the cue sheet has no such audio track.
+         */
+        void select_track(uint8_t track_number);
+
         /**
          * @brief Decodes a frame from the FLAC file.
          *
          * This function decodes a single frame from the FLAC file and stores the decoded
-         * audio samples in the audio buffer.
+         * audio samples in the audio buffer. The header CRC-8 and frame CRC-16 are checked
+         * as the bytes are read, and damage is handled according to the CRC policy: a
+         * recovering policy resumes at the next valid frame header, and under
+         * Crc_policy::CONCEAL the samples lost in between come out as silent frames.
+         * If the policy skips the last frame of the stream, the block size is left at 0.
+         *
+         * @throws std::runtime_error If the frame is damaged and the policy does not recover.
          */
         void decode_frame();
     };
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Flac.hpp"
+#include "Flac_types.hpp"
+#include "Mapped_file.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Pull-based FLAC decoding for embedding: open, read_pcm and seek.
+     *
+     * Wraps a Flac decoder and hands out interleaved PCM in whatever amounts the caller
+     * asks for, splitting frames as needed. All buffers are sized when a stream is
+     * opened, so reading does not allocate. Instances share no mutable state, so any
+     * number of them can decode on different threads; a single instance must not be
+     * used from two threads at once.
+     */
+    class Flac_decoder
+    {
+    private:
+        std::unique_ptr<Mapped_file> m_file;
+        std::unique_ptr<Flac> m_flac; ///< Kept across streams, so reopening reuses its buffers.
+        std::span<const uint8_t> m_data;
+        bool m_open{};
+        Pcm_format m_format{Pcm_format::S32_LE};
+        uint16_t m_frame_position{};
+        uint16_t m_frame_samples{};
+        uint64_t m_position{};
+
+        void open_flac(std::span<const uint8_t> data, Pcm_format format, Crc_policy crc_policy);
+
+    public:
+        /**
+         * @brief Opens a FLAC file, mapping it into memory.
+         *
+         * Closes the previously opened stream, if any, and reuses its decoder buffers.
+         *
+         * @param path The file to open.
+         * @param format The PCM format read_pcm() writes.
+         * @param crc_policy How damaged frames are handled.
+         * @throws std::runtime_error If the file cannot be read or is not a valid FLAC file.
+         */
+        void open(const std::string &path, Pcm_format format, Crc_policy crc_policy = Crc_policy::CONCEAL);
+
+        /**
+         * @brief Opens a FLAC file held in memory.
+         *
+         * @param data The whole FLAC file; must outlive the decoder or the next open().
+         * @param format The PCM format read_pcm() writes.
+         * @param crc_policy How damaged frames are handled.
+         * @throws std::runtime_error If the data is not a valid FLAC file.
+         */
+        void open(std::span<const uint8_t> data, Pcm_format format, Crc_policy crc_policy = Crc_policy::CONCEAL);
+
+        /**
+         * @brief Closes the stream and releases its mapping; the decoder buffers are kept for the next open().
+         */
+        void close();
+
+        /**
+         * @brief Checks if a stream is open.
+         */
+        bool is_open() const { return m_open; }
+
+        /**
+         * @brief Decodes the next samples as interleaved PCM.
+         *
+         * @param destination The buffer to write to, at least frames * frame_bytes() bytes large.
+         * @param frames The number of samples per channel to read.
+         * @return The number of samples per channel written; less than requested only at
+         *         the end of the stream.
+         * @throws std::invalid_argument If no stream is open or the destination is too small.
+         * @throws std::runtime_error If the stream is damaged and the CRC policy does not recover.
+         */
+        size_t read_pcm(std::span<std::byte> destination, size_t frames);
+
+        /**
+         * @brief Moves to a sample, so the next read_pcm() starts there.
+         *
+         * If the sample's frame is dropped under Crc_policy::SKIP, reading resumes at the
+         * next frame, and tell() reports that sample instead.
+         *
+         * @param sample The sample to seek to, counted from the start of the stream.
+         * @throws std::invalid_argument If no stream is open.
+         * @throws std::out_of_range If the sample is past the end of the stream.
+         */
+        void seek(uint64_t sample);
+
+        /**
+         * @brief Restricts the stream to one track of its CUESHEET, e.g. one song of a CD image.
+         *
+         * Seeks straight to the track. From then on read_pcm() stops at the end of the
+         * track, and seek() and tell() count from its start.
+         *
+         * @param track_number The number of the track, as in Cue_track::number.
+         * @throws std::out_of_range If the cue sheet has no such audio track.
+         */
+        void select_track(uint8_t track_number);
+
+        /**
+         * @brief Gets the sample the next read_pcm() starts at.
+         */
+        uint64_t tell() const { return m_position; }
+
+        /**
+         * @brief Gets the number of bytes one sample of every channel takes in the PCM format.
+         */
+        size_t frame_bytes() const
+        {
+            return m_open ? static_cast<size_t>(m_flac->get_stream_info().channels) * pcm_format_bytes(m_format) : 0;
+        }
+
+        /**
+         * @brief Gets the underlying decoder, e.g. for metadata, MD5 or error counters.
+         *
+         * @throws std::invalid_argument If no stream is open.
+         */
+        Flac &get_flac();
+
+        /**
+         * @brief Gets the CUESHEET of the stream, without tracks if it has none.
+         */
+        const Cue_sheet &get_cue_sheet() { return get_flac().get_cue_sheet(); }
+
+        /**
+         * @brief Gets the pictures embedded in the stream, without their image data.
+         *
+         * @throws std::invalid_argument If no stream is open.
+         */
+        const std::vector<Picture> &get_pictures() { return get_flac().get_pictures(); }
+
+        /**
+         * @brief Gets the image data of an embedded picture without copying it.
+         *
+         * The bytes are a view into the mapped file or the caller's buffer, so pages are
+         * only read from disk once the view is actually accessed.
+         *
+         * @param picture One of the pictures returned by get_pictures().
+         * @return The image data, valid until the stream is closed.
+         * @throws std::invalid_argument If no stream is open.
+         * @throws std::out_of_range If the picture lies outside the stream.
+         */
+        std::span<const uint8_t> get_picture_data(const Picture &picture) const;
+    };
+} // namespace mc
@@ -1,14 +1,68 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 /**
  * @brief Type alias for the sample type used in buffers.
  *
  * This type represents the sample values used in audio buffers.
  */
-using buffer_sample_type = int64_t;
+using buffer_sample_type = int32_t;
+
+/**
+ * @brief Interleaved little-endian PCM formats the decoder can write directly.
+ *
+ * Samples are left-aligned in the container, so a 16-bit stream written as S32_LE
+ * keeps its value in the upper 16 bits, and wider streams are truncated to fit.
+ */
+enum class Pcm_format : uint8_t
+{
+    S16_LE = 0,  ///< 16-bit signed, 2 bytes per sample.
+    S24_3LE = 1, ///< 24-bit signed, packed in 3 bytes per sample.
+    S32_LE = 2   ///< 32-bit signed, 4 bytes per sample.
+};
+
+/**
+ * @brief Gets the number of bytes one sample takes in the given PCM format.
+ *
+ * @param format The PCM format.
+ * @return The size of one sample in bytes.
+ */
+constexpr uint8_t pcm_format_bytes(Pcm_format format)
+{
+    return static_cast<uint8_t>(format) + 2;
+}
+
+/**
+ * @brief What the decoder does with damaged frames.
+ *
+ * Under SKIP and CONCEAL the decoder also recovers from frames it cannot decode at all
+ * (bad sync code, reserved values, failed header CRC-8, truncation) by scanning for the
+ * next valid frame header, counting the damage in Decode_errors instead of throwing.
+ */
+enum class Crc_policy : uint8_t
+{
+    IGNORE = 0,  ///< Do not check CRCs; throw on undecodable frames.
+    VERIFY = 1,  ///< Throw std::runtime_error on a CRC mismatch or undecodable frame.
+    SKIP = 2,    ///< Drop damaged frames and the samples lost with them.
+    CONCEAL = 3  ///< Replace the samples of damaged frames with silence, keeping the timeline intact.
+};
+
+/**
+ * @brief Outcome of checking the decoded audio against the STREAMINFO MD5 signature.
+ */
+enum class Md5_status : uint8_t
+{
+    UNCHECKED = 0,    ///< Checking is off, was interrupted by a seek, or the stream is not fully decoded yet.
+    NO_SIGNATURE = 1, ///< The encoder left the signature empty.
+    MATCH = 2,        ///< The decoded audio matches the signature.
+    MISMATCH = 3      ///< The decoded audio differs from what was encoded.
+};
 
 /**
  * @brief Structure to hold FLAC stream information.
@@ -26,6 +80,7 @@ struct Stream_info
     uint8_t channels{};          ///< Number of channels in the stream.
     uint8_t bits_per_sample{};   ///< Bits per sample in the stream.
     uint64_t total_samples{};    ///< Total number of samples in the stream.
+    std::array<uint8_t, 16> md5_signature{}; ///< MD5 of the decoded audio, all zero if unknown.
 };
 
 /**
@@ -47,16 +102,133 @@ struct Frame_info
     uint16_t crc_16{};               ///< 16-bit CRC value for the frame.
 };
 
+/**
+ * @brief Time spent in the decoding stages, collected only in builds defining MC_STAGE_TIMING.
+ *
+ * Bit reading (frame and subframe headers, warm-up and verbatim samples) is whatever
+ * part of frame_ns the other stages do not account for.
+ */
+struct Stage_timings
+{
+    uint64_t frame_ns{};         ///< Whole decode_frame() calls.
+    uint64_t residual_ns{};      ///< Rice residual decoding.
+    uint64_t prediction_ns{};    ///< Fixed and LPC prediction.
+    uint64_t decorrelation_ns{}; ///< Stereo decorrelation.
+};
+
+/**
+ * @brief Damage the decoder ran into and recovered from.
+ *
+ * Samples lost to damage are either concealed (replaced by silence, so the timeline
+ * stays intact) or skipped, depending on the CRC policy.
+ */
+struct Decode_errors
+{
+    uint64_t crc_mismatches{};    ///< Frames whose CRC-16 did not match their contents.
+    uint64_t corrupt_frames{};    ///< Frames abandoned because of an invalid or truncated header or subframe.
+    uint64_t resyncs{};           ///< Searches for the next valid frame header.
+    uint64_t concealed_samples{}; ///< Samples per channel replaced by silence.
+    uint64_t skipped_samples{};   ///< Samples per channel dropped from the output.
+};
+
+/**
+ * @brief One point of a SEEKTABLE block.
+ */
+struct Seek_point
+{
+    uint64_t sample_number{}; ///< First sample of the target frame.
+    uint64_t stream_offset{}; ///< Offset of the target frame from the first frame header, in bytes.
+    uint16_t frame_samples{}; ///< Number of samples in the target frame.
+};
+
 /**
  * @brief Structure to hold Vorbis comments.
  *
  * This structure contains metadata in the form of Vorbis comments, including
- * a vendor string and user comments.
+ * a vendor string and user comments. The strings live in the decoder's metadata
+ * arena and stay valid until the decoder is reset or destroyed.
  */
 struct Vorbis_comment
 {
-    std::string vendor_string; ///< Vendor string in the Vorbis comment.
-    std::unordered_map<std::string, std::string> user_comments; ///< User comments in the Vorbis comment.
+    std::string_view vendor_string; ///< Vendor string in the Vorbis comment.
+    std::vector<std::pair<std::string_view, std::string_view>> user_comments; ///< Field names and values in file order, repeated fields included.
+
+    /**
+     * @brief Finds the value of a field.
+     *
+     * Field names are compared case-insensitively, as the Vorbis comment format requires.
+     *
+     * @param name The field name, e.g. "ARTIST".
+     * @return The value of the first field with that name, empty if there is none.
+     */
+    std::string_view find(std::string_view name) const
+    {
+        for (const auto &[field, value] : user_comments)
+        {
+            if (field.size() == name.size() &&
+                std::equal(field.begin(), field.end(), name.begin(), [](char a, char b)
+                           { return (a >= 'a' && a <= 'z' ? a - 32 : a) == (b >= 'a' && b <= 'z' ? b - 32 : b); }))
+            {
+                return value;
+            }
+        }
+        return {};
+    }
+};
+
+/**
+ * @brief Describes a picture embedded in a PICTURE block, without its image data.
+ *
+ * The image bytes stay in the file; data_offset and data_length locate them, so they
+ * can be viewed in a mapping or read when they are actually needed. The strings live
+ * in the decoder's metadata arena, like the Vorbis comments.
+ */
+struct Picture
+{
+    uint32_t type{};              ///< Picture type as defined by ID3v2 APIC, e.g. 3 for the front cover.
+    std::string_view mime_type;   ///< MIME type, or "-->" if the data is a URL.
+    std::string_view description; ///< UTF-8 description.
+    uint32_t width{};             ///< Width in pixels.
+    uint32_t height{};            ///< Height in pixels.
+    uint32_t color_depth{};       ///< Bits per pixel.
+    uint32_t color_count{};       ///< Number of colors of an indexed picture, 0 otherwise.
+    uint64_t data_offset{};       ///< Offset of the image data from the start of the file.
+    uint32_t data_length{};       ///< Length of the image data in bytes.
+};
+
+/**
+ * @brief An index point of a CUESHEET track.
+ */
+struct Cue_index
+{
+    uint64_t offset{}; ///< First sample of the index, relative to the track offset.
+    uint8_t number{};  ///< Index number; 0 marks a pregap, 1 the start of the track proper.
+};
+
+/**
+ * @brief A track of a CUESHEET block.
+ */
+struct Cue_track
+{
+    uint64_t offset{};           ///< First sample of the track, counted from the start of the stream.
+    uint8_t number{};            ///< Track number, 1 to 99 on a CD; 170 (CD) or 255 marks the lead-out.
+    std::string_view isrc;       ///< International Standard Recording Code, empty if there is none.
+    bool audio{true};            ///< False for a data track.
+    bool pre_emphasis{};         ///< The audio was recorded with pre-emphasis.
+    std::vector<Cue_index> indices; ///< Index points in ascending order; empty for the lead-out.
+};
+
+/**
+ * @brief The contents of a CUESHEET block, e.g. the table of contents of a CD image.
+ *
+ * The strings live in the decoder's metadata arena, like the Vorbis comments.
+ */
+struct Cue_sheet
+{
+    std::string_view media_catalog_number; ///< Empty if there is none.
+    uint64_t lead_in_samples{};            ///< Samples of lead-in on a CD.
+    bool is_cd{};                          ///< The cue sheet describes a Compact Disc.
+    std::vector<Cue_track> tracks;         ///< Tracks in order, the lead-out last.
 };
 
 /**
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace mc
+{
+    /**
+     * @brief A read-only file mapped into memory, exposed as one contiguous span.
+     *
+     * Opening costs an open, fstat and mmap, after which the decoder reads metadata and
+     * frames straight from the page cache without copying or per-byte calls. Files that
+     * cannot be mapped (pipes, some special files) are read into memory instead, so
+     * callers always get a span.
+     */
+    class Mapped_file
+    {
+    public:
+        /**
+         * @brief How the mapping is going to be read, passed on to madvise().
+         */
+        enum class Access : uint8_t
+        {
+            SEQUENTIAL = 0, ///< Front to back (playback, decoding): aggressive read-ahead.
+            RANDOM = 1      ///< Scattered reads (seeking, metadata scans): no read-ahead.
+        };
+
+    private:
+        const uint8_t *m_mapping{};
+        size_t m_size{};
+        std::vector<uint8_t> m_fallback;
+
+    public:
+        /**
+         * @brief Maps a file.
+         *
+         * @param path The file to map.
+         * @param access The expected access pattern.
+         * @throws std::runtime_error If the file cannot be opened or read.
+         */
+        explicit Mapped_file(const std::string &path, Access access = Access::SEQUENTIAL);
+
+        /**
+         * @brief Unmaps the file.
+         */
+        ~Mapped_file();
+
+        Mapped_file(const Mapped_file &) = delete;
+        Mapped_file &operator=(const Mapped_file &) = delete;
+
+        /**
+         * @brief Gets the contents of the file.
+         *
+         * @return A span valid for the lifetime of this object.
+         */
+        std::span<const uint8_t> bytes() const
+        {
+            return m_mapping != nullptr ? std::span<const uint8_t>(m_mapping, m_size) : std::span<const uint8_t>(m_fallback);
+        }
+
+        /**
+         * @brief Gets the size of the file in bytes.
+         */
+        size_t size() const { return bytes().size(); }
+    };
+} // namespace mc
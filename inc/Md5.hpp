@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace mc
+{
+    /**
+     * @brief Incremental MD5 (RFC 1321), as used by the STREAMINFO audio signature.
+     *
+     * Whole 64-byte blocks are hashed straight from the caller's buffer; only the
+     * partial blocks at the edges of an update are copied.
+     */
+    class Md5
+    {
+    private:
+        std::array<uint32_t, 4> m_state{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+        uint64_t m_length{};
+        std::array<uint8_t, 64> m_block{};
+
+        void process_blocks(const uint8_t *data, size_t blocks);
+
+    public:
+        /**
+         * @brief Hashes more bytes.
+         *
+         * @param data The bytes to hash.
+         * @param size The number of bytes.
+         */
+        void update(const uint8_t *data, size_t size);
+
+        /**
+         * @brief Pads the message and gets the digest.
+         *
+         * The hasher has to be reset before it is used again.
+         *
+         * @return The 16-byte digest.
+         */
+        std::array<uint8_t, 16> finish();
+
+        /**
+         * @brief Starts a new message.
+         */
+        void reset() { *this = Md5(); }
+    };
+} // namespace mc
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "Md5.hpp"
+#include "Spsc_ring.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Hashes a message with MD5 on a thread of its own, overlapping the hash with its producer.
+     *
+     * MD5 cannot be split within one message, so a decoder hashing its own output runs at
+     * the speed of the slower of the two. Here the producer packs each piece of the
+     * message straight into a slot of a single-producer/single-consumer ring, and the
+     * worker thread hashes the slots in order while the producer carries on. Slot
+     * buffers keep their capacity, so a steady stream of pieces does not allocate.
+     */
+    class Md5_worker
+    {
+    private:
+        enum class Command : uint8_t
+        {
+            UPDATE, ///< Hash the slot's bytes.
+            FINISH, ///< Finish the message into m_digest and start a new one.
+            RESET,  ///< Drop the message and start a new one.
+            STOP
+        };
+
+        struct Slot
+        {
+            Command command{};
+            std::vector<uint8_t> data;
+        };
+
+        Spsc_ring<Slot> m_ring;
+        Md5 m_md5;                         ///< Only used by the worker thread.
+        std::array<uint8_t, 16> m_digest{}; ///< Written by the worker before it releases a FINISH slot.
+        std::jthread m_thread;
+
+        Slot &acquire_slot();
+        void run();
+
+    public:
+        /**
+         * @brief Starts the worker thread.
+         *
+         * @param queued_pieces The number of pieces the producer may run ahead of the hash.
+         */
+        explicit Md5_worker(size_t queued_pieces = 8);
+
+        /**
+         * @brief Stops the worker thread once it has hashed everything queued.
+         */
+        ~Md5_worker();
+
+        Md5_worker(const Md5_worker &) = delete;
+        Md5_worker &operator=(const Md5_worker &) = delete;
+
+        /**
+         * @brief Gets a buffer to pack the next piece of the message into.
+         *
+         * Blocks while the ring is full. Hand the buffer over with commit_piece().
+         *
+         * @param size The size of the piece in bytes.
+         * @return The buffer, valid until commit_piece().
+         */
+        std::span<uint8_t> begin_piece(size_t size);
+
+        /**
+         * @brief Queues the piece filled since begin_piece() for hashing.
+         */
+        void commit_piece() { m_ring.commit_write(); }
+
+        /**
+         * @brief Waits for every queued piece to be hashed and gets the digest.
+         *
+         * The worker starts a new message afterwards.
+         *
+         * @return The 16-byte digest.
+         */
+        std::array<uint8_t, 16> finish();
+
+        /**
+         * @brief Drops the message queued so far and starts a new one, without waiting.
+         */
+        void reset();
+    };
+} // namespace mc
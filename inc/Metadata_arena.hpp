@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace mc
+{
+    /**
+     * @brief Bump allocator for the strings of a stream's metadata blocks.
+     *
+     * Strings are copied into large blocks that are never moved, so views into them
+     * stay valid until reset(). reset() keeps the blocks, so a decoder that is reused
+     * for file after file stops allocating once it has seen its largest metadata.
+     */
+    class Metadata_arena
+    {
+    private:
+        static constexpr size_t default_block_size = 1 << 14;
+
+        struct Block
+        {
+            std::unique_ptr<char[]> data;
+            size_t size{};
+        };
+
+        std::vector<Block> m_blocks;
+        size_t m_block{}; ///< Block currently allocated from.
+        size_t m_used{};  ///< Bytes used in the current block.
+
+    public:
+        /**
+         * @brief Reserves uninitialized bytes.
+         *
+         * @param size The number of bytes.
+         * @return The bytes, valid until reset().
+         */
+        char *allocate(size_t size);
+
+        /**
+         * @brief Copies a string into the arena.
+         *
+         * @param text The string to copy.
+         * @return A view of the copy, valid until reset().
+         */
+        std::string_view store(std::string_view text);
+
+        /**
+         * @brief Releases every string at once, keeping the memory for reuse.
+         */
+        void reset()
+        {
+            m_block = 0;
+            m_used = 0;
+        }
+
+        /**
+         * @brief Gets the number of bytes the arena holds, used or not.
+         */
+        size_t capacity() const;
+    };
+} // namespace mc
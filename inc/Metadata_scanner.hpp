@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Flac_types.hpp"
+#include "Metadata_arena.hpp"
+
+namespace mc
+{
+    /**
+     * @brief The metadata of a FLAC file, as gathered by Metadata_scanner.
+     */
+    struct Flac_metadata
+    {
+        uint64_t file_size{};          ///< Size of the file in bytes.
+        int64_t modified_time{};       ///< Last modification, in seconds since the epoch.
+        Stream_info stream_info{};
+        Vorbis_comment vorbis_comment; ///< Strings valid until the next scan.
+        std::vector<Picture> pictures; ///< Descriptors only; strings valid until the next scan.
+        Cue_sheet cue_sheet;           ///< Without tracks if the file has no CUESHEET; strings valid until the next scan.
+        uint64_t first_frame_offset{}; ///< Offset of the first frame, i.e. the size of the metadata.
+    };
+
+    /**
+     * @brief Reads the metadata of FLAC files without touching their audio.
+     *
+     * Walks the metadata block chain with pread(): the first read usually covers the
+     * whole chain, and blocks that are not needed (padding, seek tables, image data)
+     * are stepped over using their headers, so a large embedded picture costs one more
+     * read at most. Buffers and the string arena are reused, so a scanner that is kept per
+     * thread scans file after file without allocating.
+     */
+    class Metadata_scanner
+    {
+    private:
+        static constexpr size_t read_size = 1 << 16;
+
+        std::vector<uint8_t> m_buffer;
+        uint64_t m_window_offset{};
+        size_t m_window_size{};
+        Metadata_arena m_arena;
+        Flac_metadata m_metadata;
+        uint64_t m_reads{};
+        uint64_t m_bytes_read{};
+
+        std::span<const uint8_t> read_range(int fd, uint64_t offset, size_t size);
+        void scan_metadata(int fd);
+
+    public:
+        /**
+         * @brief Reads the metadata of a FLAC file.
+         *
+         * @param path The file to scan.
+         * @return The metadata, valid until the next scan.
+         * @throws std::runtime_error If the file cannot be read or is not a valid FLAC file.
+         */
+        const Flac_metadata &scan(const std::string &path);
+
+        /**
+         * @brief Gets the number of pread() calls made so far.
+         */
+        uint64_t get_reads() const { return m_reads; }
+
+        /**
+         * @brief Gets the number of bytes read so far.
+         */
+        uint64_t get_bytes_read() const { return m_bytes_read; }
+    };
+
+    /**
+     * @brief Reads the image data of an embedded picture from a file.
+     *
+     * For callers that only kept the path and a descriptor, e.g. from a library index.
+     *
+     * @param path The FLAC file the picture was found in.
+     * @param picture The picture descriptor.
+     * @param data Receives the image data; its capacity is reused.
+     * @throws std::runtime_error If the file cannot be read or is shorter than the picture needs.
+     */
+    void read_picture_data(const std::string &path, const Picture &picture, std::vector<uint8_t> &data);
+} // namespace mc
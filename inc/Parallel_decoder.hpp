@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Flac_types.hpp"
+#include "Work_stealing_pool.hpp"
+#include "frame_scanner.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Decodes a whole in-memory FLAC file on several cores.
+     *
+     * Frames decode independently once their byte boundaries are known, so the frames
+     * are located up front with scan_frames() and handed out in batches to a
+     * work-stealing pool. Every batch gets its own decoder and writes its PCM straight
+     * into its slot of the caller's output buffer, so the output is in stream order
+     * without any merging.
+     */
+    class Parallel_decoder
+    {
+    private:
+        std::span<const uint8_t> m_data;
+        Stream_info m_stream_info{};
+        std::vector<Frame_location> m_frames;
+        std::vector<Frame_gap> m_gaps;
+        uint64_t m_total_samples{};
+        Work_stealing_pool m_pool;
+
+        void decode_batch(std::span<std::byte> destination, Pcm_format format, size_t first, size_t last) const;
+
+    public:
+        /**
+         * @brief Constructs a decoder for a FLAC file held in memory.
+         *
+         * @param data The whole FLAC file; must outlive the decoder.
+         * @param thread_count The number of worker threads, 0 for one per hardware thread.
+         */
+        explicit Parallel_decoder(std::span<const uint8_t> data, size_t thread_count = 0)
+            : m_data(data), m_pool(thread_count) {}
+
+        /**
+         * @brief Reads the metadata and locates every frame.
+         *
+         * Frames behind a damaged header are still found; the samples lost with the
+         * damaged frames are recorded as gaps.
+         *
+         * @throws std::runtime_error If the file is not a valid FLAC file, or the frames
+         *         found do not add up to the STREAMINFO total.
+         */
+        void initialize();
+
+        /**
+         * @brief Gets the stream information of the FLAC file.
+         */
+        const Stream_info &get_stream_info() const { return m_stream_info; }
+
+        /**
+         * @brief Gets the frames found by initialize(), offsets relative to the file start.
+         */
+        const std::vector<Frame_location> &get_frames() const { return m_frames; }
+
+        /**
+         * @brief Gets the samples lost to damaged frame headers, found by initialize().
+         */
+        const std::vector<Frame_gap> &get_gaps() const { return m_gaps; }
+
+        /**
+         * @brief Gets the number of samples per channel in all frames.
+         */
+        uint64_t get_total_samples() const { return m_total_samples; }
+
+        /**
+         * @brief Gets the number of worker threads.
+         */
+        size_t get_thread_count() const { return m_pool.get_thread_count(); }
+
+        /**
+         * @brief Gets the size of the whole decoded stream in a PCM format.
+         *
+         * @param format The PCM format.
+         * @return The buffer size decode() needs.
+         */
+        size_t pcm_bytes(Pcm_format format) const
+        {
+            return static_cast<size_t>(m_total_samples) * m_stream_info.channels * pcm_format_bytes(format);
+        }
+
+        /**
+         * @brief Decodes every frame into one interleaved PCM buffer.
+         *
+         * @param destination The buffer to write to, at least pcm_bytes(format) bytes large.
+         * @param format The PCM format to write.
+         * @throws std::invalid_argument If the destination is too small.
+         * @throws std::runtime_error If a frame fails to decode, or samples were lost to
+         *         damaged headers; the other frames are decoded and the gaps left silent.
+         */
+        void decode(std::span<std::byte> destination, Pcm_format format);
+    };
+} // namespace mc
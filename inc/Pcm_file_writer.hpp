@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Aligned_allocator.hpp"
+#include "Flac_types.hpp"
+#include "Spsc_ring.hpp"
+
+namespace mc
+{
+    /**
+     * @brief The container a Pcm_file_writer writes.
+     */
+    enum class Pcm_file_type : uint8_t
+    {
+        WAV = 0, ///< RIFF/WAVE, WAVE_FORMAT_EXTENSIBLE when the bit depth is narrower than the sample container.
+        RAW = 1  ///< Interleaved little-endian samples without a header.
+    };
+
+    /**
+     * @brief Writes interleaved PCM to a WAV or raw file on a background thread.
+     *
+     * The caller writes samples straight into large aligned blocks, which a writer
+     * thread hands to pwrite() while the next ones are being filled, so producing the
+     * samples overlaps with the I/O and memory stays bounded by the block count.
+     * Every write except the last covers whole 4 KiB pages at page-aligned offsets,
+     * which also allows O_DIRECT to bypass the page cache for bulk output.
+     *
+     * Not thread-safe: one thread produces the samples.
+     */
+    class Pcm_file_writer
+    {
+    public:
+        static constexpr size_t alignment = 4096;
+        static constexpr size_t default_block_size = 1 << 22;
+        static constexpr size_t default_block_count = 4;
+
+    private:
+        struct Block
+        {
+            std::vector<std::byte, Aligned_allocator<std::byte, alignment>> data;
+            size_t size{};
+            bool last{}; ///< The writer thread stops after this block.
+        };
+
+        int m_fd{-1};
+        bool m_direct{};
+        Pcm_file_type m_type{};
+        uint8_t m_channels{};
+        uint32_t m_sample_rate{};
+        uint8_t m_bits_per_sample{};
+        Pcm_format m_format{};
+        Spsc_ring<Block> m_ring;
+        Block *m_block{};
+        std::array<std::byte, alignment> m_carry{};
+        uint64_t m_bytes{};       ///< Bytes produced so far, header included.
+        uint64_t m_stalls{};
+        bool m_finished{};
+        std::atomic<int> m_error{}; ///< errno of the first failed write, set by the writer thread.
+        std::thread m_thread;
+
+        size_t header_size() const;
+        void write_header(std::byte *destination, uint64_t data_bytes) const;
+        void hand_off(bool last);
+        void write_loop();
+        void close_file();
+
+    public:
+        /**
+         * @brief Creates the file and starts the writer thread.
+         *
+         * @param path The file to create or truncate.
+         * @param type The container to write.
+         * @param channels The number of interleaved channels.
+         * @param sample_rate The sample rate in Hz.
+         * @param bits_per_sample The significant bits of each sample, at most the width of the format.
+         * @param format The sample container the caller writes.
+         * @param direct Whether to bypass the page cache with O_DIRECT; ignored where the file system does not support it.
+         * @param block_size The bytes per write, rounded up to a multiple of 4 KiB.
+         * @param block_count The number of blocks, at least 2.
+         * @throws std::runtime_error If the file cannot be created.
+         */
+        Pcm_file_writer(const std::string &path, Pcm_file_type type, uint8_t channels, uint32_t sample_rate, uint8_t bits_per_sample,
+                        Pcm_format format, bool direct = false, size_t block_size = default_block_size,
+                        size_t block_count = default_block_count);
+
+        /**
+         * @brief Stops the writer thread; a file that was not finished is left incomplete.
+         */
+        ~Pcm_file_writer();
+
+        Pcm_file_writer(const Pcm_file_writer &) = delete;
+        Pcm_file_writer &operator=(const Pcm_file_writer &) = delete;
+
+        /**
+         * @brief Gets contiguous space for the next samples, waiting for a free block if needed.
+         *
+         * @param bytes The space needed, at most the block size minus 4 KiB.
+         * @return At least `bytes` bytes to write to, followed by commit().
+         * @throws std::invalid_argument If more than a block is requested.
+         * @throws std::runtime_error If an earlier write failed.
+         */
+        std::span<std::byte> get_buffer(size_t bytes);
+
+        /**
+         * @brief Adds bytes written to the space returned by get_buffer() to the file.
+         */
+        void commit(size_t bytes) { m_block->size += bytes; m_bytes += bytes; }
+
+        /**
+         * @brief Writes what is left, completes the header and closes the file.
+         *
+         * @throws std::runtime_error If a write failed.
+         */
+        void finish();
+
+        /**
+         * @brief Checks if the file is written with O_DIRECT.
+         */
+        bool is_direct() const { return m_direct; }
+
+        /**
+         * @brief Gets the number of bytes in the file so far, header included.
+         */
+        uint64_t get_bytes() const { return m_bytes; }
+
+        /**
+         * @brief Gets the number of times the caller had to wait for a block to be written.
+         */
+        uint64_t get_stalls() const { return m_stalls; }
+    };
+} // namespace mc
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Alsa_output.hpp"
+#include "Flac.hpp"
+#include "Resampler.hpp"
+#include "Spsc_ring.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Buffering parameters of a Playback_engine, in PCM periods.
+     */
+    struct Playback_config
+    {
+        size_t period_frames{4096};  ///< Frames per ring slot.
+        size_t ring_periods{32};     ///< Number of ring slots (rounded up to a power of two).
+        size_t prefill_periods{8};   ///< Periods queued before playback starts or resumes after an underrun.
+        size_t low_watermark{8};     ///< The decoder resumes once the ring has drained to this many periods.
+        size_t high_watermark{24};   ///< The decoder pauses once the ring holds this many periods.
+        uint64_t start_sample{};     ///< Sample to start playback at.
+    };
+
+    /**
+     * @brief A snapshot of a Playback_engine's counters.
+     */
+    struct Playback_stats
+    {
+        size_t ring_capacity{};      ///< Number of ring slots.
+        size_t ring_occupancy{};     ///< Periods currently queued.
+        size_t min_ring_occupancy{}; ///< Lowest occupancy seen by the output thread while playing.
+        uint64_t periods_decoded{};  ///< Periods the decoder thread has queued.
+        uint64_t periods_played{};   ///< Periods handed to the device.
+        uint64_t ring_underruns{};   ///< Times the output thread found the ring empty before the end of the stream.
+        uint64_t device_underruns{}; ///< Underruns the device reported.
+        uint64_t tracks_started{};   ///< Following tracks whose first samples have reached the device.
+    };
+
+    /**
+     * @brief Hooks that let a Playback_engine play several tracks back to back without a gap.
+     */
+    struct Playback_tracks
+    {
+        /// Called on the decoder thread when a track ends. Returns the next decoder, initialized
+        /// and with the same channel count, or nullptr to end playback. The previous decoder is
+        /// not used anymore once it is called.
+        std::function<Flac *()> next;
+        /// Called on the output thread right before the period holding the first samples of a
+        /// following track is written to the device.
+        std::function<void()> started;
+    };
+
+    /**
+     * @brief Plays a FLAC stream with decoding and device output on separate threads.
+     *
+     * A decoder thread writes PCM periods straight into the slots of a lock-free
+     * single-producer/single-consumer ring, pausing between the high and low watermarks.
+     * The output thread only copies full periods from the ring to the device, so a slow
+     * frame does not stall the device as long as the ring holds data.
+     *
+     * If the device runs at another rate than the stream, the decoder thread converts
+     * every frame with a Resampler before it goes into the ring.
+     *
+     * When a track ends, the decoder thread asks Playback_tracks::next for the following
+     * one and goes on filling the same period with it, so the device sees one continuous
+     * stream and the handover is sample-exact.
+     */
+    class Playback_engine
+    {
+    private:
+        struct Period
+        {
+            std::vector<std::byte> data;
+            size_t frames{}; ///< 0 marks the end of the stream.
+            uint32_t tracks_started{}; ///< Following tracks whose first sample is in this period.
+        };
+
+        Flac *m_decoder;
+        Alsa_output &m_output;
+        Playback_config m_config;
+        Playback_tracks m_tracks;
+        std::unique_ptr<Resampler> m_resampler; ///< Set if the device rate differs from the stream rate.
+        Spsc_ring<Period> m_ring;
+
+        std::atomic<bool> m_stop{};
+        std::atomic<bool> m_decoder_done{};
+        std::exception_ptr m_decoder_error;
+
+        std::atomic<uint64_t> m_periods_decoded{};
+        std::atomic<uint64_t> m_periods_played{};
+        std::atomic<uint64_t> m_ring_underruns{};
+        std::atomic<size_t> m_min_ring_occupancy{};
+        std::atomic<uint64_t> m_tracks_started{};
+
+        Period *acquire_period();
+        void push_frame(uint16_t offset);
+        void finish_decoding();
+        void decode_loop();
+
+    public:
+        /**
+         * @brief Constructs an engine playing an initialized decoder on an open device.
+         *
+         * Watermarks and prefill are clamped to the ring capacity. All ring memory is
+         * allocated here.
+         *
+         * @param decoder The decoder, already initialized.
+         * @param output The device to play on.
+         * @param config The buffering parameters; start_sample applies to the first track.
+         * @param tracks The hooks for playing more tracks after the first one.
+         */
+        Playback_engine(Flac &decoder, Alsa_output &output, const Playback_config &config = {}, Playback_tracks tracks = {});
+
+        /**
+         * @brief Plays until the end of the stream or until stop() is called.
+         *
+         * The calling thread becomes the output thread. Does not drain the device.
+         *
+         * @throws Any exception thrown by the decoder thread.
+         */
+        void run();
+
+        /**
+         * @brief Asks a running engine to stop. Safe to call from any thread.
+         */
+        void stop() { m_stop.store(true); }
+
+        /**
+         * @brief Checks if playback ended early, through stop() or a device failure.
+         */
+        bool stopped() const { return m_stop.load(); }
+
+        /**
+         * @brief Gets a snapshot of the engine's counters. Safe to call from any thread.
+         */
+        Playback_stats get_stats() const;
+    };
+} // namespace mc
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Flac.hpp"
+#include "Flac_types.hpp"
+#include "Mapped_file.hpp"
+
+namespace mc
+{
+    /**
+     * @brief What a Playlist knows about a track once it has been opened.
+     */
+    struct Playlist_entry
+    {
+        std::string path;
+        std::string artist; ///< Empty if the file has no ARTIST comment.
+        std::string title;  ///< Empty if the file has no TITLE comment.
+        std::string album;  ///< Empty if the file has no ALBUM comment.
+        Stream_info stream_info{};
+    };
+
+    /**
+     * @brief A list of FLAC files played one after the other, the next one opened ahead of time.
+     *
+     * While a track plays, the following one is mapped and its metadata read on a
+     * background thread, so switching tracks costs no I/O. The decoder of a finished
+     * track is reset and reused for the track after the next one. Files that fail to
+     * open are skipped and recorded.
+     *
+     * advance(), peek_next() and get_decoder() must be called from one thread at a time;
+     * get_entry() can be called from any thread.
+     */
+    class Playlist
+    {
+    private:
+        struct Track
+        {
+            std::unique_ptr<Mapped_file> file; ///< Backs every read of the decoder.
+            std::unique_ptr<Flac> decoder;
+            Playlist_entry entry;
+            std::string error; ///< Why the track could not be opened; empty if it was.
+        };
+
+        std::vector<std::string> m_paths;
+        Crc_policy m_crc_policy;
+        uint8_t m_cue_track;
+        size_t m_next_path{};
+        Track m_current;
+        Track m_next;
+        bool m_next_ready{};
+        std::future<Track> m_preload;
+        std::unique_ptr<Flac> m_spare_decoder;
+        Decode_errors m_finished_errors{};
+        std::vector<std::pair<std::string, std::string>> m_failures;
+
+        mutable std::mutex m_mutex; // guards m_entries
+        std::deque<Playlist_entry> m_entries;
+
+        Track open_track(const std::string &path, std::unique_ptr<Flac> decoder) const;
+        void start_preload();
+        bool wait_for_next();
+
+    public:
+        /**
+         * @brief Creates a playlist and starts opening its first track in the background.
+         *
+         * @param paths The files to play, in order.
+         * @param crc_policy How damaged frames are handled in every track.
+         * @param cue_track The CUESHEET track to play of every file, or 0 to play whole files.
+         */
+        Playlist(std::vector<std::string> paths, Crc_policy crc_policy, uint8_t cue_track = 0);
+
+        /**
+         * @brief Waits for a track still being opened in the background.
+         */
+        ~Playlist();
+
+        Playlist(const Playlist &) = delete;
+        Playlist &operator=(const Playlist &) = delete;
+
+        /**
+         * @brief Gets the stream information of the track advance() switches to next.
+         *
+         * Waits for the track to be opened, skipping files that fail to open.
+         *
+         * @return The stream information, or nullptr if no tracks are left.
+         */
+        const Stream_info *peek_next();
+
+        /**
+         * @brief Makes the next track that opens the current one and starts opening the one after it.
+         *
+         * The previous decoder must not be used anymore.
+         *
+         * @return False if no tracks are left.
+         */
+        bool advance();
+
+        /**
+         * @brief Gets the decoder of the current track, initialized and ready to decode.
+         */
+        Flac &get_decoder() { return *m_current.decoder; }
+
+        /**
+         * @brief Gets the number of tracks opened so far; the current track has this number.
+         */
+        size_t get_track_number() const
+        {
+            std::lock_guard lock(m_mutex);
+            return m_entries.size();
+        }
+
+        /**
+         * @brief Gets the details of an opened track. Safe to call from any thread.
+         *
+         * @param track_number The track number, counting from 1 in the order tracks were opened.
+         * @throws std::out_of_range If no track with that number has been opened.
+         */
+        Playlist_entry get_entry(size_t track_number) const;
+
+        /**
+         * @brief Gets the damage recovered from, summed over the tracks played so far.
+         */
+        Decode_errors get_decode_errors() const;
+
+        /**
+         * @brief Gets the paths of the files that were skipped, with the reason.
+         */
+        const std::vector<std::pair<std::string, std::string>> &get_failures() const { return m_failures; }
+    };
+} // namespace mc
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Flac_types.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace mc
+{
+    /**
+     * @brief A file read front to back in large chunks, with the next chunks read ahead asynchronously.
+     *
+     * The file is read into a ring of chunk buffers. While the caller consumes one chunk
+     * in place, the reads of the following ones are already in flight, so with enough
+     * read-ahead the caller only ever touches memory that is resident. Reads go through
+     * io_uring where the kernel supports it and otherwise are pread() calls on a small
+     * shared thread pool, so slow or network-mounted storage never blocks the decoder
+     * on one request at a time.
+     *
+     * Not thread-safe: one thread consumes the chunks.
+     */
+    class Read_ahead_file
+    {
+    public:
+        /**
+         * @brief How the asynchronous reads are issued.
+         */
+        enum class Backend : uint8_t
+        {
+            AUTO = 0,     ///< io_uring if available, pread otherwise.
+            IO_URING = 1, ///< io_uring; the constructor throws if the kernel does not support it.
+            PREAD = 2     ///< pread() on the shared I/O thread pool.
+        };
+
+        static constexpr size_t default_chunk_size = 1 << 18;
+        static constexpr size_t default_depth = 2;
+
+    private:
+        struct Slot
+        {
+            std::vector<uint8_t> data;
+            uint64_t offset{};
+            size_t size{};    ///< Bytes requested, then bytes read once ready.
+            size_t filled{};  ///< Bytes read so far (io_uring may return short reads).
+            int error{};      ///< errno of a failed read.
+            bool in_flight{};
+            bool ready{};
+        };
+
+        struct Uring
+        {
+            int fd{-1};
+            void *sq_ring{};
+            size_t sq_ring_size{};
+            void *cq_ring{};
+            size_t cq_ring_size{};
+            io_uring_sqe *sqes{};
+            size_t sqes_size{};
+            unsigned *sq_tail{};
+            unsigned *sq_mask{};
+            unsigned *sq_array{};
+            unsigned *cq_head{};
+            unsigned *cq_tail{};
+            unsigned *cq_mask{};
+            io_uring_cqe *cqes{};
+        };
+
+        int m_fd{-1};
+        uint64_t m_size{};
+        Backend m_backend{};
+        Uring m_uring;
+        std::vector<Slot> m_slots;
+        size_t m_chunk_size{};
+        size_t m_next_chunk_size{};
+        size_t m_next_depth{};
+        uint64_t m_base{};            ///< File offset of chunk 0.
+        uint64_t m_consumed{};        ///< Index of the chunk the caller holds or gets next.
+        uint64_t m_submitted{};       ///< Index of the next chunk to read.
+        bool m_held{};                ///< The caller holds chunk m_consumed.
+        bool m_restart{};             ///< Reading restarts at m_restart_offset on the next next_chunk().
+        uint64_t m_restart_offset{};
+        uint64_t m_stalls{};
+
+        // guards the slots of the pread backend, whose reads complete on pool threads
+        std::mutex m_mutex;
+        std::condition_variable m_read_done;
+
+        bool setup_uring(size_t entries);
+        void close_uring();
+        void submit(uint64_t chunk);
+        void submit_uring(Slot &slot, size_t index);
+        void reap_uring(bool wait);
+        void wait_for(Slot &slot);
+        void drain();
+        uint64_t read_position() const;
+
+    public:
+        /**
+         * @brief Opens a file and starts reading it ahead.
+         *
+         * @param path The file to open.
+         * @param chunk_size The number of bytes per read.
+         * @param depth The number of chunk buffers: the one being consumed and the ones read ahead.
+         * @param backend How to issue the reads.
+         * @throws std::runtime_error If the file cannot be opened, or io_uring was requested and is unavailable.
+         */
+        explicit Read_ahead_file(const std::string &path, size_t chunk_size = default_chunk_size, size_t depth = default_depth,
+                                 Backend backend = Backend::AUTO);
+
+        /**
+         * @brief Waits for the reads in flight and closes the file.
+         */
+        ~Read_ahead_file();
+
+        Read_ahead_file(const Read_ahead_file &) = delete;
+        Read_ahead_file &operator=(const Read_ahead_file &) = delete;
+
+        /**
+         * @brief Gets the next chunk, waiting for its read if it is not in memory yet.
+         *
+         * Hands the previous chunk back for reuse, so it must not be accessed anymore.
+         *
+         * @return The chunk, valid until the next call; empty at the end of the file.
+         * @throws std::runtime_error If the read failed.
+         */
+        std::span<const uint8_t> next_chunk();
+
+        /**
+         * @brief Makes the next chunk start at the given offset.
+         *
+         * The chunk currently held stays valid until the next next_chunk().
+         *
+         * @param offset The offset from the start of the file.
+         */
+        void seek(uint64_t offset);
+
+        /**
+         * @brief Checks if nothing follows the chunk currently held.
+         */
+        bool at_end() const { return read_position() >= m_size; }
+
+        /**
+         * @brief Changes the chunk size and read-ahead depth, taking effect from the next chunk.
+         *
+         * @param chunk_size The number of bytes per read.
+         * @param depth The number of chunk buffers, at least 2.
+         */
+        void configure(size_t chunk_size, size_t depth);
+
+        /**
+         * @brief Sizes the read-ahead for a FLAC stream.
+         *
+         * A chunk holds at least 16 of the largest frames (64 KiB to 1 MiB), and enough
+         * chunks are kept in flight to cover 64 of the largest frames and at least 1 MiB,
+         * between 2 and 16 chunks. Without a maximum frame size in STREAMINFO, the size
+         * of a verbatim frame of the largest block is assumed.
+         *
+         * @param stream_info The stream information of the stream being read.
+         */
+        void tune(const Stream_info &stream_info);
+
+        /**
+         * @brief Gets the size of the file in bytes.
+         */
+        uint64_t size() const { return m_size; }
+
+        /**
+         * @brief Gets the backend in use, never Backend::AUTO.
+         */
+        Backend get_backend() const { return m_backend; }
+
+        /**
+         * @brief Gets the number of next_chunk() calls that had to wait for a read.
+         */
+        uint64_t get_stalls() const { return m_stalls; }
+    };
+} // namespace mc
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "Aligned_allocator.hpp"
+#include "Flac_types.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Converts planar PCM between sample rates with a polyphase windowed-sinc filter.
+     *
+     * The rate ratio is reduced to L/M, and a Kaiser-windowed sinc low-pass (about
+     * 100 dB stopband attenuation, cutoff at 95% of the lower Nyquist frequency) is
+     * split into L phases, one per fractional output position. Each output sample is
+     * then a single dot product of one phase with the input history, computed with
+     * SSE or AVX2 kernels according to get_simd_level(). Filter tables are built once
+     * per rate pair and shared by all resamplers converting between the same rates.
+     *
+     * The filter state carries over from one push() to the next, so input can be fed
+     * frame by frame. The output is aligned with the input: the filter delay is
+     * compensated, and finish() flushes the tail.
+     */
+    class Resampler
+    {
+    private:
+        struct Filter_table
+        {
+            uint32_t phases{};  ///< L: output samples per cycle of the ratio.
+            uint32_t step{};    ///< M: input samples per cycle of the ratio.
+            size_t taps{};      ///< Taps per phase, a multiple of 8.
+            std::vector<float, Aligned_allocator<float, 32>> coefficients; ///< phases * taps, phase by phase.
+        };
+
+        using Dot_kernel = float (*)(const float *, const float *, size_t);
+
+        std::shared_ptr<const Filter_table> m_table;
+        Dot_kernel m_dot{};
+        uint32_t m_input_rate{};
+        uint32_t m_output_rate{};
+        uint8_t m_channels{};
+        std::vector<float> m_history; ///< Input per channel, m_stride floats apart.
+        size_t m_stride{};
+        size_t m_size{};              ///< Samples per channel in the history.
+        size_t m_position{};          ///< First history sample of the next output.
+        uint32_t m_phase{};           ///< Filter phase of the next output.
+        uint64_t m_input_frames{};
+        uint64_t m_output_frames{};
+        bool m_finished{};
+
+        static std::shared_ptr<const Filter_table> get_table(uint32_t input_rate, uint32_t output_rate);
+        void reserve_input(size_t count);
+
+    public:
+        /**
+         * @brief Sets up a conversion.
+         *
+         * @param input_rate The sample rate of the input in Hz.
+         * @param output_rate The sample rate of the output in Hz.
+         * @param channels The number of channels, 1 to 8.
+         * @param max_block_size The largest push() expected; larger ones allocate.
+         * @throws std::invalid_argument If a rate is 0 or the channel count is out of range.
+         */
+        Resampler(uint32_t input_rate, uint32_t output_rate, uint8_t channels, size_t max_block_size);
+
+        /**
+         * @brief Appends one block of planar input, such as a decoded frame.
+         *
+         * @param channels One span per channel, all of the same length, holding samples
+         *                 right-aligned at bits_per_sample.
+         * @param bits_per_sample The bit depth of the samples.
+         */
+        void push(std::span<const std::span<const int32_t>> channels, uint8_t bits_per_sample);
+
+        /**
+         * @brief Marks the end of the input, so pull() can return the tail of the filter.
+         */
+        void finish();
+
+        /**
+         * @brief Writes the output the input pushed so far allows, as interleaved PCM.
+         *
+         * @param destination The buffer to write to, at least frames * channels * pcm_format_bytes(format) bytes large.
+         * @param format The PCM format to write.
+         * @param frames The maximum number of samples per channel to write.
+         * @return The number of samples per channel written; less than requested once more input is needed.
+         */
+        size_t pull(std::span<std::byte> destination, Pcm_format format, size_t frames);
+
+        /**
+         * @brief Drops all input and output state, e.g. after a seek.
+         */
+        void reset();
+
+        /**
+         * @brief Gets the number of taps each output sample takes.
+         */
+        size_t get_taps() const { return m_table->taps; }
+
+        /**
+         * @brief Gets the sample rate of the input.
+         */
+        uint32_t get_input_rate() const { return m_input_rate; }
+
+        /**
+         * @brief Gets the sample rate of the output.
+         */
+        uint32_t get_output_rate() const { return m_output_rate; }
+    };
+} // namespace mc
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace mc
+{
+    /**
+     * @brief A bounded single-producer/single-consumer lock-free ring of slots.
+     *
+     * Slots are preallocated and filled in place: the producer gets the next free slot
+     * with try_acquire_write(), fills it and publishes it with commit_write(); the
+     * consumer reads it through try_acquire_read() and hands it back with release_read().
+     * Head and tail live on separate cache lines. Blocking waits use C++20 atomic
+     * wait/notify, so an idle side sleeps in the kernel instead of spinning.
+     *
+     * @tparam T The slot type.
+     */
+    template <typename T>
+    class Spsc_ring
+    {
+    private:
+        std::vector<T> m_slots;
+        size_t m_mask{};
+        alignas(64) std::atomic<size_t> m_head{}; ///< Slots ever committed by the producer.
+        alignas(64) std::atomic<size_t> m_tail{}; ///< Slots ever released by the consumer.
+
+    public:
+        /**
+         * @brief Constructs a ring with at least the given number of slots.
+         *
+         * @param capacity The minimum number of slots, rounded up to a power of two.
+         */
+        explicit Spsc_ring(size_t capacity)
+        {
+            size_t slots = 1;
+            while (slots < capacity)
+            {
+                slots <<= 1;
+            }
+            m_slots.resize(slots);
+            m_mask = slots - 1;
+        }
+
+        /**
+         * @brief Gets the number of slots in the ring.
+         */
+        size_t capacity() const { return m_slots.size(); }
+
+        /**
+         * @brief Gets the number of committed slots not yet released by the consumer.
+         */
+        size_t size() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+
+        /**
+         * @brief Gets a slot by index, for preallocating slot storage before use.
+         */
+        T &slot(size_t index) { return m_slots[index]; }
+
+        /**
+         * @brief Gets the next free slot (producer side).
+         *
+         * @return The slot to fill, or nullptr if the ring is full.
+         */
+        T *try_acquire_write()
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) == m_slots.size())
+            {
+                return nullptr;
+            }
+            return &m_slots[head & m_mask];
+        }
+
+        /**
+         * @brief Publishes the slot returned by try_acquire_write() (producer side).
+         */
+        void commit_write()
+        {
+            m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            m_head.notify_one();
+        }
+
+        /**
+         * @brief Gets the oldest committed slot (consumer side).
+         *
+         * @return The slot to read, or nullptr if the ring is empty.
+         */
+        const T *try_acquire_read()
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (m_head.load(std::memory_order_acquire) == tail)
+            {
+                return nullptr;
+            }
+            return &m_slots[tail & m_mask];
+        }
+
+        /**
+         * @brief Returns the slot returned by try_acquire_read() to the producer (consumer side).
+         */
+        void release_read()
+        {
+            m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            m_tail.notify_one();
+        }
+
+        /**
+         * @brief Blocks the producer until at most `occupancy` slots are in use.
+         *
+         * @param occupancy The occupancy to wait for.
+         * @param cancelled Checked after every wake-up; the wait ends early once it returns true.
+         *                  Whatever makes it true must be followed by a release_read().
+         */
+        template <typename Predicate>
+        void wait_until_size_at_most(size_t occupancy, Predicate cancelled) const
+        {
+            while (true)
+            {
+                size_t tail = m_tail.load(std::memory_order_acquire);
+                if (m_head.load(std::memory_order_relaxed) - tail <= occupancy || cancelled())
+                {
+                    return;
+                }
+                m_tail.wait(tail, std::memory_order_acquire);
+            }
+        }
+
+        /**
+         * @brief Blocks the consumer until at least `occupancy` slots are in use.
+         *
+         * @param occupancy The occupancy to wait for.
+         * @param cancelled Checked after every wake-up; the wait ends early once it returns true.
+         *                  Whatever makes it true must be followed by a commit_write().
+         */
+        template <typename Predicate>
+        void wait_until_size_at_least(size_t occupancy, Predicate cancelled) const
+        {
+            while (true)
+            {
+                size_t head = m_head.load(std::memory_order_acquire);
+                if (head - m_tail.load(std::memory_order_relaxed) >= occupancy || cancelled())
+                {
+                    return;
+                }
+                m_head.wait(head, std::memory_order_acquire);
+            }
+        }
+    };
+} // namespace mc
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mc
+{
+    /**
+     * @brief A fixed-size thread pool where idle workers steal queued tasks from busy ones.
+     *
+     * Every worker owns a task queue. A worker runs its own tasks newest first and, once
+     * its queue is empty, takes the oldest task of another worker. Tasks submitted from
+     * outside the pool are spread over the queues round-robin; tasks submitted from a
+     * task go to the submitting worker's queue.
+     */
+    class Work_stealing_pool
+    {
+    private:
+        struct Task_queue
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<Task_queue>> m_queues;
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_task_available;
+        std::condition_variable m_all_done;
+        ptrdiff_t m_queued{};  ///< Tasks sitting in a queue; briefly -1 when one is taken before submit() counts it.
+        size_t m_unfinished{}; ///< Tasks submitted and not finished yet.
+        size_t m_next_queue{};
+        bool m_stopping{};
+        std::exception_ptr m_error;
+
+        bool try_pop(size_t worker, std::function<void()> &task);
+        void worker_loop(size_t worker);
+
+    public:
+        /**
+         * @brief Starts the worker threads.
+         *
+         * @param thread_count The number of workers, 0 for one per hardware thread.
+         */
+        explicit Work_stealing_pool(size_t thread_count = 0);
+
+        /**
+         * @brief Finishes the queued tasks and joins the workers.
+         */
+        ~Work_stealing_pool();
+
+        Work_stealing_pool(const Work_stealing_pool &) = delete;
+        Work_stealing_pool &operator=(const Work_stealing_pool &) = delete;
+
+        /**
+         * @brief Gets the number of worker threads.
+         */
+        size_t get_thread_count() const { return m_threads.size(); }
+
+        /**
+         * @brief Queues a task. Safe to call from any thread, including from a task.
+         *
+         * @param task The task to run on a worker.
+         */
+        void submit(std::function<void()> task);
+
+        /**
+         * @brief Blocks until every submitted task has finished.
+         *
+         * Must not be called from a task.
+         *
+         * @throws Any exception thrown by a task since the last wait(); further
+         *         exceptions are dropped.
+         */
+        void wait();
+    };
+} // namespace mc
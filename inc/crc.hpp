@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace mc
+{
+    /**
+     * @brief Slice-by-8 lookup tables for the FLAC frame header CRC-8 (polynomial x^8 + x^2 + x + 1).
+     *
+     * Table k holds the CRC of a byte followed by k zero bytes, so eight input bytes are
+     * folded with eight independent lookups. Table 0 is the classic byte-wise table.
+     */
+    inline constexpr std::array<std::array<uint8_t, 256>, 8> crc8_tables = []
+    {
+        std::array<std::array<uint8_t, 256>, 8> tables{};
+        for (size_t i = 0; i < 256; i++)
+        {
+            uint8_t crc = static_cast<uint8_t>(i);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+            }
+            tables[0][i] = crc;
+        }
+        for (size_t k = 1; k < 8; k++)
+        {
+            for (size_t i = 0; i < 256; i++)
+            {
+                tables[k][i] = tables[0][tables[k - 1][i]];
+            }
+        }
+        return tables;
+    }();
+
+    /**
+     * @brief Slice-by-8 lookup tables for the FLAC frame CRC-16 (polynomial x^16 + x^15 + x^2 + 1).
+     *
+     * Table k holds the CRC of a byte followed by k zero bytes. Table 0 is the classic
+     * byte-wise table.
+     */
+    inline constexpr std::array<std::array<uint16_t, 256>, 8> crc16_tables = []
+    {
+        std::array<std::array<uint16_t, 256>, 8> tables{};
+        for (size_t i = 0; i < 256; i++)
+        {
+            uint16_t crc = static_cast<uint16_t>(i << 8);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+            }
+            tables[0][i] = crc;
+        }
+        for (size_t k = 1; k < 8; k++)
+        {
+            for (size_t i = 0; i < 256; i++)
+            {
+                tables[k][i] = static_cast<uint16_t>(tables[k - 1][i] << 8) ^ tables[0][tables[k - 1][i] >> 8];
+            }
+        }
+        return tables;
+    }();
+
+    /**
+     * @brief Continues a CRC-8 over more bytes.
+     *
+     * @param crc The CRC of the bytes before these, 0 to start.
+     * @param data The bytes to checksum.
+     * @param size The number of bytes.
+     * @return The CRC-8 of all bytes so far.
+     */
+    inline uint8_t crc8_update(uint8_t crc, const uint8_t *data, size_t size)
+    {
+        const auto &t = crc8_tables;
+        for (; size >= 8; data += 8, size -= 8)
+        {
+            crc = t[7][crc ^ data[0]] ^ t[6][data[1]] ^ t[5][data[2]] ^ t[4][data[3]] ^
+                  t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        }
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = t[0][crc ^ data[i]];
+        }
+        return crc;
+    }
+
+    /**
+     * @brief Continues a CRC-16 over more bytes.
+     *
+     * @param crc The CRC of the bytes before these, 0 to start.
+     * @param data The bytes to checksum.
+     * @param size The number of bytes.
+     * @return The CRC-16 of all bytes so far.
+     */
+    inline uint16_t crc16_update(uint16_t crc, const uint8_t *data, size_t size)
+    {
+        const auto &t = crc16_tables;
+        for (; size >= 8; data += 8, size -= 8)
+        {
+            crc ^= static_cast<uint16_t>((data[0] << 8) | data[1]);
+            crc = t[7][crc >> 8] ^ t[6][crc & 0xFF] ^ t[5][data[2]] ^ t[4][data[3]] ^
+                  t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        }
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = static_cast<uint16_t>(crc << 8) ^ t[0][(crc >> 8) ^ data[i]];
+        }
+        return crc;
+    }
+
+    /**
+     * @brief Computes the CRC-8 FLAC uses to protect frame headers.
+     *
+     * @param data The bytes to checksum.
+     * @param size The number of bytes.
+     * @return The CRC-8 of the bytes, starting from 0.
+     */
+    inline uint8_t crc8(const uint8_t *data, size_t size)
+    {
+        return crc8_update(0, data, size);
+    }
+
+    /**
+     * @brief Computes the CRC-16 FLAC uses to protect whole frames.
+     *
+     * @param data The bytes to checksum.
+     * @param size The number of bytes.
+     * @return The CRC-16 of the bytes, starting from 0.
+     */
+    inline uint16_t crc16(const uint8_t *data, size_t size)
+    {
+        return crc16_update(0, data, size);
+    }
+} // namespace mc
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Flac_types.hpp"
+#include "Pcm_file_writer.hpp"
+
+namespace mc
+{
+    /**
+     * @brief How decode_to_file() writes its output.
+     */
+    struct Decode_file_options
+    {
+        Pcm_file_type type{Pcm_file_type::WAV};
+        bool direct_io{};                                      ///< Write with O_DIRECT where the file system supports it.
+        size_t block_size{Pcm_file_writer::default_block_size}; ///< Bytes per write; raised to fit two of the largest frames.
+        size_t block_count{Pcm_file_writer::default_block_count}; ///< Blocks in flight, which bounds the memory used.
+        Crc_policy crc_policy{Crc_policy::CONCEAL};            ///< How damaged frames are handled.
+        bool verify_md5{};                                     ///< Check the audio against the STREAMINFO MD5 signature.
+        uint8_t cue_track{};                                   ///< Decode only this CUESHEET track; 0 for the whole file.
+    };
+
+    /**
+     * @brief What decode_to_file() did.
+     */
+    struct Decode_file_stats
+    {
+        uint64_t samples{};        ///< Samples per channel written.
+        uint32_t sample_rate{};
+        uint64_t bytes_written{};  ///< Size of the output file, header included.
+        double seconds{};          ///< Wall-clock time from opening the input to closing the output.
+        uint64_t write_stalls{};   ///< Times decoding waited for the writer.
+        bool direct_io{};          ///< The output was written with O_DIRECT.
+        Md5_status md5_status{Md5_status::UNCHECKED};
+        Decode_errors decode_errors{};
+    };
+
+    /**
+     * @brief Decodes a FLAC file to a WAV or raw PCM file at its native bit depth.
+     *
+     * Samples are stored in the narrowest container that holds the bit depth (16, 24
+     * or 32 bits), MSB-aligned. Frames are decoded straight into the blocks of a
+     * Pcm_file_writer, so decoding runs while earlier blocks are written and nothing
+     * is copied in between. With a CUESHEET track selected, decoding seeks straight
+     * to the track and stops at its end; the MD5 signature cannot be checked then.
+     *
+     * @param input The FLAC file to decode.
+     * @param output The file to create.
+     * @param options The output container and I/O settings.
+     * @return The counters and timing of the conversion.
+     * @throws std::runtime_error If the input is not a valid FLAC file, the output cannot be
+     *         written, or the stream is damaged and the CRC policy does not recover.
+     */
+    Decode_file_stats decode_to_file(const std::string &input, const std::string &output, const Decode_file_options &options = {});
+} // namespace mc
@@ -1,22 +1,21 @@
 #pragma once
 
 #include <cstdint>
-#include <fstream>
 
-#include "Bit_reader.hpp"
+#include "Buffered_bit_reader.hpp"
 
 /**
- * @brief Decodes a UTF-8 encoded number from a file stream.
+ * @brief Decodes a UTF-8 encoded number from a bit reader.
  *
- * This function reads bytes from the provided file stream and decodes them
+ * This function reads bytes from the provided bit reader and decodes them
  * into a single UTF-8 code point. It handles multi-byte UTF-8 sequences and
- * validates the encoding.
+ * validates the encoding. The reader must be aligned to a byte boundary.
  *
- * @param file_stream The input file stream to read from.
- * @return The decoded UTF-8 code point as a 64-bit unsigned integer.
- * @throws std::runtime_error If the UTF-8 encoding is invalid.
+ * @param reader The bit reader to read from.
+ * @param code_point Receives the decoded UTF-8 code point.
+ * @return False if the UTF-8 encoding is invalid.
  */
-uint64_t decode_utf8(std::ifstream &file_stream);
+bool decode_utf8(mc::Buffered_bit_reader &reader, uint64_t &code_point);
 
 /**
  * @brief Decodes a unary encoded integer from a bit reader.
@@ -28,7 +27,7 @@ uint64_t decode_utf8(std::ifstream &file_stream);
  * @param reader The bit reader to read from.
  * @return The decoded unary encoded integer as a 64-bit unsigned integer.
  */
-uint64_t decode_unary(mc::Bit_reader<std::ifstream> &reader);
+uint64_t decode_unary(mc::Buffered_bit_reader &reader);
 
 /**
  * @brief Decodes an Rice encoded integer from a bit reader.
@@ -39,4 +38,4 @@ uint64_t decode_unary(mc::Bit_reader<std::ifstream> &reader);
  * @param reader The bit reader to read from.
  * @return The decoded Rice encoded integer as a 64-bit signed integer.
  */
-int64_t decode_and_unfold_rice(uint8_t rice_parameter, mc::Bit_reader<std::ifstream> &reader);
+int64_t decode_and_unfold_rice(uint8_t rice_parameter, mc::Buffered_bit_reader &reader);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Flac_types.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Where a frame lives in the encoded input and which samples it holds.
+     */
+    struct Frame_location
+    {
+        size_t offset{};         ///< Offset of the frame header in the scanned input.
+        size_t size{};           ///< Size of the frame in bytes, CRC-16 footer included.
+        uint64_t first_sample{}; ///< Index of the frame's first sample in the stream.
+        uint16_t block_size{};   ///< Samples per channel in the frame.
+    };
+
+    /**
+     * @brief Samples lost between two frames because the frame headers in between are damaged.
+     */
+    struct Frame_gap
+    {
+        uint64_t first_sample{}; ///< Index of the first lost sample in the stream.
+        uint64_t samples{};      ///< Samples per channel lost.
+    };
+
+    /**
+     * @brief Parses and validates a frame header without decoding the frame.
+     *
+     * Checks the sync code, the reserved values, the channel count against the stream
+     * and the header CRC-8, so random bytes that happen to look like a sync code are
+     * rejected with high probability.
+     *
+     * @param data The input, starting at the candidate header.
+     * @param stream_info The stream the frame belongs to.
+     * @param frame_info Receives the header fields (crc_16 is left untouched).
+     * @return The size of the header in bytes, or 0 if no valid header starts here.
+     */
+    size_t parse_frame_header(std::span<const uint8_t> data, const Stream_info &stream_info, Frame_info &frame_info);
+
+    /**
+     * @brief Finds the byte boundaries of every frame of a stream.
+     *
+     * Looks for the 14-bit frame sync code, validates candidate headers with their CRC-8
+     * and additionally requires frame (or sample) numbers to follow on from the previous
+     * frame, so sync patterns inside compressed data are not mistaken for frames.
+     * When a header is damaged the scan resumes at the next valid header numbered
+     * further on, and the frames lost in between are reported as a gap; the frame
+     * before a gap then also spans the damaged bytes.
+     *
+     * @param data The encoded frames, starting at the first frame header.
+     * @param stream_info The stream the frames belong to.
+     * @param gaps Receives the gaps in the stream, if not null.
+     * @return The frames in stream order.
+     * @throws std::runtime_error If the input does not start with a valid frame header.
+     */
+    std::vector<Frame_location> scan_frames(std::span<const uint8_t> data, const Stream_info &stream_info, std::vector<Frame_gap> *gaps = nullptr);
+} // namespace mc
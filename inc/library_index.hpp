@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "Metadata_scanner.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Totals of a scan_library() run.
+     */
+    struct Library_scan_stats
+    {
+        uint64_t directories{}; ///< Directories listed.
+        uint64_t files{};       ///< FLAC files indexed.
+        uint64_t failed{};      ///< FLAC files that could not be read, indexed with their error.
+        uint64_t reads{};       ///< pread() calls made.
+        uint64_t bytes_read{};  ///< Bytes read from the files.
+    };
+
+    /**
+     * @brief Appends text to a buffer as a quoted JSON string, escaping what JSON requires.
+     */
+    void append_json_string(std::string &out, std::string_view text);
+
+    /**
+     * @brief Appends the index entry of one file to a buffer, as one line of JSON.
+     *
+     * @param entry The buffer to append to.
+     * @param path The path of the file.
+     * @param metadata The metadata of the file.
+     */
+    void append_index_entry(std::string &entry, const std::string &path, const Flac_metadata &metadata);
+
+    /**
+     * @brief Indexes the metadata of every FLAC file in a directory tree.
+     *
+     * Directories are listed and files scanned in parallel on a work-stealing pool, each
+     * worker keeping its own Metadata_scanner. The index is written as JSON Lines, one
+     * object per file in no particular order: the path, size, modification time, the
+     * STREAMINFO fields, the vendor string, the Vorbis comments in file order, the
+     * embedded pictures with the offset and length of their image data, and the audio
+     * tracks of a CUESHEET with the samples they cover. Files that fail to scan get an
+     * entry with an "error" field instead. Files are recognized by their .flac
+     * extension; symbolic links to directories are not followed.
+     *
+     * @param root The directory to index, or a single file.
+     * @param index The stream to write the index to.
+     * @param thread_count The number of threads, 0 for one per hardware thread.
+     * @return The totals of the scan.
+     */
+    Library_scan_stats scan_library(const std::string &root, std::ostream &index, size_t thread_count = 0);
+} // namespace mc
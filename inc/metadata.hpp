@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Buffered_bit_reader.hpp"
+#include "Flac_types.hpp"
+#include "Metadata_arena.hpp"
+
+namespace mc
+{
+    /**
+     * @brief Reads the body of a STREAMINFO metadata block.
+     *
+     * @param reader The reader, positioned at the start of the block body.
+     * @param stream_info Receives the stream information.
+     * @throws std::runtime_error If the end of the input is reached.
+     */
+    void read_stream_info(Buffered_bit_reader &reader, Stream_info &stream_info);
+
+    /**
+     * @brief Reads the body of a VORBIS_COMMENT metadata block.
+     *
+     * The vendor string and the comments are copied into the arena once; comments
+     * without a '=' are dropped.
+     *
+     * @param reader The reader, positioned at the start of the block body.
+     * @param arena Holds the strings the comment views point to.
+     * @param vorbis_comment Receives the comments.
+     * @throws std::runtime_error If the end of the input is reached.
+     */
+    void read_vorbis_comment(Buffered_bit_reader &reader, Metadata_arena &arena, Vorbis_comment &vorbis_comment);
+
+    /**
+     * @brief Reads the fields of a PICTURE metadata block that precede the image data.
+     *
+     * Stops in front of the image data, which the caller skips or reads as it sees fit.
+     *
+     * @param reader The reader, positioned at the start of the block body.
+     * @param arena Holds the MIME type and description.
+     * @param block_offset The offset of the block body from the start of the file.
+     * @param block_length The length of the block body.
+     * @param picture Receives the picture descriptor.
+     * @throws std::runtime_error If the lengths in the block exceed the block, or the end of the input is reached.
+     */
+    void read_picture(Buffered_bit_reader &reader, Metadata_arena &arena, uint64_t block_offset, uint32_t block_length, Picture &picture);
+
+    /**
+     * @brief Reads the body of a CUESHEET metadata block.
+     *
+     * @param reader The reader, positioned at the start of the block body.
+     * @param arena Holds the media catalog number and the ISRCs.
+     * @param block_length The length of the block body.
+     * @param cue_sheet Receives the tracks and their index points.
+     * @throws std::runtime_error If the tracks and index points do not fit the block, or the end of the input is reached.
+     */
+    void read_cue_sheet(Buffered_bit_reader &reader, Metadata_arena &arena, uint32_t block_length, Cue_sheet &cue_sheet);
+
+    /**
+     * @brief Finds the samples a track of a cue sheet covers.
+     *
+     * The track starts at its index point 1, or its first index point if it has none,
+     * and runs up to the first index point of the next track, so a pregap (index 0)
+     * belongs to the track before it, as when a CD plays straight through.
+     *
+     * @param cue_sheet The cue sheet.
+     * @param track_number The number of the track, as in Cue_track::number.
+     * @param first_sample Receives the first sample of the track.
+     * @param end_sample Receives the sample after the last one of the track.
+     * @return False if the cue sheet has no such audio track.
+     */
+    bool find_cue_track(const Cue_sheet &cue_sheet, uint8_t track_number, uint64_t &first_sample, uint64_t &end_sample);
+} // namespace mc
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mc
+{
+    /**
+     * @brief Instruction set used by the LPC restoration kernels.
+     */
+    enum class Simd_level : uint8_t
+    {
+        SCALAR = 0, ///< Portable C++ kernels.
+        SSE4_1 = 1, ///< 128-bit kernels for the 32-bit accumulator path.
+        AVX2 = 2    ///< 256-bit kernels for the 32-bit accumulator path.
+    };
+
+    /**
+     * @brief Detects the best instruction set the CPU supports.
+     *
+     * @return The highest Simd_level usable on this CPU.
+     */
+    Simd_level detect_simd_level();
+
+    /**
+     * @brief Gets the instruction set currently used by restore_lpc.
+     *
+     * Defaults to detect_simd_level().
+     *
+     * @return The active Simd_level.
+     */
+    Simd_level get_simd_level();
+
+    /**
+     * @brief Selects the instruction set used by restore_lpc.
+     *
+     * Levels the CPU does not support are clamped to the detected level. This is
+     * meant for benchmarks and must not be called while other threads are decoding.
+     *
+     * @param level The requested Simd_level.
+     */
+    void set_simd_level(Simd_level level);
+
+    /**
+     * @brief Restores a FIXED subframe in place.
+     *
+     * The first `order` samples hold the warm-up samples and the rest hold residuals,
+     * which are replaced by the restored signal.
+     *
+     * @param samples The subframe samples.
+     * @param count The number of samples in the subframe.
+     * @param order The predictor order (0 to 4).
+     * @param bits_per_sample The subframe bit depth, used to pick the accumulator width.
+     */
+    void restore_fixed(int32_t *samples, size_t count, uint8_t order, uint8_t bits_per_sample);
+
+    /**
+     * @brief Restores a FIXED subframe in place using 64-bit samples.
+     *
+     * Used for 33-bit side channels of 32-bit streams.
+     *
+     * @param samples The subframe samples.
+     * @param count The number of samples in the subframe.
+     * @param order The predictor order (0 to 4).
+     */
+    void restore_fixed(int64_t *samples, size_t count, uint8_t order);
+
+    /**
+     * @brief Restores an LPC subframe in place.
+     *
+     * The first `order` samples hold the warm-up samples and the rest hold residuals,
+     * which are replaced by the restored signal. The prediction is accumulated in 32 bits
+     * when bits_per_sample and the coefficient magnitudes guarantee it cannot overflow,
+     * and in 64 bits otherwise.
+     *
+     * @param samples The subframe samples.
+     * @param count The number of samples in the subframe.
+     * @param coefficients The quantized predictor coefficients, newest sample first.
+     * @param order The predictor order (1 to 32).
+     * @param shift The quantization shift of the prediction.
+     * @param bits_per_sample The subframe bit depth.
+     */
+    void restore_lpc(int32_t *samples, size_t count, const int32_t *coefficients, uint8_t order,
+                     uint8_t shift, uint8_t bits_per_sample);
+
+    /**
+     * @brief Restores an LPC subframe in place using 64-bit samples.
+     *
+     * Used for 33-bit side channels of 32-bit streams.
+     *
+     * @param samples The subframe samples.
+     * @param count The number of samples in the subframe.
+     * @param coefficients The quantized predictor coefficients, newest sample first.
+     * @param order The predictor order (1 to 32).
+     * @param shift The quantization shift of the prediction.
+     */
+    void restore_lpc(int64_t *samples, size_t count, const int32_t *coefficients, uint8_t order, uint8_t shift);
+} // namespace mc
@@ -0,0 +1,118 @@
+#include "Alsa_output.hpp"
+
+#include <alsa/asoundlib.h>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+    snd_pcm_format_t to_alsa_format(Pcm_format format)
+    {
+        switch (format)
+        {
+        case Pcm_format::S16_LE:
+            return SND_PCM_FORMAT_S16_LE;
+        case Pcm_format::S24_3LE:
+            return SND_PCM_FORMAT_S24_3LE;
+        default:
+            return SND_PCM_FORMAT_S32_LE;
+        }
+    }
+
+    void check(int error, snd_pcm_t *handle, const char *what)
+    {
+        if (error < 0)
+        {
+            snd_pcm_close(handle);
+            throw std::runtime_error(std::string(what) + ": " + snd_strerror(error));
+        }
+    }
+} // namespace
+
+mc::Alsa_output::Alsa_output(const std::string &device, Pcm_format format, uint8_t channels, uint32_t sample_rate)
+    : m_format(format), m_channels(channels)
+{
+    snd_pcm_t *handle;
+    snd_pcm_hw_params_t *params;
+    int error;
+
+    // Open PCM device for playback
+    if ((error = snd_pcm_open(&handle, device.c_str(), SND_PCM_STREAM_PLAYBACK, 0)) < 0)
+    {
+        throw std::runtime_error(std::string("Cannot open audio device: ") + snd_strerror(error));
+    }
+
+    // Allocate hardware parameters object and fill it with default values
+    snd_pcm_hw_params_alloca(&params);
+    check(snd_pcm_hw_params_any(handle, params), handle, "Cannot configure audio device");
+    check(snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_RW_INTERLEAVED), handle, "Cannot set access type");
+
+    // Set sample format, falling back to 32 bits if the device can't take the requested one
+    if (snd_pcm_hw_params_test_format(handle, params, to_alsa_format(m_format)) < 0)
+    {
+        m_format = Pcm_format::S32_LE;
+    }
+    check(snd_pcm_hw_params_set_format(handle, params, to_alsa_format(m_format)), handle, "Cannot set sample format");
+    check(snd_pcm_hw_params_set_channels(handle, params, channels), handle, "Cannot set channel count");
+
+    // Set sample rate; rates the hardware lacks are converted by Resampler, not by ALSA's plug layer
+    snd_pcm_hw_params_set_rate_resample(handle, params, 0);
+    unsigned int actual_rate = sample_rate;
+    check(snd_pcm_hw_params_set_rate_near(handle, params, &actual_rate, 0), handle, "Cannot set sample rate");
+    m_sample_rate = actual_rate;
+
+    // Set buffer size
+    snd_pcm_uframes_t buffer_size = actual_rate; // 1 second buffer
+    check(snd_pcm_hw_params_set_buffer_size_near(handle, params, &buffer_size), handle, "Cannot set buffer size");
+    m_buffer_frames = buffer_size;
+
+    // Apply hardware parameters
+    check(snd_pcm_hw_params(handle, params), handle, "Cannot set parameters");
+
+    m_handle = handle;
+}
+
+mc::Alsa_output::~Alsa_output()
+{
+    snd_pcm_close(m_handle);
+}
+
+bool mc::Alsa_output::write(const std::byte *data, size_t frames)
+{
+    size_t frame_bytes = m_channels * pcm_format_bytes(m_format);
+    size_t written = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    while (written < frames)
+    {
+        snd_pcm_sframes_t result = snd_pcm_writei(m_handle, data + written * frame_bytes, frames - written);
+
+        if (result < 0)
+        {
+            if (result == -EPIPE)
+            {
+                m_stats.underruns.add(1);
+            }
+            if (snd_pcm_recover(m_handle, result, 0) < 0)
+            {
+                return false;
+            }
+            continue;
+        }
+        written += result;
+    }
+
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    m_stats.writes.add(1);
+    m_stats.frames.add(frames);
+    m_stats.write_ns.add(ns);
+    m_stats.max_write_ns.raise_to(ns);
+    m_stats.write_time.record(ns);
+    return true;
+}
+
+void mc::Alsa_output::drain()
+{
+    snd_pcm_drain(m_handle);
+}
@@ -0,0 +1,307 @@
+#include "Decode_scheduler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    void update_max(std::atomic<uint64_t> &maximum, uint64_t value)
+    {
+        uint64_t current = maximum.load(std::memory_order_relaxed);
+        while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t elapsed_ns(std::chrono::steady_clock::time_point since, std::chrono::steady_clock::time_point until)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(until - since).count());
+    }
+} // namespace
+
+mc::Decode_scheduler::Decode_scheduler(const Scheduler_config &config) : m_config(config)
+{
+    if (m_config.period_frames == 0 || m_config.period_frames > UINT16_MAX)
+    {
+        throw std::invalid_argument("Period size must be between 1 and 65535 frames");
+    }
+
+    size_t thread_count = m_config.thread_count;
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_threads.emplace_back(&Decode_scheduler::worker_loop, this);
+    }
+}
+
+mc::Decode_scheduler::~Decode_scheduler()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_stream_ready.notify_all();
+
+    for (auto &thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+mc::Decode_scheduler::Stream_id mc::Decode_scheduler::open_stream(const std::string &path)
+{
+    auto file = std::make_unique<Mapped_file>(path);
+    std::span<const uint8_t> data = file->bytes();
+    return add_stream(std::move(file), data);
+}
+
+mc::Decode_scheduler::Stream_id mc::Decode_scheduler::open_stream(std::span<const uint8_t> data)
+{
+    return add_stream(nullptr, data);
+}
+
+mc::Decode_scheduler::Stream_id mc::Decode_scheduler::add_stream(std::unique_ptr<Mapped_file> file, std::span<const uint8_t> data)
+{
+    auto stream = std::make_shared<Stream>(m_config.queue_periods);
+    stream->file = std::move(file);
+    stream->decoder = std::make_unique<Flac>(data);
+    stream->decoder->set_crc_policy(m_config.crc_policy);
+    stream->decoder->initialize();
+
+    stream->frame_bytes = static_cast<size_t>(stream->decoder->get_stream_info().channels) * pcm_format_bytes(m_config.format);
+    for (size_t i = 0; i < stream->queue.capacity(); i++)
+    {
+        stream->queue.slot(i).data.resize(m_config.period_frames * stream->frame_bytes);
+    }
+
+    Stream_id id;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_config.max_streams != 0 && m_streams.size() >= m_config.max_streams)
+        {
+            throw std::runtime_error("Too many streams open");
+        }
+        id = m_next_id++;
+        m_streams.emplace(id, stream);
+        stream->ready_since = std::chrono::steady_clock::now();
+        m_run_queue.push_back(std::move(stream));
+    }
+    m_stream_ready.notify_one();
+    return id;
+}
+
+void mc::Decode_scheduler::close_stream(Stream_id id)
+{
+    std::lock_guard lock(m_mutex);
+    auto it = m_streams.find(id);
+    if (it == m_streams.end())
+    {
+        return;
+    }
+    // a worker still holding the stream drops it after its current step
+    it->second->closed = true;
+    m_streams.erase(it);
+}
+
+std::shared_ptr<mc::Decode_scheduler::Stream> mc::Decode_scheduler::find_stream(Stream_id id) const
+{
+    std::lock_guard lock(m_mutex);
+    auto it = m_streams.find(id);
+    if (it == m_streams.end())
+    {
+        throw std::invalid_argument("Unknown stream");
+    }
+    return it->second;
+}
+
+bool mc::Decode_scheduler::read_period(Stream_id id, std::span<std::byte> destination, size_t &frames, bool wait)
+{
+    std::shared_ptr<Stream> stream = find_stream(id);
+    if (destination.size() < m_config.period_frames * stream->frame_bytes)
+    {
+        throw std::invalid_argument("PCM buffer is too small for a period");
+    }
+
+    if (wait)
+    {
+        stream->queue.wait_until_size_at_least(1, []
+                                               { return false; });
+    }
+    const Period *period = stream->queue.try_acquire_read();
+    if (period == nullptr)
+    {
+        return false;
+    }
+
+    // the end marker stays queued, so every later read sees it too
+    if (period->frames == 0)
+    {
+        if (stream->error)
+        {
+            std::rethrow_exception(stream->error);
+        }
+        frames = 0;
+        return true;
+    }
+
+    frames = period->frames;
+    std::memcpy(destination.data(), period->data.data(), frames * stream->frame_bytes);
+    stream->queue.release_read();
+    stream->periods_read.fetch_add(1, std::memory_order_relaxed);
+
+    bool resumed = false;
+    {
+        std::lock_guard lock(m_mutex);
+        if (stream->parked && !stream->closed)
+        {
+            stream->parked = false;
+            stream->ready_since = std::chrono::steady_clock::now();
+            m_run_queue.push_back(stream);
+            resumed = true;
+        }
+    }
+    if (resumed)
+    {
+        m_stream_ready.notify_one();
+    }
+    return true;
+}
+
+mc::Stream_stats mc::Decode_scheduler::get_stream_stats(Stream_id id) const
+{
+    std::shared_ptr<Stream> stream = find_stream(id);
+
+    Stream_stats stats;
+    stats.queue_capacity = stream->queue.capacity();
+    stats.queue_depth = stream->queue.size();
+    stats.max_queue_depth = stream->max_queue_depth.load(std::memory_order_relaxed);
+    stats.buffer_bytes = stats.queue_capacity * m_config.period_frames * stream->frame_bytes;
+    stats.frames_decoded = stream->frames_decoded.load(std::memory_order_relaxed);
+    stats.periods_queued = stream->periods_queued.load(std::memory_order_relaxed);
+    stats.periods_read = stream->periods_read.load(std::memory_order_relaxed);
+    stats.backpressure_stalls = stream->backpressure_stalls.load(std::memory_order_relaxed);
+    stats.decode_ns = stream->decode_ns.load(std::memory_order_relaxed);
+    stats.max_decode_ns = stream->max_decode_ns.load(std::memory_order_relaxed);
+    stats.wait_ns = stream->wait_ns.load(std::memory_order_relaxed);
+    stats.max_wait_ns = stream->max_wait_ns.load(std::memory_order_relaxed);
+    stats.finished = stream->finished.load(std::memory_order_acquire);
+    return stats;
+}
+
+bool mc::Decode_scheduler::run_step(Stream &stream)
+{
+    Period *period = stream.queue.try_acquire_write();
+    if (period == nullptr)
+    {
+        return true;
+    }
+
+    try
+    {
+        Flac &decoder = *stream.decoder;
+        if (stream.frame_position == stream.frame_samples && !decoder.eos())
+        {
+            auto start = std::chrono::steady_clock::now();
+            decoder.decode_frame();
+            uint64_t ns = elapsed_ns(start, std::chrono::steady_clock::now());
+            stream.decode_ns.fetch_add(ns, std::memory_order_relaxed);
+            update_max(stream.max_decode_ns, ns);
+            stream.frames_decoded.fetch_add(1, std::memory_order_relaxed);
+
+            stream.frame_samples = decoder.get_frame_info().block_size;
+            stream.frame_position = 0;
+        }
+
+        size_t count = std::min<size_t>(stream.frame_samples - stream.frame_position, m_config.period_frames - stream.period_fill);
+        if (count > 0)
+        {
+            decoder.write_pcm(std::span(period->data).subspan(stream.period_fill * stream.frame_bytes), m_config.format,
+                              stream.frame_position, static_cast<uint16_t>(count));
+            stream.frame_position += static_cast<uint16_t>(count);
+            stream.period_fill += count;
+        }
+
+        bool end = stream.frame_position == stream.frame_samples && decoder.eos();
+        if (stream.period_fill == m_config.period_frames || (end && stream.period_fill > 0))
+        {
+            period->frames = std::exchange(stream.period_fill, 0);
+        }
+        else if (end)
+        {
+            period->frames = 0;
+        }
+        else
+        {
+            return true;
+        }
+    }
+    catch (...)
+    {
+        stream.error = std::current_exception();
+        stream.period_fill = 0;
+        period->frames = 0;
+    }
+
+    bool finished = period->frames == 0;
+    stream.queue.commit_write();
+    stream.periods_queued.fetch_add(1, std::memory_order_relaxed);
+    update_max(stream.max_queue_depth, stream.queue.size());
+    if (finished)
+    {
+        stream.finished.store(true, std::memory_order_release);
+    }
+    return !finished;
+}
+
+void mc::Decode_scheduler::worker_loop()
+{
+    while (true)
+    {
+        std::shared_ptr<Stream> stream;
+        {
+            std::unique_lock lock(m_mutex);
+            m_stream_ready.wait(lock, [this]
+                                { return !m_run_queue.empty() || m_stopping; });
+            if (m_stopping)
+            {
+                return;
+            }
+            stream = std::move(m_run_queue.front());
+            m_run_queue.pop_front();
+            if (stream->closed)
+            {
+                continue;
+            }
+        }
+
+        uint64_t waited = elapsed_ns(stream->ready_since, std::chrono::steady_clock::now());
+        stream->wait_ns.fetch_add(waited, std::memory_order_relaxed);
+        update_max(stream->max_wait_ns, waited);
+
+        if (!run_step(*stream))
+        {
+            continue;
+        }
+
+        std::lock_guard lock(m_mutex);
+        if (stream->closed)
+        {
+            continue;
+        }
+        // checked under the mutex so a read_period() releasing a slot cannot be missed
+        if (stream->queue.try_acquire_write() == nullptr)
+        {
+            stream->parked = true;
+            stream->backpressure_stalls.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        stream->ready_since = std::chrono::steady_clock::now();
+        m_run_queue.push_back(std::move(stream));
+        m_stream_ready.notify_one();
+    }
+}
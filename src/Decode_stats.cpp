@@ -0,0 +1,104 @@
+#include "Decode_stats.hpp"
+
+#include <span>
+
+namespace
+{
+    void add_counters(std::span<mc::Stat_counter> totals, std::span<const mc::Stat_counter> counters)
+    {
+        for (size_t i = 0; i < totals.size(); i++)
+        {
+            totals[i].add(counters[i].get());
+        }
+    }
+
+    void append_field(std::string &out, const char *name, const mc::Stat_counter &counter)
+    {
+        out += out.back() == '{' ? "\"" : ",\"";
+        out += name;
+        out += "\":";
+        out += std::to_string(counter.get());
+    }
+
+    void append_array(std::string &out, const char *name, std::span<const mc::Stat_counter> counters, size_t first = 0)
+    {
+        size_t end = counters.size();
+        while (end > first && counters[end - 1].get() == 0)
+        {
+            end--;
+        }
+
+        out += out.back() == '{' ? "\"" : ",\"";
+        out += name;
+        out += "\":[";
+        for (size_t i = first; i < end; i++)
+        {
+            out += i == first ? "" : ",";
+            out += std::to_string(counters[i].get());
+        }
+        out += ']';
+    }
+} // namespace
+
+void mc::Decode_stats::add(const Decode_stats &other)
+{
+    frames.add(other.frames.get());
+    samples.add(other.samples.get());
+    frame_ns.add(other.frame_ns.get());
+    max_frame_ns.raise_to(other.max_frame_ns.get());
+    add_counters(frame_time.buckets, other.frame_time.buckets);
+    constant_subframes.add(other.constant_subframes.get());
+    verbatim_subframes.add(other.verbatim_subframes.get());
+    add_counters(fixed_subframes, other.fixed_subframes);
+    add_counters(lpc_subframes, other.lpc_subframes);
+    add_counters(partition_orders, other.partition_orders);
+    escaped_partitions.add(other.escaped_partitions.get());
+    header_bits.add(other.header_bits.get());
+    subframe_bits.add(other.subframe_bits.get());
+    residual_bits.add(other.residual_bits.get());
+    footer_bits.add(other.footer_bits.get());
+}
+
+void mc::Output_stats::add(const Output_stats &other)
+{
+    writes.add(other.writes.get());
+    frames.add(other.frames.get());
+    write_ns.add(other.write_ns.get());
+    max_write_ns.raise_to(other.max_write_ns.get());
+    add_counters(write_time.buckets, other.write_time.buckets);
+    underruns.add(other.underruns.get());
+}
+
+void mc::append_stats_json(std::string &out, const Decode_stats &stats)
+{
+    out += '{';
+    append_field(out, "frames", stats.frames);
+    append_field(out, "samples", stats.samples);
+    append_field(out, "frame_ns", stats.frame_ns);
+    append_field(out, "max_frame_ns", stats.max_frame_ns);
+    append_array(out, "frame_ns_log2", stats.frame_time.buckets);
+    append_field(out, "constant", stats.constant_subframes);
+    append_field(out, "verbatim", stats.verbatim_subframes);
+    append_array(out, "fixed_by_order", stats.fixed_subframes);
+    append_array(out, "lpc_by_order", stats.lpc_subframes, 1);
+    append_array(out, "rice_partition_orders", stats.partition_orders);
+    append_field(out, "escaped_partitions", stats.escaped_partitions);
+    out += ",\"bits\":{";
+    append_field(out, "header", stats.header_bits);
+    append_field(out, "subframe", stats.subframe_bits);
+    append_field(out, "residual", stats.residual_bits);
+    append_field(out, "footer", stats.footer_bits);
+    out += "}}";
+}
+
+void mc::append_stats_json(std::string &out, const Output_stats &stats)
+{
+    out += '{';
+    append_field(out, "writes", stats.writes);
+    append_field(out, "frames", stats.frames);
+    append_field(out, "write_ns", stats.write_ns);
+    append_field(out, "max_write_ns", stats.max_write_ns);
+    append_array(out, "write_ns_log2", stats.write_time.buckets);
+    append_field(out, "underruns", stats.underruns);
+    out += '}';
+}
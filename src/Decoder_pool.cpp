@@ -0,0 +1,57 @@
+#include "Decoder_pool.hpp"
+
+std::unique_ptr<mc::Flac> mc::Decoder_pool::take_idle()
+{
+    std::lock_guard lock(m_mutex);
+    if (m_idle.empty())
+    {
+        return nullptr;
+    }
+    std::unique_ptr<Flac> decoder = std::move(m_idle.back());
+    m_idle.pop_back();
+    return decoder;
+}
+
+void mc::Decoder_pool::release(Flac *decoder)
+{
+    std::unique_ptr<Flac> owned(decoder);
+    std::lock_guard lock(m_mutex);
+    if (m_max_idle == 0 || m_idle.size() < m_max_idle)
+    {
+        m_idle.push_back(std::move(owned));
+    }
+}
+
+mc::Decoder_pool::Handle mc::Decoder_pool::acquire(std::span<const uint8_t> data)
+{
+    std::unique_ptr<Flac> decoder = take_idle();
+    if (decoder != nullptr)
+    {
+        decoder->reset(data);
+    }
+    else
+    {
+        decoder = std::make_unique<Flac>(data);
+    }
+
+    Handle handle(decoder.release(), Releaser{this});
+    handle->initialize();
+    return handle;
+}
+
+mc::Decoder_pool::Handle mc::Decoder_pool::acquire(Read_ahead_file &input)
+{
+    std::unique_ptr<Flac> decoder = take_idle();
+    if (decoder != nullptr)
+    {
+        decoder->reset(input);
+    }
+    else
+    {
+        decoder = std::make_unique<Flac>(input);
+    }
+
+    Handle handle(decoder.release(), Releaser{this});
+    handle->initialize();
+    return handle;
+}
@@ -1,22 +1,249 @@
 #include "Flac.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "frame_scanner.hpp"
+
+namespace
+{
+#ifdef MC_STAGE_TIMING
+    /**
+     * Adds the lifetime of the scope to a stage counter.
+     */
+    class Stage_timer
+    {
+    private:
+        uint64_t &m_total;
+        std::chrono::steady_clock::time_point m_start;
+
+    public:
+        explicit Stage_timer(uint64_t &total) : m_total(total), m_start(std::chrono::steady_clock::now()) {}
+        ~Stage_timer()
+        {
+            m_total += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+        }
+    };
+#else
+    class Stage_timer
+    {
+    public:
+        explicit Stage_timer(uint64_t &) {}
+    };
+#endif
+
+    /**
+     * Records a decode_frame() call and its duration, if statistics are collected.
+     */
+    class Frame_recorder
+    {
+    private:
+        mc::Decode_stats *m_stats;
+        const uint16_t &m_block_size;
+        std::chrono::steady_clock::time_point m_start;
+
+    public:
+        Frame_recorder(mc::Decode_stats *stats, const uint16_t &block_size) : m_stats(stats), m_block_size(block_size)
+        {
+            if (m_stats != nullptr)
+            {
+                m_start = std::chrono::steady_clock::now();
+            }
+        }
+        ~Frame_recorder()
+        {
+            if (m_stats == nullptr || m_block_size == 0)
+            {
+                return;
+            }
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+            m_stats->frames.add(1);
+            m_stats->samples.add(m_block_size);
+            m_stats->frame_ns.add(ns);
+            m_stats->max_frame_ns.raise_to(ns);
+            m_stats->frame_time.record(ns);
+        }
+    };
+
+    void count_subframe(mc::Decode_stats &stats, uint8_t subframe_type_code)
+    {
+        if (subframe_type_code == 0b000000)
+        {
+            stats.constant_subframes.add(1);
+        }
+        else if (subframe_type_code == 0b000001)
+        {
+            stats.verbatim_subframes.add(1);
+        }
+        else if ((subframe_type_code & 0b111000) == 0b001000)
+        {
+            stats.fixed_subframes[subframe_type_code & 0b000111].add(1);
+        }
+        else
+        {
+            stats.lpc_subframes[(subframe_type_code & 0b011111) + 1].add(1);
+        }
+    }
+
+    /**
+     * Undoes left/side, side/right and mid/side stereo in place. The side samples
+     * either alias one of the channels or come from the 64-bit side buffer.
+     */
+    template <typename Arithmetic, typename Side>
+    void decorrelate_stereo_samples(uint8_t channel_assignment, int32_t *first, int32_t *second, const Side *side, uint16_t block_size)
+    {
+        switch (channel_assignment)
+        {
+        case 0b1000: // left/side
+            for (uint16_t i = 0; i < block_size; i++)
+            {
+                second[i] = static_cast<int32_t>(static_cast<Arithmetic>(first[i]) - static_cast<Arithmetic>(side[i]));
+            }
+            break;
+        case 0b1001: // side/right
+            for (uint16_t i = 0; i < block_size; i++)
+            {
+                first[i] = static_cast<int32_t>(static_cast<Arithmetic>(side[i]) + static_cast<Arithmetic>(second[i]));
+            }
+            break;
+        case 0b1010: // mid/side
+            for (uint16_t i = 0; i < block_size; i++)
+            {
+                Arithmetic difference = static_cast<Arithmetic>(side[i]);
+                Arithmetic mid = (static_cast<Arithmetic>(first[i]) << 1) | (difference & 1);
+                first[i] = static_cast<int32_t>((mid + difference) >> 1);
+                second[i] = static_cast<int32_t>((mid - difference) >> 1);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    /**
+     * Interleaves planar samples into Bytes-wide little-endian containers, left-aligning
+     * (or truncating) bits_per_sample to the container width.
+     */
+    template <typename Container, size_t Bytes>
+    void write_interleaved(std::byte *destination, const int32_t *const *samples, uint8_t channels, uint16_t count, uint8_t bits_per_sample)
+    {
+        const int8_t shift = static_cast<int8_t>(Bytes * 8) - bits_per_sample;
+        for (uint16_t i = 0; i < count; i++)
+        {
+            for (uint8_t channel = 0; channel < channels; channel++)
+            {
+                int32_t sample = samples[channel][i];
+                uint32_t value = (shift >= 0) ? static_cast<uint32_t>(sample) << shift : static_cast<uint32_t>(sample >> -shift);
+                if constexpr (Bytes == sizeof(Container) && std::endian::native == std::endian::little)
+                {
+                    Container container = static_cast<Container>(value);
+                    std::memcpy(destination, &container, Bytes);
+                }
+                else
+                {
+                    for (size_t byte = 0; byte < Bytes; byte++)
+                    {
+                        destination[byte] = static_cast<std::byte>(value >> (8 * byte));
+                    }
+                }
+                destination += Bytes;
+            }
+        }
+    }
+} // namespace
+
 mc::Flac::~Flac()
 {
-    if (m_flac_stream.is_open())
+    if (m_flac_stream != nullptr && m_flac_stream->is_open())
+    {
+        m_flac_stream->close();
+    }
+}
+
+void mc::Flac::reset(std::span<const uint8_t> data)
+{
+    m_reader.open(data);
+    clear_state();
+}
+
+void mc::Flac::reset(Read_ahead_file &input)
+{
+    m_reader.open(input);
+    clear_state();
+}
+
+void mc::Flac::clear_state()
+{
+    if (m_flac_stream != nullptr && m_flac_stream->is_open())
+    {
+        m_flac_stream->close();
+    }
+    m_flac_stream = nullptr;
+
+    m_channel_index = 0;
+    m_sample_count = 0;
+    m_frame_count = 0;
+    m_stream_info = {};
+    m_frame_info = {};
+    m_metadata_arena.reset();
+    m_vorbis_comment.vendor_string = {};
+    m_vorbis_comment.user_comments.clear();
+    m_pictures.clear();
+    m_cue_sheet = {};
+    m_seek_table.clear();
+    m_first_frame_offset = 0;
+    m_audio_buffer_valid = false;
+    m_stage_timings = {};
+    m_stats = nullptr;
+    m_crc_policy = Crc_policy::VERIFY;
+    m_decode_errors = {};
+    m_next_sample = 0;
+    m_pending_silence = 0;
+    m_range_start = 0;
+    m_range_end = UINT64_MAX;
+    m_frame_pending = false;
+    m_error = nullptr;
+    m_md5_check = false;
+    m_md5_samples = 0;
+    m_md5_status = Md5_status::UNCHECKED;
+    if (m_md5_worker != nullptr)
     {
-        m_flac_stream.close();
+        m_md5_worker->reset();
     }
 }
 
 void mc::Flac::initialize()
 {
-    if (m_flac_stream.is_open() && m_flac_stream.good())
+    if (m_flac_stream == nullptr || (m_flac_stream->is_open() && m_flac_stream->good()))
     {
         check_flac_marker();
         read_metadata();
+        m_first_frame_offset = m_reader.byte_position();
+        m_reader.tune_read_ahead(m_stream_info);
+        allocate_channel_buffers(m_stream_info.max_block_size);
     }
 }
 
+void mc::Flac::initialize(const Stream_info &stream_info)
+{
+    m_stream_info = stream_info;
+    allocate_channel_buffers(m_stream_info.max_block_size);
+}
+
+void mc::Flac::allocate_channel_buffers(uint16_t block_size)
+{
+    // round every channel up to a whole number of cache lines
+    constexpr size_t samples_per_line = 64 / sizeof(int32_t);
+    m_channel_stride = (block_size + samples_per_line - 1) / samples_per_line * samples_per_line;
+    m_channel_samples.assign(m_channel_stride * m_stream_info.channels, 0);
+}
+
 void mc::Flac::check_flac_marker()
 {
     if (m_reader.read_bits_unsigned(32) != Flac_constants::flac_marker)
@@ -42,30 +269,32 @@ void mc::Flac::read_metadata()
             {
                 throw std::runtime_error("STREAMINFO block has unexpected length");
             }
-            read_metadata_block_STREAMINFO();
+            read_stream_info(m_reader, m_stream_info);
             break;
         case block_type::PADDING:
-            m_flac_stream.seekg(block_length, std::ios::cur);
+            m_reader.skip_bytes(block_length);
             break;
         case block_type::APPLICATION:
             // TODO: implement function for APPLICATION block
-            m_flac_stream.seekg(block_length, std::ios::cur);
+            m_reader.skip_bytes(block_length);
             break;
         case block_type::SEEKTABLE:
-            // TODO: implement function for SEEKTABLE block
-            m_flac_stream.seekg(block_length, std::ios::cur);
+            read_metadata_block_SEEKTABLE(block_length);
             break;
         case block_type::VORBIS_COMMENT:
-            read_metadata_block_VORBIS_COMMENT();
+            read_vorbis_comment(m_reader, m_metadata_arena, m_vorbis_comment);
             break;
         case block_type::CUESHEET:
-            // TODO: implement function for CUESHEET block
-            m_flac_stream.seekg(block_length, std::ios::cur);
+            read_cue_sheet(m_reader, m_metadata_arena, block_length, m_cue_sheet);
             break;
         case block_type::PICTURE:
-            // TODO: implement function for PICTURE block
-            m_flac_stream.seekg(block_length, std::ios::cur);
+        {
+            // only the descriptor is read; the image data is skipped without being touched
+            uint64_t block_offset = m_reader.byte_position();
+            read_picture(m_reader, m_metadata_arena, block_offset, block_length, m_pictures.emplace_back());
+            m_reader.skip_bytes(block_offset + block_length - m_reader.byte_position());
             break;
+        }
         default:
             throw std::runtime_error("Unknown block type");
             break;
@@ -73,266 +302,785 @@ void mc::Flac::read_metadata()
     }
 }
 
-void mc::Flac::read_metadata_block_STREAMINFO()
+void mc::Flac::read_metadata_block_SEEKTABLE(uint32_t block_length)
 {
-    m_stream_info.min_block_size = m_reader.read_bits_unsigned(16);
-    m_stream_info.max_block_size = m_reader.read_bits_unsigned(16);
-    m_stream_info.min_frame_size = m_reader.read_bits_unsigned(24);
-    m_stream_info.max_frame_size = m_reader.read_bits_unsigned(24);
-    m_stream_info.sample_rate = m_reader.read_bits_unsigned(20);
-    m_stream_info.channels = m_reader.read_bits_unsigned(3) + 1;
-    m_stream_info.bits_per_sample = m_reader.read_bits_unsigned(5) + 1;
-    m_stream_info.total_samples = m_reader.read_bits_unsigned(36);
+    constexpr uint64_t placeholder = 0xFFFFFFFFFFFFFFFF;
+    uint32_t point_count = block_length / 18;
 
-    m_flac_stream.seekg(16, std::ios::cur); // skipping 16 bytes (md5 signature)
+    m_seek_table.clear();
+    m_seek_table.reserve(point_count);
+    for (uint32_t i = 0; i < point_count; i++)
+    {
+        Seek_point point;
+        point.sample_number = m_reader.read_bits_unsigned(64);
+        point.stream_offset = m_reader.read_bits_unsigned(64);
+        point.frame_samples = m_reader.read_bits_unsigned(16);
+        if (point.sample_number != placeholder)
+        {
+            m_seek_table.push_back(point);
+        }
+    }
+    m_reader.skip_bytes(block_length - point_count * 18);
+
+    std::sort(m_seek_table.begin(), m_seek_table.end(), [](const Seek_point &a, const Seek_point &b)
+              { return a.sample_number < b.sample_number; });
 }
 
-void mc::Flac::read_metadata_block_VORBIS_COMMENT()
+void mc::Flac::decode_frame()
 {
-    uint32_t vendor_length;
-    m_flac_stream.read(reinterpret_cast<char *>(&vendor_length), 4);
-
-    std::vector<char> vendor_data(vendor_length);
-    m_flac_stream.read(vendor_data.data(), vendor_length);
-    m_vorbis_comment.vendor_string = std::string(vendor_data.begin(), vendor_data.end());
+    // select_range() has already decoded the first frame of the range
+    if (m_frame_pending)
+    {
+        m_frame_pending = false;
+        return;
+    }
+    if (eos())
+    {
+        return;
+    }
+    Stage_timer timer(m_stage_timings.frame_ns);
+    Frame_recorder recorder(m_stats, m_frame_info.block_size);
 
-    uint32_t user_comment_count;
-    m_flac_stream.read(reinterpret_cast<char *>(&user_comment_count), 4);
+    decode_next_frame();
+    trim_frame(0);
+}
 
-    m_vorbis_comment.user_comments.clear();
-    for (uint32_t i = 0; i < user_comment_count; i++)
+void mc::Flac::decode_next_frame()
+{
+    // only the recovering policies resynchronize; the others report the first error
+    bool recovering = m_crc_policy == Crc_policy::SKIP || m_crc_policy == Crc_policy::CONCEAL;
+    while (true)
     {
-        uint32_t comment_length;
-        m_flac_stream.read(reinterpret_cast<char *>(&comment_length), 4);
+        if (m_pending_silence > 0)
+        {
+            emit_silence();
+            return;
+        }
+        if (m_reader.eos())
+        {
+            m_frame_info.block_size = 0;
+            return;
+        }
 
-        std::vector<char> comment_data(comment_length);
-        m_flac_stream.read(comment_data.data(), comment_length);
-        std::string comment(comment_data.begin(), comment_data.end());
+        uint64_t frame_offset = m_reader.byte_position();
+        Frame_status status = read_frame(recovering);
 
-        size_t delimiter_pos = comment.find('=');
-        if (delimiter_pos != std::string::npos)
+        if (status == Frame_status::DECODED)
         {
-            std::string key = comment.substr(0, delimiter_pos);
-            std::string value = comment.substr(delimiter_pos + 1);
-            m_vorbis_comment.user_comments[key] = value;
+            return;
+        }
+        if (status == Frame_status::CORRUPT)
+        {
+            m_decode_errors.corrupt_frames++;
+            resynchronize(frame_offset + 1);
         }
     }
 }
 
-void mc::Flac::decode_frame()
+void mc::Flac::trim_frame(uint16_t offset)
 {
-    if (m_reader.eos())
+    // the last frame of a range usually runs past its end, the first one starts before it
+    uint16_t block_size = m_frame_info.block_size;
+    if (m_next_sample > m_range_end)
     {
-        return;
+        block_size -= static_cast<uint16_t>(std::min<uint64_t>(block_size, m_next_sample - m_range_end));
+    }
+    offset = std::min(offset, block_size);
+    if (offset > 0)
+    {
+        for (uint8_t channel = 0; channel < m_stream_info.channels; channel++)
+        {
+            std::copy(channel_samples(channel) + offset, channel_samples(channel) + block_size, channel_samples(channel));
+        }
+        m_audio_buffer_valid = false;
+    }
+    m_frame_info.block_size = block_size - offset;
+}
+
+void mc::Flac::select_range(uint64_t first_sample, uint64_t end_sample)
+{
+    if (first_sample >= end_sample)
+    {
+        throw std::out_of_range("Sample range is empty");
+    }
+
+    m_range_start = 0;
+    m_range_end = UINT64_MAX;
+    uint16_t offset = seek_to_sample(first_sample);
+    m_range_start = first_sample;
+    m_range_end = end_sample;
+    trim_frame(offset);
+    m_frame_pending = true;
+}
+
+void mc::Flac::select_track(uint8_t track_number)
+{
+    uint64_t first_sample;
+    uint64_t end_sample;
+    if (!find_cue_track(m_cue_sheet, track_number, first_sample, end_sample))
+    {
+        throw std::out_of_range("The cue sheet has no audio track " + std::to_string(track_number));
     }
+    select_range(first_sample, end_sample);
+}
+
+bool mc::Flac::fail(const char *message)
+{
+    m_error = message;
+    return false;
+}
 
-    if (m_reader.read_bits_unsigned(14) != Flac_constants::frame_sync_code)
+mc::Flac::Frame_status mc::Flac::frame_error(bool recovering, const char *message)
+{
+    if (!recovering)
     {
-        throw std::runtime_error("Invalid sync code in frame header");
+        // running out of input sends the decoder through zeros, which is the real cause
+        throw std::runtime_error(m_reader.overrun() ? "End of stream reached." : message);
     }
-    if (m_reader.read_bits_unsigned(1))
+    return Frame_status::CORRUPT;
+}
+
+mc::Flac::Frame_status mc::Flac::read_frame(bool recovering)
+{
+    bool check_crc = m_crc_policy != Crc_policy::IGNORE;
+    if (check_crc)
     {
-        throw std::runtime_error("1st reserved bit in frame isn't 0");
+        m_reader.start_crc();
     }
+    uint64_t frame_start = m_reader.bit_position();
+    m_residual_bits = 0;
 
-    m_frame_info.blocking_strategy = m_reader.read_bits_unsigned(1);
-    uint8_t block_size_code = m_reader.read_bits_unsigned(4);
-    uint8_t sample_rate_code = m_reader.read_bits_unsigned(4);
-    m_frame_info.channel_assignment = m_reader.read_bits_unsigned(4);
-    m_frame_info.bits_per_sample = decode_sample_size(m_reader.read_bits_unsigned(3));
+    if (m_reader.read_bits(14) != Flac_constants::frame_sync_code)
+    {
+        return frame_error(recovering, "Invalid sync code in frame header");
+    }
+    if (m_reader.read_bits(1))
+    {
+        return frame_error(recovering, "1st reserved bit in frame isn't 0");
+    }
+
+    m_frame_info.blocking_strategy = m_reader.read_bits(1);
+    uint8_t block_size_code = m_reader.read_bits(4);
+    uint8_t sample_rate_code = m_reader.read_bits(4);
+    m_frame_info.channel_assignment = m_reader.read_bits(4);
+    uint8_t sample_size_code = m_reader.read_bits(3);
 
-    if (m_reader.read_bits_unsigned(1))
+    if (block_size_code == 0b0000)
+    {
+        return frame_error(recovering, "block size code has reserved value (0000)");
+    }
+    if (sample_rate_code == 0b1111)
+    {
+        return frame_error(recovering, "Invalid sample rate code");
+    }
+    if (sample_size_code == 0b011)
+    {
+        return frame_error(recovering, "Sample size code has reserved value");
+    }
+    if (m_frame_info.channel_assignment > 0b1010)
+    {
+        return frame_error(recovering, "Channel assignment has reserved value");
+    }
+    if ((m_frame_info.channel_assignment <= 0b0111 ? m_frame_info.channel_assignment + 1 : 2) != m_stream_info.channels)
     {
-        throw std::runtime_error("2nd reserved bit in frame isn't 0");
+        return frame_error(recovering, "Channel assignment does not match the stream");
+    }
+    if (m_reader.read_bits(1))
+    {
+        return frame_error(recovering, "2nd reserved bit in frame isn't 0");
     }
 
-    m_frame_info.frame_or_sample_number = decode_utf8(m_flac_stream);
+    m_frame_info.bits_per_sample = decode_sample_size(sample_size_code);
+    if (!decode_utf8(m_reader, m_frame_info.frame_or_sample_number))
+    {
+        return frame_error(recovering, "Invalid UTF-8 coded frame number");
+    }
 
     m_frame_info.block_size = decode_block_size(block_size_code);
     m_frame_info.sample_rate = decode_sample_rate(sample_rate_code);
 
-    m_frame_info.crc_8 = m_reader.read_bits_unsigned(8);
+    uint8_t header_crc = check_crc ? m_reader.finish_crc8() : 0;
+    m_frame_info.crc_8 = m_reader.read_bits(8);
+    if (header_crc != m_frame_info.crc_8 && check_crc)
+    {
+        return frame_error(recovering, "Frame header CRC-8 mismatch");
+    }
+
+    uint64_t header_end = m_reader.bit_position();
 
-    m_audio_buffer.resize(m_stream_info.channels * m_frame_info.block_size);
+    if (m_frame_info.block_size > m_channel_stride)
+    {
+        // the stream lied about its maximum block size
+        allocate_channel_buffers(m_frame_info.block_size);
+    }
 
     if (m_frame_info.channel_assignment <= 0b0111)
     {
         for (m_channel_index = 0; m_channel_index < m_stream_info.channels; m_channel_index++)
         {
-            decode_subframe(m_frame_info.bits_per_sample);
+            if (!decode_subframe(m_frame_info.bits_per_sample))
+            {
+                return frame_error(recovering, m_error);
+            }
         }
     }
-    else if (m_frame_info.channel_assignment <= 0b1010)
+    else
     {
         m_channel_index = 0;
-        decode_subframe(m_frame_info.bits_per_sample + ((m_frame_info.channel_assignment == 0b1001) ? 1 : 0));
+        if (!decode_subframe(m_frame_info.bits_per_sample + ((m_frame_info.channel_assignment == 0b1001) ? 1 : 0)))
+        {
+            return frame_error(recovering, m_error);
+        }
 
         m_channel_index = 1;
-        decode_subframe(m_frame_info.bits_per_sample + ((m_frame_info.channel_assignment == 0b1001) ? 0 : 1));
+        if (!decode_subframe(m_frame_info.bits_per_sample + ((m_frame_info.channel_assignment == 0b1001) ? 0 : 1)))
+        {
+            return frame_error(recovering, m_error);
+        }
+
+        decorrelate_stereo();
+    }
+
+    m_audio_buffer_valid = false;
+    uint64_t subframes_end = m_reader.bit_position();
+    m_reader.align_to_byte();
+    uint16_t frame_crc = check_crc ? m_reader.finish_crc16() : 0;
+    m_frame_info.crc_16 = m_reader.read_bits(16);
+
+    // every read above skips the end-of-input check, so it is done once here
+    if (m_reader.overrun())
+    {
+        return frame_error(recovering, "End of stream reached.");
+    }
 
-        if (m_frame_info.channel_assignment == 8)
+    if (m_stats != nullptr)
+    {
+        m_stats->header_bits.add(header_end - frame_start);
+        m_stats->subframe_bits.add(subframes_end - header_end - m_residual_bits);
+        m_stats->residual_bits.add(m_residual_bits);
+        m_stats->footer_bits.add(m_reader.bit_position() - subframes_end);
+    }
+
+    m_next_sample = first_sample_of(m_frame_info) + m_frame_info.block_size;
+
+    if (frame_crc != m_frame_info.crc_16 && check_crc)
+    {
+        if (m_crc_policy == Crc_policy::VERIFY)
         {
-            for (uint16_t i = 0; i < 2 * m_frame_info.block_size; i += 2)
-            {
-                m_audio_buffer[i + 1] = m_audio_buffer[i] - m_audio_buffer[i + 1];
-            }
+            throw std::runtime_error("Frame CRC-16 mismatch");
         }
-        else if (m_frame_info.channel_assignment == 9)
+        m_decode_errors.crc_mismatches++;
+        if (m_crc_policy == Crc_policy::SKIP)
         {
-            for (uint16_t i = 0; i < 2 * m_frame_info.block_size; i += 2)
-            {
-                m_audio_buffer[i] += m_audio_buffer[i + 1];
-            }
+            m_decode_errors.skipped_samples += m_frame_info.block_size;
+            return Frame_status::DROPPED;
+        }
+        for (uint8_t channel = 0; channel < m_stream_info.channels; channel++)
+        {
+            std::fill_n(channel_samples(channel), m_frame_info.block_size, 0);
+        }
+        m_decode_errors.concealed_samples += m_frame_info.block_size;
+    }
+
+    m_sample_count += m_frame_info.block_size;
+    m_frame_count++;
+    if (m_md5_check)
+    {
+        update_md5();
+    }
+    return Frame_status::DECODED;
+}
+
+void mc::Flac::resynchronize(uint64_t offset)
+{
+    m_decode_errors.resyncs++;
+
+    // the next frame that passes its header checks and does not go back in time
+    uint64_t input_size = m_reader.input_size();
+    uint64_t frame_offset;
+    uint64_t first_sample;
+    uint64_t resume_sample;
+    if (find_frame_header(offset, input_size, m_next_sample, frame_offset, first_sample))
+    {
+        m_reader.seek(frame_offset);
+        resume_sample = first_sample;
+    }
+    else
+    {
+        // truncated stream: whatever STREAMINFO promised after this point is lost
+        m_reader.seek(input_size);
+        resume_sample = std::max(m_stream_info.total_samples, m_next_sample);
+    }
+
+    uint64_t lost_samples = resume_sample - m_next_sample;
+    if (m_crc_policy == Crc_policy::CONCEAL)
+    {
+        m_pending_silence += lost_samples;
+    }
+    else
+    {
+        m_decode_errors.skipped_samples += lost_samples;
+        m_next_sample = resume_sample;
+    }
+}
+
+void mc::Flac::emit_silence()
+{
+    uint16_t block_size = static_cast<uint16_t>(std::min<uint64_t>(m_pending_silence, m_channel_stride));
+    for (uint8_t channel = 0; channel < m_stream_info.channels; channel++)
+    {
+        std::fill_n(channel_samples(channel), block_size, 0);
+    }
+
+    m_frame_info.blocking_strategy = 1;
+    m_frame_info.block_size = block_size;
+    m_frame_info.sample_rate = m_stream_info.sample_rate;
+    m_frame_info.channel_assignment = m_stream_info.channels - 1;
+    m_frame_info.bits_per_sample = m_stream_info.bits_per_sample;
+    m_frame_info.frame_or_sample_number = m_next_sample;
+    m_frame_info.crc_8 = 0;
+    m_frame_info.crc_16 = 0;
+
+    m_pending_silence -= block_size;
+    m_next_sample += block_size;
+    m_sample_count += block_size;
+    m_decode_errors.concealed_samples += block_size;
+    m_audio_buffer_valid = false;
+    if (m_md5_check)
+    {
+        update_md5();
+    }
+}
+
+void mc::Flac::update_md5()
+{
+    // the signature covers samples sign-extended to whole bytes, interleaved and little-endian
+    uint8_t channels = m_stream_info.channels;
+    uint8_t bytes = (m_stream_info.bits_per_sample + 7) / 8;
+    uint16_t count = m_frame_info.block_size;
+    std::span<uint8_t> piece = m_md5_worker->begin_piece(static_cast<size_t>(count) * channels * bytes);
+
+    const int32_t *samples[8];
+    for (uint8_t channel = 0; channel < channels; channel++)
+    {
+        samples[channel] = channel_samples(channel);
+    }
+
+    auto destination = reinterpret_cast<std::byte *>(piece.data());
+    switch (bytes)
+    {
+    case 1:
+        write_interleaved<int8_t, 1>(destination, samples, channels, count, 8);
+        break;
+    case 2:
+        write_interleaved<int16_t, 2>(destination, samples, channels, count, 16);
+        break;
+    case 3:
+        write_interleaved<int32_t, 3>(destination, samples, channels, count, 24);
+        break;
+    default:
+        write_interleaved<int32_t, 4>(destination, samples, channels, count, 32);
+        break;
+    }
+
+    m_md5_worker->commit_piece();
+    m_md5_samples += count;
+}
+
+Md5_status mc::Flac::get_md5_status()
+{
+    if (m_md5_status != Md5_status::UNCHECKED || !m_md5_check)
+    {
+        return m_md5_status;
+    }
+
+    if (!eos() && m_md5_samples != m_stream_info.total_samples)
+    {
+        return Md5_status::UNCHECKED;
+    }
+
+    if (std::all_of(m_stream_info.md5_signature.begin(), m_stream_info.md5_signature.end(), [](uint8_t byte)
+                    { return byte == 0; }))
+    {
+        m_md5_status = Md5_status::NO_SIGNATURE;
+    }
+    else
+    {
+        m_md5_status = m_md5_worker->finish() == m_stream_info.md5_signature ? Md5_status::MATCH : Md5_status::MISMATCH;
+    }
+    return m_md5_status;
+}
+
+uint16_t mc::Flac::seek_to_sample(uint64_t sample)
+{
+    // the signature can only be checked over the whole stream in order
+    m_md5_check = false;
+    m_frame_pending = false;
+
+    sample += m_range_start;
+    if (sample >= m_range_end || (m_stream_info.total_samples != 0 && sample >= m_stream_info.total_samples))
+    {
+        throw std::out_of_range("Seek target is past the end of the stream");
+    }
+
+    // bracket the target between the surrounding seek points, or the whole stream
+    uint64_t low_offset = m_first_frame_offset;
+    uint64_t low_sample = 0;
+    uint64_t high_offset = m_reader.input_size();
+
+    auto next_point = std::upper_bound(m_seek_table.begin(), m_seek_table.end(), sample, [](uint64_t target, const Seek_point &point)
+                                       { return target < point.sample_number; });
+    if (next_point != m_seek_table.begin())
+    {
+        low_offset = m_first_frame_offset + std::prev(next_point)->stream_offset;
+        low_sample = std::prev(next_point)->sample_number;
+    }
+    if (next_point != m_seek_table.end())
+    {
+        high_offset = m_first_frame_offset + next_point->stream_offset;
+    }
+
+    // bisect over frame headers until only a few frames are left to decode
+    uint64_t close_enough = 4 * std::max<uint64_t>(m_stream_info.max_frame_size, 1 << 12);
+    while (high_offset - low_offset > close_enough)
+    {
+        uint64_t middle = low_offset + (high_offset - low_offset) / 2;
+        uint64_t frame_offset;
+        uint64_t first_sample;
+
+        if (find_frame_header(middle, high_offset, 0, frame_offset, first_sample) && first_sample <= sample)
+        {
+            low_offset = frame_offset;
+            low_sample = first_sample;
+        }
+        else
+        {
+            high_offset = middle;
+        }
+    }
+
+    m_reader.seek(low_offset);
+    m_pending_silence = 0;
+    m_next_sample = low_sample;
+    uint64_t frame_first_sample;
+    while (true)
+    {
+        if (eos())
+        {
+            throw std::out_of_range("Seek target is past the end of the stream");
         }
-        else if (m_frame_info.channel_assignment == 10)
+        decode_frame();
+        // from the frame itself, since frames dropped under Crc_policy::SKIP never come back
+        frame_first_sample = first_sample_of(m_frame_info);
+        if (m_frame_info.block_size != 0 && sample < frame_first_sample + m_frame_info.block_size)
         {
-            int64_t mid{};
-            for (uint16_t i = 0; i < 2 * m_frame_info.block_size; i += 2)
+            break;
+        }
+    }
+
+    m_sample_count = frame_first_sample + m_frame_info.block_size;
+    // a target inside a dropped frame lands on the first sample after it
+    return sample > frame_first_sample ? sample - frame_first_sample : 0;
+}
+
+uint64_t mc::Flac::first_sample_of(const Frame_info &header) const
+{
+    // fixed-blocksize streams number frames, all but the last one max_block_size long
+    return header.blocking_strategy ? header.frame_or_sample_number : header.frame_or_sample_number * m_stream_info.max_block_size;
+}
+
+bool mc::Flac::find_frame_header(uint64_t offset, uint64_t end, uint64_t min_sample, uint64_t &frame_offset, uint64_t &first_sample)
+{
+    // a window longer than the largest frame holds the start of the next frame
+    size_t window_size = (m_stream_info.max_frame_size != 0 ? m_stream_info.max_frame_size : 1 << 16) + 16;
+    m_header_window.resize(window_size);
+    uint8_t *window = m_header_window.data();
+
+    Frame_info header;
+    while (offset < end)
+    {
+        m_reader.seek(offset);
+        size_t size = m_reader.read_some_bytes(window, window_size);
+        std::span<const uint8_t> bytes(window, size);
+
+        for (size_t i = 0; i + 1 < size && offset + i < end; i++)
+        {
+            if (bytes[i] != 0xFF || parse_frame_header(bytes.subspan(i), m_stream_info, header) == 0)
             {
-                mid = (uint64_t)m_audio_buffer[i] << 1;
-                mid |= m_audio_buffer[i + 1] & 1;
-                m_audio_buffer[i] = (mid + m_audio_buffer[i + 1]) >> 1;
-                m_audio_buffer[i + 1] = (mid - m_audio_buffer[i + 1]) >> 1;
+                continue;
             }
+
+            first_sample = first_sample_of(header);
+            if (first_sample >= min_sample && (m_stream_info.total_samples == 0 || first_sample < m_stream_info.total_samples))
+            {
+                frame_offset = offset + i;
+                return true;
+            }
+        }
+
+        if (size < window_size)
+        {
+            break;
         }
+        // the last bytes of the window may hold the start of a header cut in half
+        offset += size - 16;
     }
+    return false;
+}
+
+void mc::Flac::decorrelate_stereo()
+{
+    Stage_timer timer(m_stage_timings.decorrelation_ns);
+    int32_t *first = channel_samples(0);
+    int32_t *second = channel_samples(1);
 
-    for (size_t i = 0; i < m_audio_buffer.size(); i++)
+    // the side channel of a 32-bit stream has 33 bits and was decoded into the wide buffer
+    if (m_frame_info.bits_per_sample == 32)
     {
-        m_audio_buffer[i] = m_audio_buffer[i] << (32 - m_frame_info.bits_per_sample);
+        const int64_t *side = m_wide_subframe_buffer.data();
+        decorrelate_stereo_samples<int64_t>(m_frame_info.channel_assignment, first, second, side, m_frame_info.block_size);
+        return;
     }
 
-    m_sample_count += m_frame_info.block_size;
-    m_frame_count++;
-    m_reader.align_to_byte();
-    m_frame_info.crc_16 = m_reader.read_bits_unsigned(16);
+    const int32_t *side = (m_frame_info.channel_assignment == 0b1001) ? first : second;
+    if (m_frame_info.bits_per_sample > 30)
+    {
+        // mid * 2 + side would overflow 32 bits
+        decorrelate_stereo_samples<int64_t>(m_frame_info.channel_assignment, first, second, side, m_frame_info.block_size);
+    }
+    else
+    {
+        decorrelate_stereo_samples<int32_t>(m_frame_info.channel_assignment, first, second, side, m_frame_info.block_size);
+    }
+}
+
+const std::vector<buffer_sample_type> &mc::Flac::get_audio_buffer()
+{
+    if (!m_audio_buffer_valid)
+    {
+        m_audio_buffer.resize(m_stream_info.channels * m_frame_info.block_size);
+        write_pcm(std::as_writable_bytes(std::span(m_audio_buffer)), Pcm_format::S32_LE, 0, m_frame_info.block_size);
+        m_audio_buffer_valid = true;
+    }
+    return m_audio_buffer;
+}
+
+void mc::Flac::write_pcm(std::span<std::byte> destination, Pcm_format format, uint16_t offset, uint16_t count) const
+{
+    uint8_t channels = m_stream_info.channels;
+    if (offset + count > m_frame_info.block_size)
+    {
+        throw std::invalid_argument("PCM range exceeds the frame");
+    }
+    if (destination.size() < static_cast<size_t>(count) * channels * pcm_format_bytes(format))
+    {
+        throw std::invalid_argument("PCM buffer is too small for the frame");
+    }
+
+    const int32_t *samples[8];
+    for (uint8_t channel = 0; channel < channels; channel++)
+    {
+        samples[channel] = m_channel_samples.data() + channel * m_channel_stride + offset;
+    }
+
+    switch (format)
+    {
+    case Pcm_format::S16_LE:
+        write_interleaved<int16_t, 2>(destination.data(), samples, channels, count, m_frame_info.bits_per_sample);
+        break;
+    case Pcm_format::S24_3LE:
+        write_interleaved<int32_t, 3>(destination.data(), samples, channels, count, m_frame_info.bits_per_sample);
+        break;
+    case Pcm_format::S32_LE:
+        write_interleaved<int32_t, 4>(destination.data(), samples, channels, count, m_frame_info.bits_per_sample);
+        break;
+    }
 }
 
-void mc::Flac::decode_subframe(uint8_t bits_per_sample)
+size_t mc::Flac::decode_frame_into(std::span<std::byte> destination, Pcm_format format)
 {
-    if (m_reader.read_bits_unsigned(1) != 0)
+    if (eos())
     {
-        throw std::runtime_error("The first bit of the subframe is non-zero");
+        return 0;
     }
 
-    uint8_t subframe_type_code = m_reader.read_bits_unsigned(6);
+    decode_frame();
+    write_pcm(destination, format, 0, m_frame_info.block_size);
+    return m_frame_info.block_size;
+}
+
+bool mc::Flac::decode_subframe(uint8_t bits_per_sample)
+{
+    if (m_reader.read_bits(1) != 0)
+    {
+        return fail("The first bit of the subframe is non-zero");
+    }
+
+    uint8_t subframe_type_code = m_reader.read_bits(6);
     if ((subframe_type_code >= 2 && subframe_type_code <= 7) ||
         (subframe_type_code >= 16 && subframe_type_code <= 31))
     {
-        throw std::runtime_error("subframe type has reserved value");
+        return fail("subframe type has reserved value");
     }
 
     uint8_t wasted_bits_per_sample{};
-    if (m_reader.read_bits_unsigned(1))
+    if (m_reader.read_bits(1))
     {
         wasted_bits_per_sample = static_cast<uint8_t>(decode_unary(m_reader)) + 1;
-        bits_per_sample -= wasted_bits_per_sample;
+        if (wasted_bits_per_sample >= bits_per_sample)
+        {
+            return fail("Wasted bits exceed the sample size");
+        }
+    }
+
+    // only the side channel of a 32-bit stream needs more than 32 bits per sample
+    bool decoded;
+    if (bits_per_sample <= 32)
+    {
+        decoded = decode_subframe_samples(channel_samples(m_channel_index), subframe_type_code, wasted_bits_per_sample, bits_per_sample);
+    }
+    else
+    {
+        m_wide_subframe_buffer.resize(m_frame_info.block_size);
+        decoded = decode_subframe_samples(m_wide_subframe_buffer.data(), subframe_type_code, wasted_bits_per_sample, bits_per_sample);
+    }
+
+    if (decoded && m_stats != nullptr)
+    {
+        count_subframe(*m_stats, subframe_type_code);
     }
+    return decoded;
+}
 
-    uint8_t predictor_order{};
+template <typename Sample>
+bool mc::Flac::decode_subframe_samples(Sample *samples, uint8_t subframe_type_code, uint8_t wasted_bits_per_sample, uint8_t bits_per_sample)
+{
+    bits_per_sample -= wasted_bits_per_sample;
 
     if (subframe_type_code == 0b000000)
     {
-        buffer_sample_type value = m_reader.read_bits_unsigned(bits_per_sample);
-        for (uint16_t i = 0; i < m_stream_info.channels * m_frame_info.block_size; i += m_stream_info.channels)
-        {
-            m_audio_buffer[i + m_channel_index] = value;
-        }
+        Sample value = m_reader.read_bits_signed(bits_per_sample);
+        std::fill_n(samples, m_frame_info.block_size, value);
     }
     else if (subframe_type_code == 0b000001)
     {
-        for (uint16_t i = 0; i < m_stream_info.channels * m_frame_info.block_size; i += m_stream_info.channels)
-        {
-            m_audio_buffer[i + m_channel_index] = m_reader.read_bits_signed(bits_per_sample);
-        }
+        m_reader.read_signed_block(samples, m_frame_info.block_size, 1, bits_per_sample);
     }
     else if ((subframe_type_code & 0b111000) == 0b001000)
     {
-        predictor_order = subframe_type_code & 0b000111;
+        uint8_t predictor_order = subframe_type_code & 0b000111;
         if (predictor_order > 4)
         {
-            throw std::runtime_error("SUBFRAME_FIXED has invalid order");
+            return fail("SUBFRAME_FIXED has invalid order");
+        }
+        if (!decode_subframe_fixed(samples, predictor_order, bits_per_sample))
+        {
+            return false;
         }
-        decode_subframe_fixed(predictor_order, bits_per_sample);
     }
     else if ((subframe_type_code & 0b100000) == 0b100000)
     {
-        predictor_order = (subframe_type_code & 0b011111) + 1;
-        decode_subframe_lpc(predictor_order, bits_per_sample);
+        uint8_t predictor_order = (subframe_type_code & 0b011111) + 1;
+        if (!decode_subframe_lpc(samples, predictor_order, bits_per_sample))
+        {
+            return false;
+        }
     }
     else
     {
-        throw std::runtime_error("Unknown subframe type");
+        return fail("Unknown subframe type");
     }
+
     if (wasted_bits_per_sample > 0)
     {
-        for (uint16_t i = 0; i < m_audio_buffer.size(); i += m_stream_info.channels)
+        for (uint16_t i = 0; i < m_frame_info.block_size; i++)
         {
-            m_audio_buffer[i + m_channel_index] <<= wasted_bits_per_sample;
+            samples[i] <<= wasted_bits_per_sample;
         }
     }
+    return true;
 }
 
-void mc::Flac::decode_subframe_fixed(uint8_t predictor_order, uint8_t bits_per_sample)
+template <typename Sample>
+bool mc::Flac::decode_subframe_fixed(Sample *samples, uint8_t predictor_order, uint8_t bits_per_sample)
 {
-    for (uint8_t i = 0; i < m_stream_info.channels * predictor_order; i += m_stream_info.channels)
+    if (predictor_order > m_frame_info.block_size)
     {
-        m_audio_buffer[i + m_channel_index] = m_reader.read_bits_signed(bits_per_sample);
+        return fail("Predictor order exceeds block size");
     }
-    decode_residuals(predictor_order);
+    m_reader.read_signed_block(samples, predictor_order, 1, bits_per_sample);
 
-    linear_prediction(predictor_order, Flac_constants::fixed_prediction_coefficients[predictor_order], 0);
+    if (!decode_residuals(samples, predictor_order))
+    {
+        return false;
+    }
+
+    Stage_timer timer(m_stage_timings.prediction_ns);
+    if constexpr (std::is_same_v<Sample, int32_t>)
+    {
+        restore_fixed(samples, m_frame_info.block_size, predictor_order, bits_per_sample);
+    }
+    else
+    {
+        restore_fixed(samples, m_frame_info.block_size, predictor_order);
+    }
+    return true;
 }
 
-void mc::Flac::decode_subframe_lpc(uint8_t predictor_order, uint8_t bits_per_sample)
+template <typename Sample>
+bool mc::Flac::decode_subframe_lpc(Sample *samples, uint8_t predictor_order, uint8_t bits_per_sample)
 {
-    for (uint8_t i = 0; i < m_stream_info.channels * predictor_order; i += m_stream_info.channels)
+    if (predictor_order > m_frame_info.block_size)
     {
-        m_audio_buffer[i + m_channel_index] = m_reader.read_bits_signed(bits_per_sample);
+        return fail("Predictor order exceeds block size");
     }
+    m_reader.read_signed_block(samples, predictor_order, 1, bits_per_sample);
 
-    uint8_t qlp_bit_precision = m_reader.read_bits_unsigned(4);
+    uint8_t qlp_bit_precision = m_reader.read_bits(4);
     if (qlp_bit_precision == 0b1111)
     {
-        throw std::runtime_error("Invalid QLP precission");
+        return fail("Invalid QLP precission");
     }
     qlp_bit_precision++;
 
     int8_t qlp_shift = m_reader.read_bits_signed(5);
-
-    int16_t predictor_coefficients[32]{};
-    for (uint8_t i = 0; i < predictor_order; i++)
+    if (qlp_shift < 0)
     {
-        predictor_coefficients[i] = m_reader.read_bits_signed(qlp_bit_precision);
+        return fail("Negative QLP shift");
     }
 
-    decode_residuals(predictor_order);
+    int32_t predictor_coefficients[32]{};
+    m_reader.read_signed_block(predictor_coefficients, predictor_order, 1, qlp_bit_precision);
 
-    linear_prediction(predictor_order, predictor_coefficients, qlp_shift);
-}
+    if (!decode_residuals(samples, predictor_order))
+    {
+        return false;
+    }
 
-void mc::Flac::linear_prediction(uint8_t predictor_order, const int16_t *predictor_coefficients, int8_t qlp_shift)
-{
-    for (uint16_t i = m_stream_info.channels * predictor_order; i < m_audio_buffer.size(); i += m_stream_info.channels)
+    Stage_timer timer(m_stage_timings.prediction_ns);
+    if constexpr (std::is_same_v<Sample, int32_t>)
     {
-        int64_t prediction{};
-        for (uint16_t j = 0; j < m_stream_info.channels * predictor_order; j += m_stream_info.channels)
-        {
-            prediction += m_audio_buffer[i - m_stream_info.channels - j + m_channel_index] * predictor_coefficients[j / m_stream_info.channels];
-        }
-        m_audio_buffer[i + m_channel_index] += (prediction >> qlp_shift);
+        restore_lpc(samples, m_frame_info.block_size, predictor_coefficients, predictor_order, qlp_shift, bits_per_sample);
+    }
+    else
+    {
+        restore_lpc(samples, m_frame_info.block_size, predictor_coefficients, predictor_order, qlp_shift);
     }
+    return true;
 }
 
-void mc::Flac::decode_residuals(uint8_t predictor_order)
+template <typename Sample>
+bool mc::Flac::decode_residuals(Sample *samples, uint8_t predictor_order)
 {
-    uint8_t residual_coding_method = m_reader.read_bits_unsigned(2);
+    Stage_timer timer(m_stage_timings.residual_ns);
+    uint64_t residual_start = m_reader.bit_position();
+    uint8_t residual_coding_method = m_reader.read_bits(2);
     if (residual_coding_method == 0b10 || residual_coding_method == 0b11)
     {
-        throw std::runtime_error("residual coding method has reserved value");
+        return fail("residual coding method has reserved value");
     }
     uint8_t parameter_bit_size = residual_coding_method == 0b00 ? 4 : 5;
-    uint8_t rice_partition_order = m_reader.read_bits_unsigned(4);
+    uint8_t rice_partition_order = m_reader.read_bits(4);
     uint16_t rice_partition_count = 1 << rice_partition_order;
     uint16_t rice_partition_size = (m_frame_info.block_size) / rice_partition_count;
 
@@ -340,26 +1088,36 @@ void mc::Flac::decode_residuals(uint8_t predictor_order)
 
     for (uint16_t i = 0; i < rice_partition_count; i++)
     {
-        uint8_t rice_parameter = m_reader.read_bits_unsigned(parameter_bit_size);
+        uint8_t rice_parameter = m_reader.read_bits(parameter_bit_size);
         uint16_t start = (i * rice_partition_size + ((i == 0) ? predictor_order : 0));
         uint16_t end = ((i + 1) * rice_partition_size);
 
+        if (end < start || end > m_frame_info.block_size)
+        {
+            return fail("Rice partition exceeds block size");
+        }
+
         if (rice_parameter != escape_code)
         {
-            for (size_t j = m_stream_info.channels * start; j < m_stream_info.channels * end; j += m_stream_info.channels)
-            {
-                m_audio_buffer[j + m_channel_index] = decode_and_unfold_rice(rice_parameter, m_reader);
-            }
+            m_reader.read_rice_block(samples + start, end - start, 1, rice_parameter);
         }
         else
         {
-            uint8_t bit_count = m_reader.read_bits_unsigned(5);
-            for (size_t j = m_stream_info.channels * start; j < m_stream_info.channels * end; j += m_stream_info.channels)
+            uint8_t bit_count = m_reader.read_bits(5);
+            m_reader.read_signed_block(samples + start, end - start, 1, bit_count);
+            if (m_stats != nullptr)
             {
-                m_audio_buffer[j + m_channel_index] = m_reader.read_bits_signed(bit_count);
+                m_stats->escaped_partitions.add(1);
             }
         }
     }
+
+    if (m_stats != nullptr)
+    {
+        m_stats->partition_orders[rice_partition_order].add(1);
+        m_residual_bits += m_reader.bit_position() - residual_start;
+    }
+    return true;
 }
 
 uint16_t mc::Flac::decode_block_size(uint8_t block_size_code)
@@ -367,13 +1125,10 @@ uint16_t mc::Flac::decode_block_size(uint8_t block_size_code)
     switch (block_size_code)
     {
     case 0b0110:
-        return m_reader.read_bits_unsigned(8) + 1;
+        return m_reader.read_bits(8) + 1;
 
     case 0b0111:
-        return m_reader.read_bits_unsigned(16) + 1;
-
-    case 0b0000:
-        throw std::runtime_error("block size code has reserved value (0000)");
+        return m_reader.read_bits(16) + 1;
 
     default:
         break;
@@ -390,16 +1145,13 @@ uint32_t mc::Flac::decode_sample_rate(uint8_t sample_rate_code)
         return m_stream_info.sample_rate;
 
     case 0b1100:
-        return m_reader.read_bits_unsigned(8) * 1000;
+        return m_reader.read_bits(8) * 1000;
 
     case 0b1101:
-        return m_reader.read_bits_unsigned(16);
+        return m_reader.read_bits(16);
 
     case 0b1110:
-        return m_reader.read_bits_unsigned(16) * 10;
-
-    case 0b1111:
-        throw std::runtime_error("Invalid sample rate code");
+        return m_reader.read_bits(16) * 10;
 
     default:
         break;
@@ -415,9 +1167,6 @@ uint8_t mc::Flac::decode_sample_size(uint8_t sample_size_code)
     case 0b000:
         return m_stream_info.bits_per_sample;
 
-    case 0b011:
-        throw std::runtime_error("Sample size code has reserved value");
-
     default:
         break;
     }
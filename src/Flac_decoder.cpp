@@ -0,0 +1,126 @@
+#include "Flac_decoder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void mc::Flac_decoder::open(const std::string &path, Pcm_format format, Crc_policy crc_policy)
+{
+    close();
+    m_file = std::make_unique<Mapped_file>(path);
+    open_flac(m_file->bytes(), format, crc_policy);
+}
+
+void mc::Flac_decoder::open(std::span<const uint8_t> data, Pcm_format format, Crc_policy crc_policy)
+{
+    close();
+    open_flac(data, format, crc_policy);
+}
+
+void mc::Flac_decoder::open_flac(std::span<const uint8_t> data, Pcm_format format, Crc_policy crc_policy)
+{
+    // a decoder left from an earlier stream keeps its buffers
+    if (m_flac != nullptr)
+    {
+        m_flac->reset(data);
+    }
+    else
+    {
+        m_flac = std::make_unique<Flac>(data);
+    }
+    m_flac->set_crc_policy(crc_policy);
+    m_flac->initialize();
+
+    m_open = true;
+    m_data = data;
+    m_format = format;
+    m_frame_position = 0;
+    m_frame_samples = 0;
+    m_position = 0;
+}
+
+void mc::Flac_decoder::close()
+{
+    m_open = false;
+    m_data = {};
+    m_file.reset();
+}
+
+size_t mc::Flac_decoder::read_pcm(std::span<std::byte> destination, size_t frames)
+{
+    if (!m_open)
+    {
+        throw std::invalid_argument("No FLAC stream is open");
+    }
+    size_t bytes_per_frame = frame_bytes();
+    if (destination.size() < frames * bytes_per_frame)
+    {
+        throw std::invalid_argument("PCM buffer is too small for the requested samples");
+    }
+
+    size_t written = 0;
+    while (written < frames)
+    {
+        if (m_frame_position == m_frame_samples)
+        {
+            if (m_flac->eos())
+            {
+                break;
+            }
+            m_flac->decode_frame();
+            m_frame_samples = m_flac->get_frame_info().block_size;
+            m_frame_position = 0;
+            continue;
+        }
+
+        uint16_t count = static_cast<uint16_t>(std::min<size_t>(m_frame_samples - m_frame_position, frames - written));
+        m_flac->write_pcm(destination.subspan(written * bytes_per_frame), m_format, m_frame_position, count);
+        m_frame_position += count;
+        written += count;
+    }
+
+    m_position += written;
+    return written;
+}
+
+void mc::Flac_decoder::seek(uint64_t sample)
+{
+    if (!m_open)
+    {
+        throw std::invalid_argument("No FLAC stream is open");
+    }
+
+    m_frame_position = m_flac->seek_to_sample(sample);
+    m_frame_samples = m_flac->get_frame_info().block_size;
+    // a target in a frame dropped under Crc_policy::SKIP resumes at the next frame
+    m_position = m_flac->get_frame_first_sample() + m_frame_position - m_flac->get_range_start();
+}
+
+void mc::Flac_decoder::select_track(uint8_t track_number)
+{
+    get_flac().select_track(track_number);
+    m_frame_position = 0;
+    m_frame_samples = 0;
+    m_position = 0;
+}
+
+mc::Flac &mc::Flac_decoder::get_flac()
+{
+    if (!m_open)
+    {
+        throw std::invalid_argument("No FLAC stream is open");
+    }
+    return *m_flac;
+}
+
+std::span<const uint8_t> mc::Flac_decoder::get_picture_data(const Picture &picture) const
+{
+    if (!m_open)
+    {
+        throw std::invalid_argument("No FLAC stream is open");
+    }
+    if (picture.data_offset > m_data.size() || picture.data_length > m_data.size() - picture.data_offset)
+    {
+        throw std::out_of_range("Picture data lies outside the stream");
+    }
+    return m_data.subspan(picture.data_offset, picture.data_length);
+}
@@ -0,0 +1,76 @@
+#include "Mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    std::runtime_error file_error(const std::string &what, const std::string &path)
+    {
+        return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+    }
+} // namespace
+
+mc::Mapped_file::Mapped_file(const std::string &path, Access access)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw file_error("Cannot open", path);
+    }
+
+    struct stat status{};
+    if (::fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0)
+    {
+        void *mapping = ::mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            if (access == Access::SEQUENTIAL)
+            {
+                ::madvise(mapping, status.st_size, MADV_SEQUENTIAL);
+                ::madvise(mapping, status.st_size, MADV_WILLNEED);
+            }
+            else
+            {
+                ::madvise(mapping, status.st_size, MADV_RANDOM);
+            }
+
+            m_mapping = static_cast<const uint8_t *>(mapping);
+            m_size = status.st_size;
+            ::close(fd);
+            return;
+        }
+    }
+
+    // not mappable: read the whole file instead
+    uint8_t buffer[1 << 16];
+    ssize_t bytes_read;
+    while ((bytes_read = ::read(fd, buffer, sizeof(buffer))) != 0)
+    {
+        if (bytes_read < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::runtime_error error = file_error("Cannot read", path);
+            ::close(fd);
+            throw error;
+        }
+        m_fallback.insert(m_fallback.end(), buffer, buffer + bytes_read);
+    }
+    ::close(fd);
+}
+
+mc::Mapped_file::~Mapped_file()
+{
+    if (m_mapping != nullptr)
+    {
+        ::munmap(const_cast<uint8_t *>(m_mapping), m_size);
+    }
+}
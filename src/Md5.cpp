@@ -0,0 +1,165 @@
+#include "Md5.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace
+{
+    uint32_t load_little_endian_32(const uint8_t *data)
+    {
+        uint32_t word;
+        std::memcpy(&word, data, sizeof(word));
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            word = __builtin_bswap32(word);
+        }
+        return word;
+    }
+
+    template <uint32_t (*Function)(uint32_t, uint32_t, uint32_t), int Shift>
+    inline void step(uint32_t &a, uint32_t b, uint32_t c, uint32_t d, uint32_t word, uint32_t constant)
+    {
+        a = b + std::rotl(a + Function(b, c, d) + word + constant, Shift);
+    }
+
+    inline uint32_t f(uint32_t x, uint32_t y, uint32_t z) { return z ^ (x & (y ^ z)); }
+    inline uint32_t g(uint32_t x, uint32_t y, uint32_t z) { return (x & z) + (y & ~z); }
+    inline uint32_t h(uint32_t x, uint32_t y, uint32_t z) { return x ^ y ^ z; }
+    inline uint32_t i(uint32_t x, uint32_t y, uint32_t z) { return y ^ (x | ~z); }
+} // namespace
+
+void mc::Md5::process_blocks(const uint8_t *data, size_t blocks)
+{
+    uint32_t a = m_state[0];
+    uint32_t b = m_state[1];
+    uint32_t c = m_state[2];
+    uint32_t d = m_state[3];
+
+    for (; blocks > 0; blocks--, data += 64)
+    {
+        uint32_t x[16];
+        for (int word = 0; word < 16; word++)
+        {
+            x[word] = load_little_endian_32(data + 4 * word);
+        }
+
+        uint32_t aa = a, bb = b, cc = c, dd = d;
+
+        step<f, 7>(a, b, c, d, x[0], 0xd76aa478);
+        step<f, 12>(d, a, b, c, x[1], 0xe8c7b756);
+        step<f, 17>(c, d, a, b, x[2], 0x242070db);
+        step<f, 22>(b, c, d, a, x[3], 0xc1bdceee);
+        step<f, 7>(a, b, c, d, x[4], 0xf57c0faf);
+        step<f, 12>(d, a, b, c, x[5], 0x4787c62a);
+        step<f, 17>(c, d, a, b, x[6], 0xa8304613);
+        step<f, 22>(b, c, d, a, x[7], 0xfd469501);
+        step<f, 7>(a, b, c, d, x[8], 0x698098d8);
+        step<f, 12>(d, a, b, c, x[9], 0x8b44f7af);
+        step<f, 17>(c, d, a, b, x[10], 0xffff5bb1);
+        step<f, 22>(b, c, d, a, x[11], 0x895cd7be);
+        step<f, 7>(a, b, c, d, x[12], 0x6b901122);
+        step<f, 12>(d, a, b, c, x[13], 0xfd987193);
+        step<f, 17>(c, d, a, b, x[14], 0xa679438e);
+        step<f, 22>(b, c, d, a, x[15], 0x49b40821);
+
+        step<g, 5>(a, b, c, d, x[1], 0xf61e2562);
+        step<g, 9>(d, a, b, c, x[6], 0xc040b340);
+        step<g, 14>(c, d, a, b, x[11], 0x265e5a51);
+        step<g, 20>(b, c, d, a, x[0], 0xe9b6c7aa);
+        step<g, 5>(a, b, c, d, x[5], 0xd62f105d);
+        step<g, 9>(d, a, b, c, x[10], 0x02441453);
+        step<g, 14>(c, d, a, b, x[15], 0xd8a1e681);
+        step<g, 20>(b, c, d, a, x[4], 0xe7d3fbc8);
+        step<g, 5>(a, b, c, d, x[9], 0x21e1cde6);
+        step<g, 9>(d, a, b, c, x[14], 0xc33707d6);
+        step<g, 14>(c, d, a, b, x[3], 0xf4d50d87);
+        step<g, 20>(b, c, d, a, x[8], 0x455a14ed);
+        step<g, 5>(a, b, c, d, x[13], 0xa9e3e905);
+        step<g, 9>(d, a, b, c, x[2], 0xfcefa3f8);
+        step<g, 14>(c, d, a, b, x[7], 0x676f02d9);
+        step<g, 20>(b, c, d, a, x[12], 0x8d2a4c8a);
+
+        step<h, 4>(a, b, c, d, x[5], 0xfffa3942);
+        step<h, 11>(d, a, b, c, x[8], 0x8771f681);
+        step<h, 16>(c, d, a, b, x[11], 0x6d9d6122);
+        step<h, 23>(b, c, d, a, x[14], 0xfde5380c);
+        step<h, 4>(a, b, c, d, x[1], 0xa4beea44);
+        step<h, 11>(d, a, b, c, x[4], 0x4bdecfa9);
+        step<h, 16>(c, d, a, b, x[7], 0xf6bb4b60);
+        step<h, 23>(b, c, d, a, x[10], 0xbebfbc70);
+        step<h, 4>(a, b, c, d, x[13], 0x289b7ec6);
+        step<h, 11>(d, a, b, c, x[0], 0xeaa127fa);
+        step<h, 16>(c, d, a, b, x[3], 0xd4ef3085);
+        step<h, 23>(b, c, d, a, x[6], 0x04881d05);
+        step<h, 4>(a, b, c, d, x[9], 0xd9d4d039);
+        step<h, 11>(d, a, b, c, x[12], 0xe6db99e5);
+        step<h, 16>(c, d, a, b, x[15], 0x1fa27cf8);
+        step<h, 23>(b, c, d, a, x[2], 0xc4ac5665);
+
+        step<i, 6>(a, b, c, d, x[0], 0xf4292244);
+        step<i, 10>(d, a, b, c, x[7], 0x432aff97);
+        step<i, 15>(c, d, a, b, x[14], 0xab9423a7);
+        step<i, 21>(b, c, d, a, x[5], 0xfc93a039);
+        step<i, 6>(a, b, c, d, x[12], 0x655b59c3);
+        step<i, 10>(d, a, b, c, x[3], 0x8f0ccc92);
+        step<i, 15>(c, d, a, b, x[10], 0xffeff47d);
+        step<i, 21>(b, c, d, a, x[1], 0x85845dd1);
+        step<i, 6>(a, b, c, d, x[8], 0x6fa87e4f);
+        step<i, 10>(d, a, b, c, x[15], 0xfe2ce6e0);
+        step<i, 15>(c, d, a, b, x[6], 0xa3014314);
+        step<i, 21>(b, c, d, a, x[13], 0x4e0811a1);
+        step<i, 6>(a, b, c, d, x[4], 0xf7537e82);
+        step<i, 10>(d, a, b, c, x[11], 0xbd3af235);
+        step<i, 15>(c, d, a, b, x[2], 0x2ad7d2bb);
+        step<i, 21>(b, c, d, a, x[9], 0xeb86d391);
+
+        a += aa;
+        b += bb;
+        c += cc;
+        d += dd;
+    }
+
+    m_state = {a, b, c, d};
+}
+
+void mc::Md5::update(const uint8_t *data, size_t size)
+{
+    size_t buffered = m_length % 64;
+    m_length += size;
+
+    if (buffered > 0)
+    {
+        size_t count = std::min(size, 64 - buffered);
+        std::memcpy(m_block.data() + buffered, data, count);
+        data += count;
+        size -= count;
+        if (buffered + count < 64)
+        {
+            return;
+        }
+        process_blocks(m_block.data(), 1);
+    }
+
+    process_blocks(data, size / 64);
+    std::memcpy(m_block.data(), data + size / 64 * 64, size % 64);
+}
+
+std::array<uint8_t, 16> mc::Md5::finish()
+{
+    uint64_t bit_length = m_length * 8;
+    uint8_t padding[72] = {0x80};
+    size_t padding_size = (m_length % 64 < 56 ? 56 : 120) - m_length % 64;
+    for (int byte = 0; byte < 8; byte++)
+    {
+        padding[padding_size + byte] = static_cast<uint8_t>(bit_length >> (8 * byte));
+    }
+    update(padding, padding_size + 8);
+
+    std::array<uint8_t, 16> digest;
+    for (int byte = 0; byte < 16; byte++)
+    {
+        digest[byte] = static_cast<uint8_t>(m_state[byte / 4] >> (8 * (byte % 4)));
+    }
+    return digest;
+}
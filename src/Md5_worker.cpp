@@ -0,0 +1,80 @@
+#include "Md5_worker.hpp"
+
+#include <algorithm>
+
+mc::Md5_worker::Md5_worker(size_t queued_pieces)
+    : m_ring(std::max<size_t>(queued_pieces, 2))
+{
+    m_thread = std::jthread([this]
+                            { run(); });
+}
+
+mc::Md5_worker::~Md5_worker()
+{
+    acquire_slot().command = Command::STOP;
+    m_ring.commit_write();
+}
+
+mc::Md5_worker::Slot &mc::Md5_worker::acquire_slot()
+{
+    Slot *slot;
+    while ((slot = m_ring.try_acquire_write()) == nullptr)
+    {
+        m_ring.wait_until_size_at_most(m_ring.capacity() - 1, []
+                                       { return false; });
+    }
+    return *slot;
+}
+
+std::span<uint8_t> mc::Md5_worker::begin_piece(size_t size)
+{
+    Slot &slot = acquire_slot();
+    slot.command = Command::UPDATE;
+    slot.data.resize(size);
+    return slot.data;
+}
+
+std::array<uint8_t, 16> mc::Md5_worker::finish()
+{
+    acquire_slot().command = Command::FINISH;
+    m_ring.commit_write();
+
+    // releasing the FINISH slot publishes the digest
+    m_ring.wait_until_size_at_most(0, []
+                                   { return false; });
+    return m_digest;
+}
+
+void mc::Md5_worker::reset()
+{
+    acquire_slot().command = Command::RESET;
+    m_ring.commit_write();
+}
+
+void mc::Md5_worker::run()
+{
+    while (true)
+    {
+        m_ring.wait_until_size_at_least(1, []
+                                        { return false; });
+        const Slot *slot = m_ring.try_acquire_read();
+
+        switch (slot->command)
+        {
+        case Command::UPDATE:
+            m_md5.update(slot->data.data(), slot->data.size());
+            break;
+        case Command::FINISH:
+            m_digest = m_md5.finish();
+            m_md5.reset();
+            break;
+        case Command::RESET:
+            m_md5.reset();
+            break;
+        case Command::STOP:
+            m_ring.release_read();
+            return;
+        }
+        m_ring.release_read();
+    }
+}
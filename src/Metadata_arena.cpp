@@ -0,0 +1,43 @@
+#include "Metadata_arena.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+char *mc::Metadata_arena::allocate(size_t size)
+{
+    while (m_block < m_blocks.size())
+    {
+        Block &block = m_blocks[m_block];
+        if (block.size - m_used >= size)
+        {
+            char *data = block.data.get() + m_used;
+            m_used += size;
+            return data;
+        }
+        m_block++;
+        m_used = 0;
+    }
+
+    size_t block_size = std::max(size, default_block_size);
+    m_blocks.push_back({std::make_unique_for_overwrite<char[]>(block_size), block_size});
+    m_block = m_blocks.size() - 1;
+    m_used = size;
+    return m_blocks.back().data.get();
+}
+
+std::string_view mc::Metadata_arena::store(std::string_view text)
+{
+    char *data = allocate(text.size());
+    std::memcpy(data, text.data(), text.size());
+    return {data, text.size()};
+}
+
+size_t mc::Metadata_arena::capacity() const
+{
+    size_t total = 0;
+    for (const auto &block : m_blocks)
+    {
+        total += block.size;
+    }
+    return total;
+}
@@ -0,0 +1,213 @@
+#include "Metadata_scanner.hpp"
+
+#include "Buffered_bit_reader.hpp"
+#include "Flac_constants.hpp"
+#include "metadata.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    std::runtime_error file_error(const std::string &what, const std::string &path)
+    {
+        return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+    }
+
+    uint32_t load_big_endian_32(const uint8_t *bytes)
+    {
+        return static_cast<uint32_t>(bytes[0]) << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+    }
+} // namespace
+
+const mc::Flac_metadata &mc::Metadata_scanner::scan(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw file_error("Cannot open", path);
+    }
+
+    try
+    {
+        struct stat status{};
+        if (::fstat(fd, &status) != 0)
+        {
+            throw file_error("Cannot stat", path);
+        }
+        m_metadata.file_size = status.st_size;
+        m_metadata.modified_time = status.st_mtime;
+
+        scan_metadata(fd);
+    }
+    catch (...)
+    {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    return m_metadata;
+}
+
+std::span<const uint8_t> mc::Metadata_scanner::read_range(int fd, uint64_t offset, size_t size)
+{
+    if (offset >= m_window_offset && offset + size <= m_window_offset + m_window_size)
+    {
+        return {m_buffer.data() + (offset - m_window_offset), size};
+    }
+
+    size_t wanted = std::max(size, read_size);
+    if (m_buffer.size() < wanted)
+    {
+        m_buffer.resize(wanted);
+    }
+
+    size_t filled = 0;
+    while (filled < wanted)
+    {
+        ssize_t bytes_read = ::pread(fd, m_buffer.data() + filled, wanted - filled, static_cast<off_t>(offset + filled));
+        if (bytes_read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytes_read < 0)
+        {
+            throw std::runtime_error(std::string("Cannot read metadata: ") + std::strerror(errno));
+        }
+        m_reads++;
+        m_bytes_read += bytes_read;
+        if (bytes_read == 0)
+        {
+            break;
+        }
+        filled += bytes_read;
+    }
+
+    m_window_offset = offset;
+    m_window_size = filled;
+    if (filled < size)
+    {
+        throw std::runtime_error("Metadata is truncated");
+    }
+    return {m_buffer.data(), size};
+}
+
+void mc::Metadata_scanner::scan_metadata(int fd)
+{
+    m_window_offset = 0;
+    m_window_size = 0;
+    m_arena.reset();
+    m_metadata.stream_info = {};
+    m_metadata.vorbis_comment.vendor_string = {};
+    m_metadata.vorbis_comment.user_comments.clear();
+    m_metadata.pictures.clear();
+    m_metadata.cue_sheet.media_catalog_number = {};
+    m_metadata.cue_sheet.tracks.clear();
+
+    std::span<const uint8_t> marker = read_range(fd, 0, 4);
+    if (load_big_endian_32(marker.data()) != Flac_constants::flac_marker)
+    {
+        throw std::runtime_error("File is not a valid FLAC file");
+    }
+
+    uint64_t offset = 4;
+    bool is_last_block = false;
+    bool has_stream_info = false;
+    while (!is_last_block)
+    {
+        std::span<const uint8_t> header = read_range(fd, offset, 4);
+        is_last_block = header[0] & 0x80;
+        block_type current_block_type = static_cast<block_type>(header[0] & 0x7F);
+        uint32_t block_length = load_big_endian_32(header.data()) & 0xFFFFFF;
+        offset += 4;
+
+        switch (current_block_type)
+        {
+        case block_type::STREAMINFO:
+        {
+            if (block_length != 34)
+            {
+                throw std::runtime_error("STREAMINFO block has unexpected length");
+            }
+            Buffered_bit_reader reader(read_range(fd, offset, block_length));
+            read_stream_info(reader, m_metadata.stream_info);
+            has_stream_info = true;
+            break;
+        }
+        case block_type::VORBIS_COMMENT:
+        {
+            Buffered_bit_reader reader(read_range(fd, offset, block_length));
+            read_vorbis_comment(reader, m_arena, m_metadata.vorbis_comment);
+            break;
+        }
+        case block_type::PICTURE:
+        {
+            // the descriptor ends after two variable-length strings; the image data is not read
+            uint32_t mime_length = load_big_endian_32(read_range(fd, offset + 4, 4).data());
+            if (32 + static_cast<uint64_t>(mime_length) > block_length)
+            {
+                throw std::runtime_error("PICTURE block has inconsistent lengths");
+            }
+            uint32_t description_length = load_big_endian_32(read_range(fd, offset + 8 + mime_length, 4).data());
+            if (32 + static_cast<uint64_t>(mime_length) + description_length > block_length)
+            {
+                throw std::runtime_error("PICTURE block has inconsistent lengths");
+            }
+            Buffered_bit_reader reader(read_range(fd, offset, 32 + mime_length + description_length));
+            read_picture(reader, m_arena, offset, block_length, m_metadata.pictures.emplace_back());
+            break;
+        }
+        case block_type::CUESHEET:
+        {
+            Buffered_bit_reader reader(read_range(fd, offset, block_length));
+            read_cue_sheet(reader, m_arena, block_length, m_metadata.cue_sheet);
+            break;
+        }
+        case block_type::PADDING:
+        case block_type::APPLICATION:
+        case block_type::SEEKTABLE:
+            break;
+        default:
+            throw std::runtime_error("Unknown block type");
+        }
+        offset += block_length;
+    }
+
+    if (!has_stream_info)
+    {
+        throw std::runtime_error("STREAMINFO block is missing");
+    }
+    m_metadata.first_frame_offset = offset;
+}
+
+void mc::read_picture_data(const std::string &path, const Picture &picture, std::vector<uint8_t> &data)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw file_error("Cannot open", path);
+    }
+
+    data.resize(picture.data_length);
+    size_t filled = 0;
+    while (filled < data.size())
+    {
+        ssize_t bytes_read = ::pread(fd, data.data() + filled, data.size() - filled, static_cast<off_t>(picture.data_offset + filled));
+        if (bytes_read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytes_read <= 0)
+        {
+            std::runtime_error error = bytes_read < 0 ? file_error("Cannot read", path) : std::runtime_error("Picture data is truncated in " + path);
+            ::close(fd);
+            throw error;
+        }
+        filled += bytes_read;
+    }
+    ::close(fd);
+}
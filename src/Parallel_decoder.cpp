@@ -0,0 +1,92 @@
+#include "Parallel_decoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "Flac.hpp"
+
+void mc::Parallel_decoder::initialize()
+{
+    Flac metadata_reader(m_data);
+    metadata_reader.initialize();
+    m_stream_info = metadata_reader.get_stream_info();
+
+    size_t frames_offset = metadata_reader.get_reader().byte_position();
+    m_gaps.clear();
+    m_frames = scan_frames(m_data.subspan(frames_offset), m_stream_info, &m_gaps);
+
+    for (auto &frame : m_frames)
+    {
+        frame.offset += frames_offset;
+    }
+    m_total_samples = m_frames.empty() ? 0 : m_frames.back().first_sample + m_frames.back().block_size;
+
+    // a damaged header at the end leaves nothing to resume at, so only the total shows it
+    if (m_stream_info.total_samples != 0 && m_total_samples != m_stream_info.total_samples)
+    {
+        throw std::runtime_error("Frames hold " + std::to_string(m_total_samples) + " samples, STREAMINFO promises " +
+                                 std::to_string(m_stream_info.total_samples));
+    }
+}
+
+void mc::Parallel_decoder::decode(std::span<std::byte> destination, Pcm_format format)
+{
+    if (destination.size() < pcm_bytes(format))
+    {
+        throw std::invalid_argument("PCM buffer is too small for the stream");
+    }
+
+    // several batches per worker, so stealing can even out frames of different cost
+    size_t batch_frames = std::clamp<size_t>(m_frames.size() / (m_pool.get_thread_count() * 8), 1, 64);
+
+    for (size_t first = 0; first < m_frames.size(); first += batch_frames)
+    {
+        size_t last = std::min(first + batch_frames, m_frames.size()) - 1;
+
+        m_pool.submit([this, destination, format, first, last]
+                      { decode_batch(destination, format, first, last); });
+    }
+
+    m_pool.wait();
+
+    if (!m_gaps.empty())
+    {
+        size_t frame_bytes = m_stream_info.channels * pcm_format_bytes(format);
+        uint64_t lost_samples = 0;
+        for (const auto &gap : m_gaps)
+        {
+            std::memset(destination.data() + gap.first_sample * frame_bytes, 0, gap.samples * frame_bytes);
+            lost_samples += gap.samples;
+        }
+        throw std::runtime_error(std::to_string(lost_samples) + " samples were lost to damaged frame headers");
+    }
+}
+
+void mc::Parallel_decoder::decode_batch(std::span<std::byte> destination, Pcm_format format, size_t first, size_t last) const
+{
+    const Frame_location &first_frame = m_frames[first];
+    const Frame_location &last_frame = m_frames[last];
+    size_t frame_bytes = m_stream_info.channels * pcm_format_bytes(format);
+
+    Flac decoder(m_data.subspan(first_frame.offset, last_frame.offset + last_frame.size - first_frame.offset));
+    decoder.initialize(m_stream_info);
+
+    for (size_t i = first; i <= last; i++)
+    {
+        const Frame_location &frame = m_frames[i];
+        if (i != first && frame.first_sample != m_frames[i - 1].first_sample + m_frames[i - 1].block_size)
+        {
+            // resume after the damaged bytes of a gap
+            decoder.reset(m_data.subspan(frame.offset, last_frame.offset + last_frame.size - frame.offset));
+            decoder.initialize(m_stream_info);
+        }
+        decoder.decode_frame();
+        if (decoder.get_frame_info().block_size != frame.block_size)
+        {
+            throw std::runtime_error("Frame block size differs from its scanned header");
+        }
+        decoder.write_pcm(destination.subspan(frame.first_sample * frame_bytes), format, 0, frame.block_size);
+    }
+}
@@ -0,0 +1,287 @@
+#include "Pcm_file_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace
+{
+    // speaker layouts of the FLAC channel assignments, as WAVE_FORMAT_EXTENSIBLE masks
+    constexpr uint32_t channel_masks[8] = {0x4, 0x3, 0x7, 0x33, 0x37, 0x3F, 0x70F, 0x63F};
+
+    constexpr uint8_t pcm_subformat[16] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+                                           0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+    std::byte *put_bytes(std::byte *destination, const void *bytes, size_t count)
+    {
+        std::memcpy(destination, bytes, count);
+        return destination + count;
+    }
+
+    std::byte *put_le(std::byte *destination, uint32_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i++)
+        {
+            destination[i] = static_cast<std::byte>(value >> (8 * i));
+        }
+        return destination + bytes;
+    }
+
+    size_t round_up(size_t size, size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    std::runtime_error write_error(int error)
+    {
+        return std::runtime_error(std::string("Cannot write PCM file: ") + std::strerror(error));
+    }
+} // namespace
+
+mc::Pcm_file_writer::Pcm_file_writer(const std::string &path, Pcm_file_type type, uint8_t channels, uint32_t sample_rate,
+                                     uint8_t bits_per_sample, Pcm_format format, bool direct, size_t block_size, size_t block_count)
+    : m_type(type), m_channels(channels), m_sample_rate(sample_rate), m_bits_per_sample(bits_per_sample), m_format(format),
+      m_ring(std::max<size_t>(block_count, 2))
+{
+    if (channels == 0 || channels > 8 || bits_per_sample == 0 || bits_per_sample > pcm_format_bytes(format) * 8)
+    {
+        throw std::invalid_argument("Unsupported PCM layout");
+    }
+
+    block_size = std::max(round_up(block_size, alignment), 2 * alignment);
+    for (size_t i = 0; i < m_ring.capacity(); i++)
+    {
+        m_ring.slot(i).data.resize(block_size);
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    if (direct)
+    {
+        // file systems without O_DIRECT (tmpfs, some network mounts) reject it with EINVAL
+        m_fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        m_direct = m_fd >= 0;
+    }
+    if (m_fd < 0)
+    {
+        m_fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (m_fd < 0)
+    {
+        throw std::runtime_error("Cannot create " + path + ": " + std::strerror(errno));
+    }
+
+    // the header is completed by finish(), once the length is known
+    m_block = m_ring.try_acquire_write();
+    m_block->size = header_size();
+    m_block->last = false;
+    write_header(m_block->data.data(), 0);
+    m_bytes = m_block->size;
+
+    m_thread = std::thread(&Pcm_file_writer::write_loop, this);
+}
+
+mc::Pcm_file_writer::~Pcm_file_writer()
+{
+    if (m_thread.joinable())
+    {
+        m_block->size = 0;
+        m_block->last = true;
+        m_ring.commit_write();
+        m_thread.join();
+    }
+    close_file();
+}
+
+size_t mc::Pcm_file_writer::header_size() const
+{
+    if (m_type == Pcm_file_type::RAW)
+    {
+        return 0;
+    }
+    bool extensible = m_bits_per_sample != pcm_format_bytes(m_format) * 8 || m_channels > 2;
+    return extensible ? 68 : 44;
+}
+
+void mc::Pcm_file_writer::write_header(std::byte *destination, uint64_t data_bytes) const
+{
+    size_t size = header_size();
+    if (size == 0)
+    {
+        return;
+    }
+    bool extensible = size == 68;
+    uint32_t container_bytes = pcm_format_bytes(m_format);
+    uint32_t block_align = container_bytes * m_channels;
+
+    // sizes that do not fit 32 bits are saturated, which readers take as "up to the end of the file"
+    constexpr uint64_t max_size = std::numeric_limits<uint32_t>::max();
+    // a chunk of odd size is followed by a pad byte, which counts towards RIFF but not data
+    uint64_t pad = data_bytes & 1;
+    uint32_t riff_size = static_cast<uint32_t>(std::min(data_bytes + pad + size - 8, max_size));
+    uint32_t data_size = static_cast<uint32_t>(std::min(data_bytes, max_size));
+
+    std::byte *p = put_bytes(destination, "RIFF", 4);
+    p = put_le(p, riff_size, 4);
+    p = put_bytes(p, "WAVEfmt ", 8);
+    p = put_le(p, extensible ? 40 : 16, 4);
+    p = put_le(p, extensible ? 0xFFFE : 1, 2);
+    p = put_le(p, m_channels, 2);
+    p = put_le(p, m_sample_rate, 4);
+    p = put_le(p, m_sample_rate * block_align, 4);
+    p = put_le(p, block_align, 2);
+    p = put_le(p, container_bytes * 8, 2);
+    if (extensible)
+    {
+        p = put_le(p, 22, 2);
+        p = put_le(p, m_bits_per_sample, 2);
+        p = put_le(p, channel_masks[m_channels - 1], 4);
+        p = put_bytes(p, pcm_subformat, sizeof(pcm_subformat));
+    }
+    p = put_bytes(p, "data", 4);
+    put_le(p, data_size, 4);
+}
+
+std::span<std::byte> mc::Pcm_file_writer::get_buffer(size_t bytes)
+{
+    if (bytes > m_block->data.size() - alignment)
+    {
+        throw std::invalid_argument("PCM file write exceeds the block size");
+    }
+    if (m_block->size + bytes > m_block->data.size())
+    {
+        hand_off(false);
+    }
+    return std::span(m_block->data).subspan(m_block->size);
+}
+
+void mc::Pcm_file_writer::hand_off(bool last)
+{
+    if (int error = m_error.load(std::memory_order_relaxed))
+    {
+        throw write_error(error);
+    }
+
+    // only whole pages are written; the partial page at the end moves to the next block
+    size_t carry = last ? 0 : m_block->size % alignment;
+    m_block->size -= carry;
+    std::memcpy(m_carry.data(), m_block->data.data() + m_block->size, carry);
+    m_block->last = last;
+    m_ring.commit_write();
+    m_block = nullptr;
+    if (last)
+    {
+        return;
+    }
+
+    Block *next = m_ring.try_acquire_write();
+    if (next == nullptr)
+    {
+        m_stalls++;
+        m_ring.wait_until_size_at_most(m_ring.capacity() - 1, []
+                                       { return false; });
+        next = m_ring.try_acquire_write();
+    }
+    std::memcpy(next->data.data(), m_carry.data(), carry);
+    next->size = carry;
+    next->last = false;
+    m_block = next;
+}
+
+void mc::Pcm_file_writer::write_loop()
+{
+    uint64_t offset = 0;
+    bool last = false;
+    while (!last)
+    {
+        m_ring.wait_until_size_at_least(1, []
+                                        { return false; });
+        const Block *block = m_ring.try_acquire_read();
+        last = block->last;
+
+        // O_DIRECT needs whole pages even at the end; finish() truncates the padding
+        size_t size = m_direct ? round_up(block->size, alignment) : block->size;
+        size_t written = 0;
+        while (written < size && m_error.load(std::memory_order_relaxed) == 0)
+        {
+            ssize_t result = ::pwrite(m_fd, block->data.data() + written, size - written, static_cast<off_t>(offset + written));
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (result <= 0)
+            {
+                m_error.store(result < 0 ? errno : EIO, std::memory_order_relaxed);
+                break;
+            }
+            written += result;
+        }
+        offset += block->size;
+        m_ring.release_read();
+    }
+}
+
+void mc::Pcm_file_writer::close_file()
+{
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void mc::Pcm_file_writer::finish()
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    // a WAV data chunk of odd size is followed by a zero pad byte
+    uint64_t data_bytes = m_bytes - header_size();
+    if (header_size() > 0 && (data_bytes & 1) != 0)
+    {
+        get_buffer(1)[0] = std::byte{0};
+        commit(1);
+    }
+    hand_off(true);
+    m_thread.join();
+    m_finished = true;
+
+    int error = m_error.load(std::memory_order_relaxed);
+    if (error == 0 && m_direct)
+    {
+        // the header and the truncation are not page-aligned
+        int flags = ::fcntl(m_fd, F_GETFL);
+        if (flags < 0 || ::fcntl(m_fd, F_SETFL, flags & ~O_DIRECT) != 0)
+        {
+            error = errno;
+        }
+    }
+    if (error == 0 && ::ftruncate(m_fd, static_cast<off_t>(m_bytes)) != 0)
+    {
+        error = errno;
+    }
+    if (error == 0 && header_size() > 0)
+    {
+        std::array<std::byte, 68> header;
+        write_header(header.data(), data_bytes);
+        if (::pwrite(m_fd, header.data(), header_size(), 0) != static_cast<ssize_t>(header_size()))
+        {
+            error = errno != 0 ? errno : EIO;
+        }
+    }
+    if (::close(m_fd) != 0 && error == 0)
+    {
+        error = errno;
+    }
+    m_fd = -1;
+
+    if (error != 0)
+    {
+        throw write_error(error);
+    }
+}
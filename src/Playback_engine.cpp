@@ -0,0 +1,277 @@
+#include "Playback_engine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+mc::Playback_engine::Playback_engine(Flac &decoder, Alsa_output &output, const Playback_config &config, Playback_tracks tracks)
+    : m_decoder(&decoder), m_output(output), m_config(config), m_tracks(std::move(tracks)), m_ring(std::max<size_t>(config.ring_periods, 2))
+{
+    size_t capacity = m_ring.capacity();
+    m_config.period_frames = std::max<size_t>(m_config.period_frames, 1);
+    m_config.high_watermark = std::clamp<size_t>(m_config.high_watermark, 1, capacity);
+    m_config.low_watermark = std::min(m_config.low_watermark, m_config.high_watermark - 1);
+    m_config.prefill_periods = std::clamp<size_t>(m_config.prefill_periods, 1, m_config.high_watermark);
+    m_min_ring_occupancy = capacity;
+
+    const Stream_info &info = m_decoder->get_stream_info();
+    size_t period_bytes = m_config.period_frames * info.channels * pcm_format_bytes(m_output.get_format());
+    for (size_t i = 0; i < capacity; i++)
+    {
+        m_ring.slot(i).data.resize(period_bytes);
+    }
+
+    if (m_output.get_sample_rate() != info.sample_rate)
+    {
+        m_resampler = std::make_unique<Resampler>(info.sample_rate, m_output.get_sample_rate(), info.channels, info.max_block_size);
+    }
+}
+
+void mc::Playback_engine::push_frame(uint16_t offset)
+{
+    std::array<std::span<const int32_t>, 8> channels;
+    uint8_t channel_count = m_decoder->get_stream_info().channels;
+    for (uint8_t channel = 0; channel < channel_count; channel++)
+    {
+        channels[channel] = m_decoder->get_channel_samples(channel).subspan(offset);
+    }
+    m_resampler->push(std::span(channels.data(), channel_count), m_decoder->get_frame_info().bits_per_sample);
+}
+
+mc::Playback_engine::Period *mc::Playback_engine::acquire_period()
+{
+    if (m_ring.size() >= m_config.high_watermark)
+    {
+        m_ring.wait_until_size_at_most(m_config.low_watermark, [this]
+                                       { return m_stop.load(std::memory_order_relaxed); });
+    }
+    if (m_stop.load(std::memory_order_relaxed))
+    {
+        return nullptr;
+    }
+    return m_ring.try_acquire_write();
+}
+
+void mc::Playback_engine::finish_decoding()
+{
+    // the end marker wakes the output thread if it is waiting for prefill
+    m_decoder_done.store(true);
+
+    Period *period;
+    while ((period = m_ring.try_acquire_write()) == nullptr)
+    {
+        m_ring.wait_until_size_at_most(m_ring.capacity() - 1, []
+                                       { return false; });
+    }
+    period->frames = 0;
+    m_ring.commit_write();
+}
+
+void mc::Playback_engine::decode_loop()
+{
+    try
+    {
+        Pcm_format format = m_output.get_format();
+        uint8_t channels = m_decoder->get_stream_info().channels;
+        size_t frame_bytes = channels * pcm_format_bytes(format);
+        uint16_t frame_position = 0;
+        uint16_t frame_samples = 0;
+        bool end_of_stream = false;
+        bool resampler_finished = false;
+
+        if (m_config.start_sample > 0)
+        {
+            frame_position = m_decoder->seek_to_sample(m_config.start_sample);
+            frame_samples = m_decoder->get_frame_info().block_size;
+            if (m_resampler != nullptr)
+            {
+                push_frame(frame_position);
+                frame_position = frame_samples;
+            }
+        }
+
+        while (!end_of_stream)
+        {
+            Period *period = acquire_period();
+            if (period == nullptr)
+            {
+                break;
+            }
+
+            // decode straight into the ring slot, splitting frames across periods as needed
+            period->frames = 0;
+            period->tracks_started = 0;
+            while (period->frames < m_config.period_frames)
+            {
+                if (m_resampler != nullptr)
+                {
+                    // converted samples first; the next frame is decoded once the resampler runs dry
+                    period->frames += m_resampler->pull(std::span(period->data).subspan(period->frames * frame_bytes), format,
+                                                        m_config.period_frames - period->frames);
+                    if (period->frames == m_config.period_frames)
+                    {
+                        break;
+                    }
+                }
+
+                if (frame_position == frame_samples)
+                {
+                    if (m_decoder->eos())
+                    {
+                        // the next track continues in the same period, right after the last sample
+                        Flac *next = m_tracks.next && !resampler_finished ? m_tracks.next() : nullptr;
+                        if (next == nullptr && m_resampler != nullptr && !resampler_finished)
+                        {
+                            m_resampler->finish();
+                            resampler_finished = true;
+                            continue;
+                        }
+                        if (next == nullptr)
+                        {
+                            end_of_stream = true;
+                            break;
+                        }
+                        if (next->get_stream_info().channels != channels)
+                        {
+                            throw std::runtime_error("Next track has a different channel count");
+                        }
+                        m_decoder = next;
+                        frame_samples = 0;
+                        frame_position = 0;
+                        period->tracks_started++;
+                        continue;
+                    }
+                    m_decoder->decode_frame();
+                    frame_samples = m_decoder->get_frame_info().block_size;
+                    frame_position = 0;
+                    if (m_resampler != nullptr)
+                    {
+                        push_frame(0);
+                        frame_position = frame_samples;
+                        continue;
+                    }
+                }
+
+                uint16_t count = std::min<size_t>(frame_samples - frame_position, m_config.period_frames - period->frames);
+                m_decoder->write_pcm(std::span(period->data).subspan(period->frames * frame_bytes), format, frame_position, count);
+                frame_position += count;
+                period->frames += count;
+            }
+
+            if (period->frames > 0)
+            {
+                m_ring.commit_write();
+                m_periods_decoded.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    catch (...)
+    {
+        m_decoder_error = std::current_exception();
+    }
+
+    finish_decoding();
+}
+
+void mc::Playback_engine::run()
+{
+    std::thread decoder_thread(&Playback_engine::decode_loop, this);
+    auto decoder_finished = [this]
+    { return m_decoder_done.load(); };
+
+    bool playing = true;
+    while (playing && !m_stop.load())
+    {
+        m_ring.wait_until_size_at_least(m_config.prefill_periods, decoder_finished);
+
+        while (!m_stop.load())
+        {
+            size_t occupancy = m_ring.size();
+            const Period *period = m_ring.try_acquire_read();
+            if (period == nullptr)
+            {
+                if (!m_decoder_done.load())
+                {
+                    m_ring_underruns.fetch_add(1, std::memory_order_relaxed);
+                    m_min_ring_occupancy.store(0, std::memory_order_relaxed);
+                }
+                else
+                {
+                    // the end marker is on its way
+                    m_ring.wait_until_size_at_least(1, []
+                                                    { return false; });
+                }
+                break;
+            }
+
+            if (period->frames == 0)
+            {
+                m_ring.release_read();
+                playing = false;
+                break;
+            }
+
+            if (occupancy < m_min_ring_occupancy.load(std::memory_order_relaxed))
+            {
+                m_min_ring_occupancy.store(occupancy, std::memory_order_relaxed);
+            }
+
+            for (uint32_t i = 0; i < period->tracks_started; i++)
+            {
+                m_tracks_started.fetch_add(1, std::memory_order_relaxed);
+                if (m_tracks.started)
+                {
+                    m_tracks.started();
+                }
+            }
+
+            bool written = m_output.write(period->data.data(), period->frames);
+            m_ring.release_read();
+            m_periods_played.fetch_add(1, std::memory_order_relaxed);
+
+            if (!written)
+            {
+                m_stop.store(true);
+            }
+        }
+    }
+
+    // hand every slot back so a decoder waiting on the ring sees the stop request
+    while (true)
+    {
+        if (m_ring.try_acquire_read() != nullptr)
+        {
+            m_ring.release_read();
+        }
+        else if (m_decoder_done.load())
+        {
+            break;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    decoder_thread.join();
+
+    if (m_decoder_error)
+    {
+        std::rethrow_exception(m_decoder_error);
+    }
+}
+
+mc::Playback_stats mc::Playback_engine::get_stats() const
+{
+    Playback_stats stats;
+    stats.ring_capacity = m_ring.capacity();
+    stats.ring_occupancy = m_ring.size();
+    stats.min_ring_occupancy = m_min_ring_occupancy.load(std::memory_order_relaxed);
+    stats.periods_decoded = m_periods_decoded.load(std::memory_order_relaxed);
+    stats.periods_played = m_periods_played.load(std::memory_order_relaxed);
+    stats.ring_underruns = m_ring_underruns.load(std::memory_order_relaxed);
+    stats.device_underruns = m_output.get_underruns();
+    stats.tracks_started = m_tracks_started.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,152 @@
+#include "Playlist.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    void add_decode_errors(Decode_errors &total, const Decode_errors &errors)
+    {
+        total.crc_mismatches += errors.crc_mismatches;
+        total.corrupt_frames += errors.corrupt_frames;
+        total.concealed_samples += errors.concealed_samples;
+        total.skipped_samples += errors.skipped_samples;
+    }
+} // namespace
+
+mc::Playlist::Playlist(std::vector<std::string> paths, Crc_policy crc_policy, uint8_t cue_track)
+    : m_paths(std::move(paths)), m_crc_policy(crc_policy), m_cue_track(cue_track)
+{
+    start_preload();
+}
+
+mc::Playlist::~Playlist()
+{
+    if (m_preload.valid())
+    {
+        m_preload.wait();
+    }
+}
+
+mc::Playlist::Track mc::Playlist::open_track(const std::string &path, std::unique_ptr<Flac> decoder) const
+{
+    Track track;
+    track.entry.path = path;
+    try
+    {
+        track.file = std::make_unique<Mapped_file>(path);
+        if (decoder != nullptr)
+        {
+            decoder->reset(track.file->bytes());
+        }
+        else
+        {
+            decoder = std::make_unique<Flac>(track.file->bytes());
+        }
+        track.decoder = std::move(decoder);
+        track.decoder->set_crc_policy(m_crc_policy);
+        track.decoder->initialize();
+        if (m_cue_track != 0)
+        {
+            // seeks in the background too, so the track starts without delay
+            track.decoder->select_track(m_cue_track);
+        }
+
+        const Vorbis_comment &comments = track.decoder->get_vorbis_comment();
+        track.entry.artist = comments.find("ARTIST");
+        track.entry.title = comments.find("TITLE");
+        track.entry.album = comments.find("ALBUM");
+        track.entry.stream_info = track.decoder->get_stream_info();
+    }
+    catch (const std::exception &e)
+    {
+        track.error = e.what();
+        if (track.decoder == nullptr)
+        {
+            track.decoder = std::move(decoder);
+        }
+    }
+    return track;
+}
+
+void mc::Playlist::start_preload()
+{
+    if (m_next_path == m_paths.size())
+    {
+        return;
+    }
+    const std::string &path = m_paths[m_next_path++];
+    m_preload = std::async(std::launch::async, &Playlist::open_track, this, std::cref(path), std::move(m_spare_decoder));
+}
+
+bool mc::Playlist::wait_for_next()
+{
+    while (!m_next_ready)
+    {
+        if (!m_preload.valid())
+        {
+            return false;
+        }
+
+        Track track = m_preload.get();
+        if (!track.error.empty())
+        {
+            m_failures.emplace_back(track.entry.path, track.error);
+            m_spare_decoder = std::move(track.decoder);
+            start_preload();
+            continue;
+        }
+        m_next = std::move(track);
+        m_next_ready = true;
+    }
+    return true;
+}
+
+const Stream_info *mc::Playlist::peek_next()
+{
+    return wait_for_next() ? &m_next.entry.stream_info : nullptr;
+}
+
+bool mc::Playlist::advance()
+{
+    if (!wait_for_next())
+    {
+        return false;
+    }
+
+    // the finished decoder keeps its buffers for the track after the next one
+    if (m_current.decoder != nullptr)
+    {
+        add_decode_errors(m_finished_errors, m_current.decoder->get_decode_errors());
+        m_spare_decoder = std::move(m_current.decoder);
+    }
+    m_current = std::move(m_next);
+    m_next_ready = false;
+    {
+        std::lock_guard lock(m_mutex);
+        m_entries.push_back(m_current.entry);
+    }
+
+    start_preload();
+    return true;
+}
+
+mc::Playlist_entry mc::Playlist::get_entry(size_t track_number) const
+{
+    std::lock_guard lock(m_mutex);
+    if (track_number == 0 || track_number > m_entries.size())
+    {
+        throw std::out_of_range("No such track has been opened");
+    }
+    return m_entries[track_number - 1];
+}
+
+Decode_errors mc::Playlist::get_decode_errors() const
+{
+    Decode_errors errors = m_finished_errors;
+    if (m_current.decoder != nullptr)
+    {
+        add_decode_errors(errors, m_current.decoder->get_decode_errors());
+    }
+    return errors;
+}
@@ -0,0 +1,421 @@
+#include "Read_ahead_file.hpp"
+
+#include "Work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr size_t max_depth = 16;
+
+    std::runtime_error file_error(const std::string &what, const std::string &path)
+    {
+        return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+    }
+
+    // shared by every file using the pread backend, so read-ahead does not cost a thread per stream
+    mc::Work_stealing_pool &io_pool()
+    {
+        static mc::Work_stealing_pool pool(4);
+        return pool;
+    }
+
+    size_t pread_full(int fd, uint8_t *destination, size_t size, uint64_t offset, int &error)
+    {
+        size_t filled = 0;
+        while (filled < size)
+        {
+            ssize_t bytes_read = ::pread(fd, destination + filled, size - filled, static_cast<off_t>(offset + filled));
+            if (bytes_read < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                error = errno;
+                break;
+            }
+            if (bytes_read == 0)
+            {
+                break;
+            }
+            filled += bytes_read;
+        }
+        return filled;
+    }
+} // namespace
+
+mc::Read_ahead_file::Read_ahead_file(const std::string &path, size_t chunk_size, size_t depth, Backend backend)
+{
+    m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0)
+    {
+        throw file_error("Cannot open", path);
+    }
+
+    struct stat status{};
+    if (::fstat(m_fd, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        ::close(m_fd);
+        errno = EINVAL;
+        throw file_error("Cannot read ahead", path);
+    }
+    m_size = status.st_size;
+    ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    m_backend = Backend::PREAD;
+    if (backend != Backend::PREAD)
+    {
+        if (setup_uring(max_depth))
+        {
+            m_backend = Backend::IO_URING;
+        }
+        else
+        {
+            close_uring();
+        }
+        if (m_backend != Backend::IO_URING && backend == Backend::IO_URING)
+        {
+            ::close(m_fd);
+            throw std::runtime_error("io_uring is not available");
+        }
+    }
+
+    configure(chunk_size, depth);
+    seek(0);
+}
+
+mc::Read_ahead_file::~Read_ahead_file()
+{
+    drain();
+    close_uring();
+    ::close(m_fd);
+}
+
+void mc::Read_ahead_file::close_uring()
+{
+    if (m_uring.fd < 0)
+    {
+        return;
+    }
+    if (m_uring.sqes != nullptr)
+    {
+        ::munmap(m_uring.sqes, m_uring.sqes_size);
+    }
+    if (m_uring.cq_ring != nullptr && m_uring.cq_ring != m_uring.sq_ring)
+    {
+        ::munmap(m_uring.cq_ring, m_uring.cq_ring_size);
+    }
+    if (m_uring.sq_ring != nullptr)
+    {
+        ::munmap(m_uring.sq_ring, m_uring.sq_ring_size);
+    }
+    ::close(m_uring.fd);
+    m_uring = {};
+}
+
+bool mc::Read_ahead_file::setup_uring(size_t entries)
+{
+    io_uring_params params{};
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0)
+    {
+        return false;
+    }
+    m_uring.fd = fd;
+
+    // IORING_OP_READ needs Linux 5.6, which is also when probing was added
+    std::vector<uint8_t> probe_buffer(sizeof(io_uring_probe) + (IORING_OP_READ + 1) * sizeof(io_uring_probe_op));
+    auto *probe = reinterpret_cast<io_uring_probe *>(probe_buffer.data());
+    if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_READ + 1) < 0 ||
+        probe->last_op < IORING_OP_READ || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED))
+    {
+        return false;
+    }
+
+    m_uring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_uring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+    {
+        m_uring.sq_ring_size = m_uring.cq_ring_size = std::max(m_uring.sq_ring_size, m_uring.cq_ring_size);
+    }
+
+    void *sq_ring = ::mmap(nullptr, m_uring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED)
+    {
+        return false;
+    }
+    m_uring.sq_ring = sq_ring;
+
+    void *cq_ring = single_mmap ? sq_ring
+                                : ::mmap(nullptr, m_uring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED)
+    {
+        return false;
+    }
+    m_uring.cq_ring = cq_ring;
+
+    m_uring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = ::mmap(nullptr, m_uring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        return false;
+    }
+    m_uring.sqes = static_cast<io_uring_sqe *>(sqes);
+
+    auto *sq = static_cast<uint8_t *>(sq_ring);
+    auto *cq = static_cast<uint8_t *>(cq_ring);
+    m_uring.sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_uring.sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_uring.sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    m_uring.cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_uring.cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_uring.cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_uring.cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+void mc::Read_ahead_file::configure(size_t chunk_size, size_t depth)
+{
+    m_next_chunk_size = std::max<size_t>(chunk_size, 4096);
+    m_next_depth = std::clamp<size_t>(depth, 2, max_depth);
+    if (m_next_chunk_size != m_chunk_size || m_next_depth != m_slots.size())
+    {
+        seek(read_position());
+    }
+}
+
+void mc::Read_ahead_file::tune(const Stream_info &stream_info)
+{
+    uint64_t frame_size = stream_info.max_frame_size;
+    if (frame_size == 0)
+    {
+        frame_size = static_cast<uint64_t>(std::max<uint16_t>(stream_info.max_block_size, 4096)) * stream_info.channels *
+                         ((stream_info.bits_per_sample + 7) / 8) +
+                     64;
+    }
+
+    size_t chunk_size = std::clamp<uint64_t>(std::bit_ceil(frame_size * 16), 1 << 16, 1 << 20);
+    uint64_t ahead = std::max<uint64_t>(frame_size * 64, 1 << 20);
+    configure(chunk_size, 1 + (ahead + chunk_size - 1) / chunk_size);
+}
+
+uint64_t mc::Read_ahead_file::read_position() const
+{
+    if (m_restart)
+    {
+        return m_restart_offset;
+    }
+    return m_base + (m_consumed + (m_held ? 1 : 0)) * m_chunk_size;
+}
+
+void mc::Read_ahead_file::seek(uint64_t offset)
+{
+    m_restart = true;
+    m_restart_offset = offset;
+}
+
+std::span<const uint8_t> mc::Read_ahead_file::next_chunk()
+{
+    if (m_held)
+    {
+        m_held = false;
+        m_consumed++;
+    }
+
+    if (m_restart)
+    {
+        drain();
+        if (m_next_chunk_size != m_chunk_size || m_next_depth != m_slots.size())
+        {
+            m_chunk_size = m_next_chunk_size;
+            m_slots.clear();
+            m_slots.resize(m_next_depth);
+            for (auto &slot : m_slots)
+            {
+                slot.data.resize(m_chunk_size);
+            }
+        }
+        for (auto &slot : m_slots)
+        {
+            slot.ready = false;
+        }
+        m_base = m_restart_offset;
+        m_consumed = 0;
+        m_submitted = 0;
+        m_restart = false;
+    }
+
+    // the chunk handed back above is free again, keep every slot busy
+    while (m_submitted < m_consumed + m_slots.size() && m_base + m_submitted * m_chunk_size < m_size)
+    {
+        submit(m_submitted++);
+    }
+
+    if (m_base + m_consumed * m_chunk_size >= m_size)
+    {
+        return {};
+    }
+
+    Slot &slot = m_slots[m_consumed % m_slots.size()];
+    wait_for(slot);
+    if (slot.error != 0)
+    {
+        errno = slot.error;
+        slot.ready = false;
+        m_restart = true;
+        m_restart_offset = slot.offset;
+        throw std::runtime_error(std::string("Cannot read ahead: ") + std::strerror(errno));
+    }
+
+    m_held = true;
+    return {slot.data.data(), slot.size};
+}
+
+void mc::Read_ahead_file::submit(uint64_t chunk)
+{
+    size_t index = chunk % m_slots.size();
+    Slot &slot = m_slots[index];
+    slot.offset = m_base + chunk * m_chunk_size;
+    slot.size = std::min<uint64_t>(m_chunk_size, m_size - slot.offset);
+    slot.filled = 0;
+    slot.error = 0;
+    slot.ready = false;
+    slot.in_flight = true;
+
+    if (m_backend == Backend::IO_URING)
+    {
+        submit_uring(slot, index);
+        return;
+    }
+
+    io_pool().submit([this, &slot]
+                     {
+                         int error = 0;
+                         size_t filled = pread_full(m_fd, slot.data.data(), slot.size, slot.offset, error);
+                         // notified under the lock, as the file may be destroyed as soon as it is released
+                         std::lock_guard lock(m_mutex);
+                         slot.filled = filled;
+                         slot.size = filled;
+                         slot.error = error;
+                         slot.ready = true;
+                         slot.in_flight = false;
+                         m_read_done.notify_all(); });
+}
+
+void mc::Read_ahead_file::submit_uring(Slot &slot, size_t index)
+{
+    unsigned tail = *m_uring.sq_tail;
+    unsigned entry = tail & *m_uring.sq_mask;
+    io_uring_sqe &sqe = m_uring.sqes[entry];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = m_fd;
+    sqe.addr = reinterpret_cast<uint64_t>(slot.data.data() + slot.filled);
+    sqe.len = static_cast<uint32_t>(slot.size - slot.filled);
+    sqe.off = slot.offset + slot.filled;
+    sqe.user_data = index;
+    m_uring.sq_array[entry] = entry;
+    __atomic_store_n(m_uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (::syscall(__NR_io_uring_enter, m_uring.fd, 1, 0, 0, nullptr, 0) < 0)
+    {
+        if (errno != EINTR && errno != EAGAIN)
+        {
+            throw std::runtime_error(std::string("Cannot submit read: ") + std::strerror(errno));
+        }
+    }
+}
+
+void mc::Read_ahead_file::reap_uring(bool wait)
+{
+    if (wait)
+    {
+        while (::syscall(__NR_io_uring_enter, m_uring.fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno == EINTR)
+        {
+        }
+    }
+
+    unsigned head = *m_uring.cq_head;
+    unsigned tail = __atomic_load_n(m_uring.cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        const io_uring_cqe &cqe = m_uring.cqes[head & *m_uring.cq_mask];
+        Slot &slot = m_slots[cqe.user_data];
+        if (cqe.res < 0)
+        {
+            slot.error = -cqe.res;
+        }
+        else
+        {
+            slot.filled += cqe.res;
+            // a short read of a regular file only means the rest has to be asked for again
+            if (cqe.res > 0 && slot.filled < slot.size)
+            {
+                __atomic_store_n(m_uring.cq_head, head + 1, __ATOMIC_RELEASE);
+                submit_uring(slot, cqe.user_data);
+                continue;
+            }
+        }
+        slot.size = slot.filled;
+        slot.ready = true;
+        slot.in_flight = false;
+    }
+    __atomic_store_n(m_uring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+void mc::Read_ahead_file::wait_for(Slot &slot)
+{
+    if (m_backend == Backend::IO_URING)
+    {
+        reap_uring(false);
+        if (!slot.ready)
+        {
+            m_stalls++;
+        }
+        while (!slot.ready)
+        {
+            reap_uring(true);
+        }
+        return;
+    }
+
+    std::unique_lock lock(m_mutex);
+    if (!slot.ready)
+    {
+        m_stalls++;
+    }
+    m_read_done.wait(lock, [&slot]
+                     { return slot.ready; });
+}
+
+void mc::Read_ahead_file::drain()
+{
+    for (auto &slot : m_slots)
+    {
+        if (m_backend == Backend::IO_URING)
+        {
+            while (slot.in_flight)
+            {
+                reap_uring(true);
+            }
+        }
+        else
+        {
+            std::unique_lock lock(m_mutex);
+            m_read_done.wait(lock, [&slot]
+                             { return !slot.in_flight; });
+        }
+    }
+}
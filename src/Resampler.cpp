@@ -0,0 +1,316 @@
+#include "Resampler.hpp"
+
+#include "predictors.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numbers>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MC_X86_SIMD 1
+#endif
+
+namespace
+{
+    // zero crossings of the sinc on each side at the cutoff, and the Kaiser window shape;
+    // together about 100 dB of stopband attenuation with a transition band of ~5% of the lower rate
+    constexpr double zero_crossings = 32;
+    constexpr double kaiser_beta = 10;
+    constexpr double passband = 0.95;
+
+    double bessel_i0(double x)
+    {
+        double sum = 1;
+        double term = 1;
+        for (int k = 1; term > sum * 1e-12; k++)
+        {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    float dot_scalar(const float *samples, const float *coefficients, size_t count)
+    {
+        float sums[8] = {};
+        for (size_t i = 0; i < count; i += 8)
+        {
+            for (size_t j = 0; j < 8; j++)
+            {
+                sums[j] += samples[i + j] * coefficients[i + j];
+            }
+        }
+        return ((sums[0] + sums[4]) + (sums[1] + sums[5])) + ((sums[2] + sums[6]) + (sums[3] + sums[7]));
+    }
+
+#ifdef MC_X86_SIMD
+    __attribute__((target("sse4.1"))) float dot_sse41(const float *samples, const float *coefficients, size_t count)
+    {
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (size_t i = 0; i < count; i += 8)
+        {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_load_ps(coefficients + i)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(samples + i + 4), _mm_load_ps(coefficients + i + 4)));
+        }
+        __m128 sum = _mm_add_ps(sum0, sum1);
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+
+    __attribute__((target("avx2"))) float dot_avx2(const float *samples, const float *coefficients, size_t count)
+    {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(samples + i), _mm256_load_ps(coefficients + i)));
+            sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(samples + i + 8), _mm256_load_ps(coefficients + i + 8)));
+        }
+        if (i < count)
+        {
+            sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(samples + i), _mm256_load_ps(coefficients + i)));
+        }
+        __m256 sum8 = _mm256_add_ps(sum0, sum1);
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+#endif
+
+    template <size_t Bytes>
+    std::byte *write_sample(std::byte *destination, float sample)
+    {
+        constexpr double scale = static_cast<double>(uint64_t{1} << (Bytes * 8 - 1));
+        double value = std::clamp(std::nearbyint(static_cast<double>(sample) * scale), -scale, scale - 1);
+        uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(value));
+        for (size_t byte = 0; byte < Bytes; byte++)
+        {
+            destination[byte] = static_cast<std::byte>(bits >> (8 * byte));
+        }
+        return destination + Bytes;
+    }
+} // namespace
+
+mc::Resampler::Resampler(uint32_t input_rate, uint32_t output_rate, uint8_t channels, size_t max_block_size)
+    : m_input_rate(input_rate), m_output_rate(output_rate), m_channels(channels)
+{
+    if (input_rate == 0 || output_rate == 0 || channels == 0 || channels > 8)
+    {
+        throw std::invalid_argument("Unsupported resampling parameters");
+    }
+    m_table = get_table(input_rate, output_rate);
+
+    m_dot = dot_scalar;
+#ifdef MC_X86_SIMD
+    switch (get_simd_level())
+    {
+    case Simd_level::AVX2:
+        m_dot = dot_avx2;
+        break;
+    case Simd_level::SSE4_1:
+        m_dot = dot_sse41;
+        break;
+    default:
+        break;
+    }
+#endif
+
+    m_stride = max_block_size + 2 * m_table->taps;
+    m_history.resize(m_stride * m_channels);
+    reset();
+}
+
+std::shared_ptr<const mc::Resampler::Filter_table> mc::Resampler::get_table(uint32_t input_rate, uint32_t output_rate)
+{
+    static std::mutex mutex;
+    static std::map<std::pair<uint32_t, uint32_t>, std::shared_ptr<const Filter_table>> tables;
+
+    std::lock_guard lock(mutex);
+    auto &table = tables[{input_rate, output_rate}];
+    if (table != nullptr)
+    {
+        return table;
+    }
+
+    auto built = std::make_shared<Filter_table>();
+    uint32_t divisor = std::gcd(input_rate, output_rate);
+    built->phases = output_rate / divisor;
+    built->step = input_rate / divisor;
+
+    // cutoff as a fraction of the input Nyquist frequency; downsampling narrows it and lengthens the filter
+    double cutoff = passband * std::min(1.0, static_cast<double>(output_rate) / input_rate);
+    size_t half_length = static_cast<size_t>(std::ceil(zero_crossings / cutoff));
+    built->taps = (2 * half_length + 7) / 8 * 8;
+    built->coefficients.resize(built->phases * built->taps);
+
+    double half = built->taps / 2.0;
+    double window_scale = 1 / bessel_i0(kaiser_beta);
+    for (uint32_t phase = 0; phase < built->phases; phase++)
+    {
+        float *coefficients = built->coefficients.data() + phase * built->taps;
+        double offset = half - 1 + static_cast<double>(phase) / built->phases;
+
+        double sum = 0;
+        for (size_t k = 0; k < built->taps; k++)
+        {
+            double distance = k - offset;
+            double ratio = distance / half;
+            double window = ratio * ratio < 1 ? bessel_i0(kaiser_beta * std::sqrt(1 - ratio * ratio)) * window_scale : 0;
+            double x = std::numbers::pi * cutoff * distance;
+            double sinc = x == 0 ? 1 : std::sin(x) / x;
+            coefficients[k] = static_cast<float>(cutoff * sinc * window);
+            sum += coefficients[k];
+        }
+
+        // unity gain at DC in every phase, so the phases do not modulate the level
+        for (size_t k = 0; k < built->taps; k++)
+        {
+            coefficients[k] = static_cast<float>(coefficients[k] / sum);
+        }
+    }
+
+    table = std::move(built);
+    return table;
+}
+
+void mc::Resampler::reset()
+{
+    // the filter looks ahead half its length: start with that much silence in front of the input
+    size_t delay = m_table->taps / 2 - 1;
+    for (uint8_t channel = 0; channel < m_channels; channel++)
+    {
+        std::fill_n(m_history.data() + channel * m_stride, delay, 0.0f);
+    }
+    m_size = delay;
+    m_position = 0;
+    m_phase = 0;
+    m_input_frames = 0;
+    m_output_frames = 0;
+    m_finished = false;
+}
+
+void mc::Resampler::reserve_input(size_t count)
+{
+    if (m_size + count <= m_stride)
+    {
+        return;
+    }
+
+    // drop the history no output needs anymore
+    size_t keep = m_size - m_position;
+    if (m_position > 0)
+    {
+        for (uint8_t channel = 0; channel < m_channels; channel++)
+        {
+            float *base = m_history.data() + channel * m_stride;
+            std::memmove(base, base + m_position, keep * sizeof(float));
+        }
+        m_size = keep;
+        m_position = 0;
+    }
+
+    if (m_size + count > m_stride)
+    {
+        size_t stride = m_size + count + m_table->taps;
+        std::vector<float> history(stride * m_channels);
+        for (uint8_t channel = 0; channel < m_channels; channel++)
+        {
+            std::copy_n(m_history.data() + channel * m_stride, m_size, history.data() + channel * stride);
+        }
+        m_history = std::move(history);
+        m_stride = stride;
+    }
+}
+
+void mc::Resampler::push(std::span<const std::span<const int32_t>> channels, uint8_t bits_per_sample)
+{
+    size_t count = channels.empty() ? 0 : channels[0].size();
+    reserve_input(count);
+
+    float scale = std::ldexp(1.0f, 1 - bits_per_sample);
+    for (uint8_t channel = 0; channel < m_channels; channel++)
+    {
+        const int32_t *source = channels[channel].data();
+        float *destination = m_history.data() + channel * m_stride + m_size;
+        for (size_t i = 0; i < count; i++)
+        {
+            destination[i] = static_cast<float>(source[i]) * scale;
+        }
+    }
+    m_size += count;
+    m_input_frames += count;
+}
+
+void mc::Resampler::finish()
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    // enough silence behind the last sample for the filter to reach past it
+    size_t tail = m_table->taps / 2 + 1;
+    reserve_input(tail);
+    for (uint8_t channel = 0; channel < m_channels; channel++)
+    {
+        std::fill_n(m_history.data() + channel * m_stride + m_size, tail, 0.0f);
+    }
+    m_size += tail;
+    m_finished = true;
+}
+
+size_t mc::Resampler::pull(std::span<std::byte> destination, Pcm_format format, size_t frames)
+{
+    const Filter_table &table = *m_table;
+    size_t bytes = pcm_format_bytes(format);
+    frames = std::min(frames, destination.size() / (bytes * m_channels));
+
+    // once the input has ended, the output stops at the same point in time
+    uint64_t limit = std::numeric_limits<uint64_t>::max();
+    if (m_finished)
+    {
+        limit = (m_input_frames * table.phases + table.step - 1) / table.step;
+    }
+
+    std::byte *output = destination.data();
+    size_t written = 0;
+    while (written < frames && m_position + table.taps <= m_size && m_output_frames < limit)
+    {
+        const float *coefficients = table.coefficients.data() + m_phase * table.taps;
+        for (uint8_t channel = 0; channel < m_channels; channel++)
+        {
+            float sample = m_dot(m_history.data() + channel * m_stride + m_position, coefficients, table.taps);
+            switch (format)
+            {
+            case Pcm_format::S16_LE:
+                output = write_sample<2>(output, sample);
+                break;
+            case Pcm_format::S24_3LE:
+                output = write_sample<3>(output, sample);
+                break;
+            case Pcm_format::S32_LE:
+                output = write_sample<4>(output, sample);
+                break;
+            }
+        }
+
+        m_phase += table.step;
+        m_position += m_phase / table.phases;
+        m_phase %= table.phases;
+        m_output_frames++;
+        written++;
+    }
+    return written;
+}
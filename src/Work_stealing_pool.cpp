@@ -0,0 +1,149 @@
+#include "Work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+    thread_local const mc::Work_stealing_pool *current_pool{};
+    thread_local size_t current_worker{};
+} // namespace
+
+mc::Work_stealing_pool::Work_stealing_pool(size_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_queues.push_back(std::make_unique<Task_queue>());
+    }
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_threads.emplace_back(&Work_stealing_pool::worker_loop, this, i);
+    }
+}
+
+mc::Work_stealing_pool::~Work_stealing_pool()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_task_available.notify_all();
+
+    for (auto &thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void mc::Work_stealing_pool::submit(std::function<void()> task)
+{
+    size_t queue;
+    {
+        std::lock_guard lock(m_mutex);
+        queue = (current_pool == this) ? current_worker : m_next_queue++ % m_queues.size();
+        m_unfinished++;
+    }
+
+    {
+        std::lock_guard lock(m_queues[queue]->mutex);
+        m_queues[queue]->tasks.push_back(std::move(task));
+    }
+
+    // counted only once it can be popped, so no worker wakes for a task still on its way
+    {
+        std::lock_guard lock(m_mutex);
+        m_queued++;
+    }
+    m_task_available.notify_one();
+}
+
+void mc::Work_stealing_pool::wait()
+{
+    std::unique_lock lock(m_mutex);
+    m_all_done.wait(lock, [this]
+                    { return m_unfinished == 0; });
+
+    if (m_error)
+    {
+        std::exception_ptr error = std::exchange(m_error, nullptr);
+        std::rethrow_exception(error);
+    }
+}
+
+bool mc::Work_stealing_pool::try_pop(size_t worker, std::function<void()> &task)
+{
+    {
+        Task_queue &own = *m_queues[worker];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < m_queues.size(); i++)
+    {
+        Task_queue &victim = *m_queues[(worker + i) % m_queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void mc::Work_stealing_pool::worker_loop(size_t worker)
+{
+    current_pool = this;
+    current_worker = worker;
+
+    while (true)
+    {
+        std::function<void()> task;
+        if (try_pop(worker, task))
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_queued--;
+            }
+
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                std::lock_guard lock(m_mutex);
+                if (!m_error)
+                {
+                    m_error = std::current_exception();
+                }
+            }
+
+            std::lock_guard lock(m_mutex);
+            if (--m_unfinished == 0)
+            {
+                m_all_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock lock(m_mutex);
+        m_task_available.wait(lock, [this]
+                              { return m_queued > 0 || m_stopping; });
+        if (m_stopping && m_queued <= 0)
+        {
+            return;
+        }
+    }
+}
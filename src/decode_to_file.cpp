@@ -0,0 +1,51 @@
+#include "decode_to_file.hpp"
+
+#include "Flac.hpp"
+#include "Mapped_file.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+mc::Decode_file_stats mc::decode_to_file(const std::string &input, const std::string &output, const Decode_file_options &options)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // the mapping backs every read of the decoder, so it has to outlive it
+    Mapped_file flac_file(input);
+    Flac flac(flac_file.bytes());
+    flac.set_crc_policy(options.crc_policy);
+    flac.initialize();
+    if (options.cue_track != 0)
+    {
+        flac.select_track(options.cue_track);
+    }
+    else if (options.verify_md5)
+    {
+        flac.enable_md5_check();
+    }
+
+    const Stream_info &info = flac.get_stream_info();
+    Pcm_format format = info.bits_per_sample <= 16 ? Pcm_format::S16_LE : info.bits_per_sample <= 24 ? Pcm_format::S24_3LE : Pcm_format::S32_LE;
+    size_t frame_bytes = static_cast<size_t>(info.channels) * pcm_format_bytes(format);
+    size_t max_frame_bytes = flac.max_frame_bytes(format);
+
+    Pcm_file_writer writer(output, options.type, info.channels, info.sample_rate, info.bits_per_sample, format, options.direct_io,
+                           std::max(options.block_size, 2 * max_frame_bytes + Pcm_file_writer::alignment), options.block_count);
+
+    Decode_file_stats stats;
+    while (size_t frames = flac.decode_frame_into(writer.get_buffer(max_frame_bytes), format))
+    {
+        writer.commit(frames * frame_bytes);
+        stats.samples += frames;
+    }
+    writer.finish();
+
+    stats.sample_rate = info.sample_rate;
+    stats.bytes_written = writer.get_bytes();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.write_stalls = writer.get_stalls();
+    stats.direct_io = writer.is_direct();
+    stats.md5_status = options.verify_md5 ? flac.get_md5_status() : Md5_status::UNCHECKED;
+    stats.decode_errors = flac.get_decode_errors();
+    return stats;
+}
@@ -1,9 +1,8 @@
 #include "decoders.hpp"
 
-uint64_t decode_utf8(std::ifstream &file_stream)
+bool decode_utf8(mc::Buffered_bit_reader &reader, uint64_t &code_point)
 {
-    unsigned char first_byte;
-    file_stream.read(reinterpret_cast<char *>(&first_byte), 1);
+    uint8_t first_byte = reader.read_bits(8);
 
     static const struct
     {
@@ -19,8 +18,7 @@ uint64_t decode_utf8(std::ifstream &file_stream)
         {0xFE, 0xFC, 5},
         {0xFF, 0xFE, 6}};
 
-    uint64_t code_point = 0;
-    size_t additional_bytes = 0;
+    size_t additional_bytes = 7;
 
     for (const auto &mask : utf8_masks)
     {
@@ -34,37 +32,30 @@ uint64_t decode_utf8(std::ifstream &file_stream)
 
     if (additional_bytes > 6)
     {
-        throw std::runtime_error("Invalid UTF-8 encoding: too many bytes");
+        return false;
     }
 
     for (size_t i = 0; i < additional_bytes; ++i)
     {
-        unsigned char next_byte;
-        file_stream.read(reinterpret_cast<char *>(&next_byte), 1);
+        uint8_t next_byte = reader.read_bits(8);
 
         if ((next_byte & 0xC0) != 0x80)
         {
-            throw std::runtime_error("Invalid continuation byte in UTF-8");
+            return false;
         }
 
         code_point = (code_point << 6) | (next_byte & 0x3F);
     }
 
-    return code_point;
+    return true;
 }
 
-uint64_t decode_unary(mc::Bit_reader<std::ifstream> &reader)
+uint64_t decode_unary(mc::Buffered_bit_reader &reader)
 {
-    uint64_t result = 0;
-
-    while (reader.read_bits_unsigned(1) == 0)
-    {
-        result++;
-    }
-    return result;
+    return reader.read_unary();
 }
 
-int64_t decode_and_unfold_rice(uint8_t rice_parameter, mc::Bit_reader<std::ifstream> &reader)
+int64_t decode_and_unfold_rice(uint8_t rice_parameter, mc::Buffered_bit_reader &reader)
 {
     uint64_t quotient = decode_unary(reader);
     uint64_t remainder = reader.read_bits_unsigned(rice_parameter);
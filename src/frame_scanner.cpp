@@ -0,0 +1,183 @@
+#include "frame_scanner.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#include "Flac_constants.hpp"
+#include "crc.hpp"
+
+size_t mc::parse_frame_header(std::span<const uint8_t> data, const Stream_info &stream_info, Frame_info &frame_info)
+{
+    // the longest header: 4 fixed bytes, a 7 byte coded number, 2 + 2 optional bytes and the CRC-8
+    if (data.size() < 6 || data[0] != 0xFF || (data[1] & 0xFE) != 0xF8)
+    {
+        return 0;
+    }
+
+    uint8_t block_size_code = data[2] >> 4;
+    uint8_t sample_rate_code = data[2] & 0x0F;
+    uint8_t channel_assignment = data[3] >> 4;
+    uint8_t sample_size_code = (data[3] >> 1) & 0x07;
+
+    if (block_size_code == 0 || sample_rate_code == 0x0F || channel_assignment > 0b1010 ||
+        sample_size_code == 0b011 || (data[3] & 0x01) != 0)
+    {
+        return 0;
+    }
+
+    uint8_t channels = channel_assignment <= 0b0111 ? channel_assignment + 1 : 2;
+    if (channels != stream_info.channels)
+    {
+        return 0;
+    }
+
+    // UTF-8 style coded frame or sample number
+    size_t position = 4;
+    uint8_t first_byte = data[position++];
+    uint8_t length = std::countl_one(first_byte);
+    if (length == 1 || length > 7)
+    {
+        return 0;
+    }
+    uint64_t number = length == 0 ? first_byte : first_byte & (0x7F >> length);
+    for (uint8_t i = 1; i < length; i++)
+    {
+        if (position == data.size() || (data[position] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        number = (number << 6) | (data[position++] & 0x3F);
+    }
+
+    size_t extra_bytes = (block_size_code == 0b0110 ? 1 : block_size_code == 0b0111 ? 2 : 0) +
+                         (sample_rate_code == 0b1100 ? 1 : sample_rate_code >= 0b1101 ? 2 : 0);
+    if (position + extra_bytes >= data.size())
+    {
+        return 0;
+    }
+
+    uint16_t block_size = Flac_constants::block_sizes[block_size_code];
+    if (block_size_code == 0b0110)
+    {
+        block_size = data[position++] + 1;
+    }
+    else if (block_size_code == 0b0111)
+    {
+        block_size = ((data[position] << 8) | data[position + 1]) + 1;
+        position += 2;
+    }
+
+    uint32_t sample_rate = sample_rate_code == 0 ? stream_info.sample_rate : Flac_constants::sample_rates[sample_rate_code];
+    if (sample_rate_code == 0b1100)
+    {
+        sample_rate = data[position++] * 1000;
+    }
+    else if (sample_rate_code >= 0b1101)
+    {
+        sample_rate = (data[position] << 8) | data[position + 1];
+        sample_rate *= sample_rate_code == 0b1110 ? 10 : 1;
+        position += 2;
+    }
+
+    if (crc8(data.data(), position) != data[position])
+    {
+        return 0;
+    }
+
+    frame_info.blocking_strategy = data[1] & 0x01;
+    frame_info.block_size = block_size;
+    frame_info.sample_rate = sample_rate;
+    frame_info.channel_assignment = channel_assignment;
+    frame_info.bits_per_sample = sample_size_code == 0 ? stream_info.bits_per_sample : Flac_constants::bits_per_sample_table[sample_size_code];
+    frame_info.frame_or_sample_number = number;
+    frame_info.crc_8 = data[position];
+    return position + 1;
+}
+
+std::vector<mc::Frame_location> mc::scan_frames(std::span<const uint8_t> data, const Stream_info &stream_info, std::vector<Frame_gap> *gaps)
+{
+    std::vector<Frame_location> frames;
+    Frame_info frame_info;
+
+    size_t header_size = parse_frame_header(data, stream_info, frame_info);
+    if (header_size == 0)
+    {
+        throw std::runtime_error("Frames do not start with a valid frame header");
+    }
+
+    const uint8_t blocking_strategy = frame_info.blocking_strategy;
+    const uint8_t second_sync_byte = 0xF8 | blocking_strategy;
+    // every frame of a fixed blocking stream but the last has the block size of the first
+    const uint64_t nominal_block_size = frame_info.block_size;
+    Frame_location current{0, 0, 0, frame_info.block_size};
+    uint64_t number = frame_info.frame_or_sample_number;
+
+    auto first_sample_of = [&](uint64_t frame_or_sample_number)
+    {
+        return blocking_strategy ? frame_or_sample_number : frame_or_sample_number * nominal_block_size;
+    };
+
+    while (true)
+    {
+        // fixed blocking numbers frames, variable blocking numbers samples
+        uint64_t expected_number = blocking_strategy ? number + current.block_size : number + 1;
+        size_t minimum_size = std::max<size_t>(header_size + 2, stream_info.min_frame_size);
+        size_t search = current.offset + minimum_size;
+        size_t next_offset = data.size();
+
+        while (search + 1 < data.size())
+        {
+            const void *found = std::memchr(data.data() + search, 0xFF, data.size() - search - 1);
+            if (found == nullptr)
+            {
+                break;
+            }
+            size_t candidate = static_cast<const uint8_t *>(found) - data.data();
+            if (data[candidate + 1] == second_sync_byte)
+            {
+                // a larger number than expected means the headers in between are damaged; it is
+                // only taken if it lies within the stream, which rejects most false syncs
+                Frame_info candidate_info;
+                size_t candidate_header_size = parse_frame_header(data.subspan(candidate), stream_info, candidate_info);
+                uint64_t candidate_number = candidate_info.frame_or_sample_number;
+                if (candidate_header_size != 0 &&
+                    (candidate_number == expected_number ||
+                     (candidate_number > expected_number &&
+                      (stream_info.total_samples == 0 || first_sample_of(candidate_number) < stream_info.total_samples))))
+                {
+                    next_offset = candidate;
+                    header_size = candidate_header_size;
+                    frame_info = candidate_info;
+                    break;
+                }
+            }
+            search = candidate + 1;
+        }
+
+        current.size = next_offset - current.offset;
+        frames.push_back(current);
+        if (next_offset == data.size())
+        {
+            break;
+        }
+
+        uint64_t next_sample = current.first_sample + current.block_size;
+        if (frame_info.frame_or_sample_number != expected_number)
+        {
+            // the frame before the gap keeps the damaged bytes; decoding it stops at its own end
+            uint64_t resumed_sample = first_sample_of(frame_info.frame_or_sample_number);
+            if (gaps != nullptr)
+            {
+                gaps->push_back({next_sample, resumed_sample - next_sample});
+            }
+            next_sample = resumed_sample;
+        }
+
+        current = {next_offset, 0, next_sample, frame_info.block_size};
+        number = frame_info.frame_or_sample_number;
+    }
+
+    return frames;
+}
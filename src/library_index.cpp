@@ -0,0 +1,224 @@
+#include "library_index.hpp"
+
+#include "Work_stealing_pool.hpp"
+#include "metadata.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    constexpr size_t batch_size = 64;
+
+    struct Scan_state
+    {
+        mc::Work_stealing_pool &pool;
+        std::ostream &index;
+        std::mutex index_mutex;
+        std::atomic<uint64_t> directories{};
+        std::atomic<uint64_t> files{};
+        std::atomic<uint64_t> failed{};
+        std::atomic<uint64_t> reads{};
+        std::atomic<uint64_t> bytes_read{};
+
+        Scan_state(mc::Work_stealing_pool &pool, std::ostream &index) : pool(pool), index(index) {}
+    };
+
+    bool is_flac_file(const std::filesystem::path &path)
+    {
+        std::string extension = path.extension().string();
+        return extension.size() == 5 && extension[0] == '.' && (extension[1] | 0x20) == 'f' && (extension[2] | 0x20) == 'l' &&
+               (extension[3] | 0x20) == 'a' && (extension[4] | 0x20) == 'c';
+    }
+
+    void scan_files(Scan_state &state, const std::vector<std::string> &paths)
+    {
+        // one scanner per worker, so its buffers and arena are reused across batches
+        thread_local mc::Metadata_scanner scanner;
+        uint64_t reads = scanner.get_reads();
+        uint64_t bytes_read = scanner.get_bytes_read();
+
+        std::string entries;
+        uint64_t failed = 0;
+        for (const auto &path : paths)
+        {
+            try
+            {
+                mc::append_index_entry(entries, path, scanner.scan(path));
+            }
+            catch (const std::exception &e)
+            {
+                entries += "{\"path\":";
+                mc::append_json_string(entries, path);
+                entries += ",\"error\":";
+                mc::append_json_string(entries, e.what());
+                entries += "}\n";
+                failed++;
+            }
+        }
+
+        state.files.fetch_add(paths.size(), std::memory_order_relaxed);
+        state.failed.fetch_add(failed, std::memory_order_relaxed);
+        state.reads.fetch_add(scanner.get_reads() - reads, std::memory_order_relaxed);
+        state.bytes_read.fetch_add(scanner.get_bytes_read() - bytes_read, std::memory_order_relaxed);
+
+        std::lock_guard lock(state.index_mutex);
+        state.index << entries;
+    }
+
+    void scan_directory(Scan_state &state, const std::filesystem::path &directory)
+    {
+        state.directories.fetch_add(1, std::memory_order_relaxed);
+
+        std::error_code error;
+        std::filesystem::directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, error);
+        std::vector<std::string> batch;
+        for (; !error && it != std::filesystem::directory_iterator(); it.increment(error))
+        {
+            // symlink_status, so links to directories cannot make the walk loop
+            std::filesystem::file_type type = it->symlink_status(error).type();
+            if (type == std::filesystem::file_type::directory)
+            {
+                std::filesystem::path subdirectory = it->path();
+                state.pool.submit([&state, subdirectory]
+                                  { scan_directory(state, subdirectory); });
+            }
+            else if (is_flac_file(it->path()) && it->is_regular_file(error))
+            {
+                batch.push_back(it->path().string());
+                if (batch.size() == batch_size)
+                {
+                    state.pool.submit([&state, paths = std::move(batch)]
+                                      { scan_files(state, paths); });
+                    batch.clear();
+                }
+            }
+        }
+        if (!batch.empty())
+        {
+            scan_files(state, batch);
+        }
+    }
+} // namespace
+
+void mc::append_json_string(std::string &out, std::string_view text)
+{
+    static constexpr char hex[] = "0123456789abcdef";
+    out += '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xF];
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void mc::append_index_entry(std::string &entry, const std::string &path, const Flac_metadata &metadata)
+{
+    static constexpr char hex[] = "0123456789abcdef";
+    const Stream_info &info = metadata.stream_info;
+
+    entry += "{\"path\":";
+    append_json_string(entry, path);
+    entry += ",\"size\":" + std::to_string(metadata.file_size);
+    entry += ",\"mtime\":" + std::to_string(metadata.modified_time);
+    entry += ",\"sample_rate\":" + std::to_string(info.sample_rate);
+    entry += ",\"channels\":" + std::to_string(info.channels);
+    entry += ",\"bits_per_sample\":" + std::to_string(info.bits_per_sample);
+    entry += ",\"total_samples\":" + std::to_string(info.total_samples);
+    entry += ",\"md5\":\"";
+    for (uint8_t byte : info.md5_signature)
+    {
+        entry += hex[byte >> 4];
+        entry += hex[byte & 0xF];
+    }
+    entry += "\",\"vendor\":";
+    append_json_string(entry, metadata.vorbis_comment.vendor_string);
+    entry += ",\"comments\":[";
+    bool first = true;
+    for (const auto &[field, value] : metadata.vorbis_comment.user_comments)
+    {
+        entry += first ? "[" : ",[";
+        append_json_string(entry, field);
+        entry += ',';
+        append_json_string(entry, value);
+        entry += ']';
+        first = false;
+    }
+    entry += "],\"pictures\":[";
+    first = true;
+    for (const Picture &picture : metadata.pictures)
+    {
+        entry += first ? "{\"type\":" : ",{\"type\":";
+        entry += std::to_string(picture.type);
+        entry += ",\"mime\":";
+        append_json_string(entry, picture.mime_type);
+        entry += ",\"width\":" + std::to_string(picture.width);
+        entry += ",\"height\":" + std::to_string(picture.height);
+        entry += ",\"offset\":" + std::to_string(picture.data_offset);
+        entry += ",\"length\":" + std::to_string(picture.data_length);
+        entry += '}';
+        first = false;
+    }
+    entry += "],\"tracks\":[";
+    first = true;
+    for (const Cue_track &track : metadata.cue_sheet.tracks)
+    {
+        uint64_t first_sample;
+        uint64_t end_sample;
+        if (!find_cue_track(metadata.cue_sheet, track.number, first_sample, end_sample))
+        {
+            continue;
+        }
+        entry += first ? "{\"number\":" : ",{\"number\":";
+        entry += std::to_string(track.number);
+        entry += ",\"first_sample\":" + std::to_string(first_sample);
+        entry += ",\"end_sample\":" + std::to_string(end_sample);
+        entry += ",\"isrc\":";
+        append_json_string(entry, track.isrc);
+        entry += '}';
+        first = false;
+    }
+    entry += "]}\n";
+}
+
+mc::Library_scan_stats mc::scan_library(const std::string &root, std::ostream &index, size_t thread_count)
+{
+    Work_stealing_pool pool(thread_count);
+    Scan_state state(pool, index);
+
+    if (std::filesystem::is_directory(root))
+    {
+        pool.submit([&state, root]
+                    { scan_directory(state, root); });
+        pool.wait();
+    }
+    else
+    {
+        scan_files(state, {root});
+    }
+
+    Library_scan_stats stats;
+    stats.directories = state.directories.load();
+    stats.files = state.files.load();
+    stats.failed = state.failed.load();
+    stats.reads = state.reads.load();
+    stats.bytes_read = state.bytes_read.load();
+    return stats;
+}
@@ -1,173 +1,444 @@
+#include "Alsa_output.hpp"
 #include "Flac.hpp"
-#include <alsa/asoundlib.h>
+#include "Mapped_file.hpp"
+#include "Playback_engine.hpp"
+#include "Playlist.hpp"
+#include "decode_to_file.hpp"
+#include "library_index.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
 
-std::vector<int32_t> convert_to_32bit(const std::vector<int64_t> &buffer)
+void print_decode_errors(const Decode_errors &errors)
 {
-    std::vector<int32_t> converted_buffer;
-    converted_buffer.reserve(buffer.size());
-
-    for (const auto &sample : buffer)
+    if (errors.crc_mismatches > 0 || errors.corrupt_frames > 0)
     {
-        converted_buffer.push_back(static_cast<int32_t>(sample));
+        std::cerr << "Damaged stream: " << errors.crc_mismatches << " CRC mismatches, " << errors.corrupt_frames
+                  << " undecodable frames, " << errors.concealed_samples << " samples concealed, "
+                  << errors.skipped_samples << " samples skipped\n";
     }
-
-    return converted_buffer;
 }
 
-int main(int argc, char *argv[])
+void print_now_playing(const mc::Playlist_entry &entry)
 {
-    if (argc != 2)
+    std::cout << "Now Playing: " << "\n";
+    if (!entry.artist.empty())
     {
-        std::cerr << "Usage: " << argv[0] << " <flac_file>\n";
-        return 1;
+        std::cout << "Artist: " << entry.artist << "\n";
+    }
+    else
+    {
+        std::cout << "Artist not found.\n";
+    }
+    if (!entry.title.empty())
+    {
+        std::cout << "Track Title: " << entry.title << "\n";
     }
+    else
+    {
+        std::cout << "Track Title not found.\n";
+    }
+    if (!entry.album.empty())
+    {
+        std::cout << "Ablum: " << entry.album << "\n";
+    }
+    else
+    {
+        std::cout << "Album not found.\n";
+    }
+}
 
-    std::string filename = argv[1];
-    std::ifstream flac_stream;
-    try
+void append_stats_entry(std::string &out, const std::string &path, const mc::Decode_stats &stats)
+{
+    out += "{\"path\":";
+    mc::append_json_string(out, path);
+    out += ",\"decode\":";
+    mc::append_stats_json(out, stats);
+    out += "}\n";
+}
+
+// one status line, redrawn in place: decode speed, codec paths taken, and how long the device blocks
+void print_live_stats(const mc::Decode_stats &decode, const mc::Output_stats &output, uint32_t sample_rate)
+{
+    auto percent = [](uint64_t part, uint64_t whole)
+    { return whole > 0 ? 100 * part / whole : 0; };
+
+    uint64_t fixed = 0;
+    for (const mc::Stat_counter &counter : decode.fixed_subframes)
     {
-        flac_stream.open(filename, std::ios::binary);
+        fixed += counter.get();
     }
-    catch (const std::exception &e)
+    uint64_t lpc = 0;
+    for (const mc::Stat_counter &counter : decode.lpc_subframes)
     {
-        std::cerr << e.what() << '\n';
-        return 1;
+        lpc += counter.get();
     }
+    uint64_t subframes = decode.constant_subframes.get() + decode.verbatim_subframes.get() + fixed + lpc;
+    uint64_t bits = decode.header_bits.get() + decode.subframe_bits.get() + decode.residual_bits.get() + decode.footer_bits.get();
+    uint64_t frames = decode.frames.get();
+    uint64_t writes = output.writes.get();
+    double decode_seconds = decode.frame_ns.get() / 1e9;
 
-    mc::Flac player(flac_stream);
-    snd_pcm_t *handle;
-    snd_pcm_hw_params_t *params;
-    int error;
+    std::cerr << "\r" << frames << " frames, " << (frames > 0 ? decode.frame_ns.get() / frames / 1000 : 0) << " us/frame (max "
+              << decode.max_frame_ns.get() / 1000 << "), "
+              << (decode_seconds > 0 ? static_cast<uint64_t>(decode.samples.get() / decode_seconds / sample_rate) : 0) << "x realtime | LPC "
+              << percent(lpc, subframes) << "% fixed " << percent(fixed, subframes) << "% verbatim "
+              << percent(decode.verbatim_subframes.get(), subframes) << "% constant " << percent(decode.constant_subframes.get(), subframes)
+              << "% | residuals " << percent(decode.residual_bits.get(), bits) << "% of bits | write "
+              << (writes > 0 ? output.write_ns.get() / writes / 1000000 : 0) << " ms (max " << output.max_write_ns.get() / 1000000
+              << "), " << output.underruns.get() << " underruns   " << std::flush;
+}
 
-    try
+int verify_file(const std::string &filename, Crc_policy crc_policy, mc::Decode_stats *stats)
+{
+    // the mapping backs every read of the decoder, so it has to outlive it
+    mc::Mapped_file flac_file(filename);
+    mc::Flac player(flac_file.bytes());
+    player.set_crc_policy(crc_policy);
+    player.initialize();
+    player.set_stats(stats);
+
+    // decode without playing, hashing every frame as it comes out of the decoder
+    player.enable_md5_check();
+    while (!player.eos())
     {
-        player.initialize();
-        int sample_rate = player.get_stream_info().sample_rate;
-        int channels = player.get_stream_info().channels;
-        int bit_depth = player.get_stream_info().bits_per_sample;
+        player.decode_frame();
+    }
 
-        const auto &comments = player.get_vorbis_comment().user_comments;
-        std::cout << "Now Playing: " << "\n";
-        auto it = comments.find("ARTIST");
-        if (it != comments.end())
+    Md5_status status = player.get_md5_status();
+    std::cout << filename << ": "
+              << (status == Md5_status::MATCH          ? "MD5 OK"
+                  : status == Md5_status::MISMATCH     ? "MD5 MISMATCH"
+                  : status == Md5_status::NO_SIGNATURE ? "no MD5 signature to check"
+                                                       : "not fully decoded")
+              << '\n';
+    print_decode_errors(player.get_decode_errors());
+    return status == Md5_status::MATCH || status == Md5_status::NO_SIGNATURE ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    mc::Playback_config config;
+    std::vector<std::string> filenames;
+    double start_seconds = 0;
+    Crc_policy crc_policy = Crc_policy::CONCEAL;
+    bool verify = false;
+    bool scan = false;
+    std::string index_path;
+    size_t scan_threads = 0;
+    std::string decode_path;
+    bool direct_io = false;
+    std::string stats_path;
+    bool live_stats = false;
+    int cue_track = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && std::strcmp(argv[i], "--period") == 0)
         {
-            std::cout << "Artist: " << it->second << "\n";
+            config.period_frames = std::stoul(argv[++i]);
         }
-        else
+        else if (i + 1 < argc && std::strcmp(argv[i], "--ring") == 0)
         {
-            std::cout << "Artist not found.\n";
+            config.ring_periods = std::stoul(argv[++i]);
         }
-        it = comments.find("TITLE");
-        if (it != comments.end())
+        else if (i + 1 < argc && std::strcmp(argv[i], "--prefill") == 0)
         {
-            std::cout << "Track Title: " << it->second << "\n";
+            config.prefill_periods = std::stoul(argv[++i]);
         }
-        else
+        else if (i + 1 < argc && std::strcmp(argv[i], "--low") == 0)
         {
-            std::cout << "Track Title not found.\n";
+            config.low_watermark = std::stoul(argv[++i]);
         }
-        it = comments.find("ALBUM");
-        if (it != comments.end())
+        else if (i + 1 < argc && std::strcmp(argv[i], "--high") == 0)
         {
-            std::cout << "Ablum: " << it->second << "\n";
+            config.high_watermark = std::stoul(argv[++i]);
         }
-        else
+        else if (i + 1 < argc && std::strcmp(argv[i], "--start") == 0)
         {
-            std::cout << "Album not found.\n";
+            start_seconds = std::stod(argv[++i]);
         }
-
-        // Open PCM device for playback
-        if ((error = snd_pcm_open(&handle, "default", SND_PCM_STREAM_PLAYBACK, 0)) < 0)
+        else if (i + 1 < argc && std::strcmp(argv[i], "--crc") == 0)
         {
-            std::cerr << "Cannot open audio device: " << snd_strerror(error) << "\n";
-            return 1;
+            std::string policy = argv[++i];
+            crc_policy = policy == "ignore" ? Crc_policy::IGNORE : policy == "verify" ? Crc_policy::VERIFY
+                                                               : policy == "skip"     ? Crc_policy::SKIP
+                                                                                      : Crc_policy::CONCEAL;
         }
-
-        // Allocate hardware parameters object
-        snd_pcm_hw_params_alloca(&params);
-
-        // Fill params with default values
-        if ((error = snd_pcm_hw_params_any(handle, params)) < 0)
+        else if (std::strcmp(argv[i], "--verify") == 0)
         {
-            std::cerr << "Cannot configure audio device: " << snd_strerror(error) << "\n";
-            snd_pcm_close(handle);
-            return 1;
+            verify = true;
         }
-
-        // Set parameters
-        if ((error = snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0)
+        else if (i + 1 < argc && std::strcmp(argv[i], "--decode") == 0)
         {
-            std::cerr << "Cannot set access type: " << snd_strerror(error) << "\n";
-            snd_pcm_close(handle);
-            return 1;
+            decode_path = argv[++i];
         }
-
-        // Set sample format
-        if ((error = snd_pcm_hw_params_set_format(handle, params, SND_PCM_FORMAT_S32_LE)) < 0)
+        else if (std::strcmp(argv[i], "--direct") == 0)
         {
-            std::cerr << "Cannot set sample format: " << snd_strerror(error) << "\n";
-            snd_pcm_close(handle);
-            return 1;
+            direct_io = true;
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--stats") == 0)
+        {
+            stats_path = argv[++i];
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--track") == 0)
+        {
+            cue_track = std::stoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--live") == 0)
+        {
+            live_stats = true;
+        }
+        else if (std::strcmp(argv[i], "--scan") == 0)
+        {
+            scan = true;
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "--index") == 0)
+        {
+            index_path = argv[++i];
+        }
+        else if (i + 1 < argc && std::strcmp(argv[i], "-j") == 0)
+        {
+            scan_threads = std::stoul(argv[++i]);
+        }
+        else
+        {
+            filenames.push_back(argv[i]);
         }
+    }
+
+    if (filenames.empty() || ((scan || !decode_path.empty()) && filenames.size() != 1) || cue_track < 0 || cue_track > 255 ||
+        (cue_track != 0 && (verify || scan)))
+    {
+        std::cerr << "Usage: " << argv[0] << " [--period frames] [--ring periods] [--prefill periods] [--low periods] [--high periods] [--start seconds] [--track number] [--crc ignore|verify|skip|conceal] [--verify] [--stats stats.jsonl] [--live] <flac_file>...\n"
+                  << "       " << argv[0] << " --decode out.wav|out.raw [--direct] [--track number] [--crc ignore|verify|skip|conceal] [--verify] <flac_file>\n"
+                  << "       " << argv[0] << " --scan [--index index.jsonl] [-j threads] <directory>\n";
+        return 1;
+    }
 
-        // Set channel count
-        if ((error = snd_pcm_hw_params_set_channels(handle, params, channels)) < 0)
+    if (scan)
+    {
+        // metadata only: index the tree without decoding or opening the audio device
+        try
         {
-            std::cerr << "Cannot set channel count: " << snd_strerror(error) << "\n";
-            snd_pcm_close(handle);
+            std::ofstream index_file;
+            if (!index_path.empty())
+            {
+                index_file.open(index_path);
+                if (!index_file)
+                {
+                    std::cerr << "Error: cannot write " << index_path << '\n';
+                    return 1;
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            mc::Library_scan_stats stats = mc::scan_library(filenames.front(), index_path.empty() ? std::cout : index_file, scan_threads);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::cerr << "Indexed " << stats.files << " files (" << stats.failed << " failed) in " << stats.directories
+                      << " directories in " << seconds << " s, " << stats.reads << " reads, "
+                      << stats.bytes_read / 1024 << " KiB read\n";
+            return stats.failed == 0 ? 0 : 1;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << '\n';
             return 1;
         }
+    }
 
-        // Set sample rate
-        unsigned int actual_rate = sample_rate;
-        if ((error = snd_pcm_hw_params_set_rate_near(handle, params, &actual_rate, 0)) < 0)
+    try
+    {
+        if (!decode_path.empty())
         {
-            std::cerr << "Cannot set sample rate: " << snd_strerror(error) << "\n";
-            snd_pcm_close(handle);
-            return 1;
+            // offline conversion: the container follows the extension, anything but .wav is raw PCM
+            mc::Decode_file_options options;
+            options.type = decode_path.ends_with(".wav") || decode_path.ends_with(".WAV") ? mc::Pcm_file_type::WAV : mc::Pcm_file_type::RAW;
+            options.direct_io = direct_io;
+            options.crc_policy = crc_policy;
+            options.verify_md5 = verify;
+            options.cue_track = static_cast<uint8_t>(cue_track);
+
+            mc::Decode_file_stats stats = mc::decode_to_file(filenames.front(), decode_path, options);
+            double audio_seconds = stats.sample_rate > 0 ? static_cast<double>(stats.samples) / stats.sample_rate : 0;
+            std::cerr << "Decoded " << audio_seconds << " s of audio to " << decode_path << " (" << stats.bytes_written / (1024.0 * 1024.0)
+                      << " MiB" << (stats.direct_io ? ", O_DIRECT" : "") << ") in " << stats.seconds << " s: "
+                      << audio_seconds / stats.seconds << "x realtime, " << stats.bytes_written / (1024.0 * 1024.0) / stats.seconds
+                      << " MiB/s, " << stats.write_stalls << " write stalls\n";
+            print_decode_errors(stats.decode_errors);
+            if (verify)
+            {
+                std::cout << filenames.front() << ": "
+                          << (stats.md5_status == Md5_status::MATCH          ? "MD5 OK"
+                              : stats.md5_status == Md5_status::MISMATCH     ? "MD5 MISMATCH"
+                              : stats.md5_status == Md5_status::NO_SIGNATURE ? "no MD5 signature to check"
+                                                                             : "not fully decoded")
+                          << '\n';
+                return stats.md5_status == Md5_status::MATCH || stats.md5_status == Md5_status::NO_SIGNATURE ? 0 : 1;
+            }
+            return 0;
         }
 
-        // Set buffer size
-        snd_pcm_uframes_t buffer_size = sample_rate; // 1 second buffer
-        if ((error = snd_pcm_hw_params_set_buffer_size_near(handle, params, &buffer_size)) < 0)
+        // decoder statistics per file, written as JSON Lines once decoding is over
+        std::ofstream stats_file;
+        if (!stats_path.empty())
         {
-            std::cerr << "Cannot set buffer size: " << snd_strerror(error) << "\n";
-            snd_pcm_close(handle);
-            return 1;
+            stats_file.open(stats_path);
+            if (!stats_file)
+            {
+                throw std::runtime_error("Cannot write " + stats_path);
+            }
         }
 
-        // Apply hardware parameters
-        if ((error = snd_pcm_hw_params(handle, params)) < 0)
+        if (verify)
         {
-            std::cerr << "Cannot set parameters: " << snd_strerror(error) << "\n";
-            snd_pcm_close(handle);
-            return 1;
+            int result = 0;
+            std::string entries;
+            for (const std::string &filename : filenames)
+            {
+                mc::Decode_stats stats;
+                result |= verify_file(filename, crc_policy, stats_file.is_open() ? &stats : nullptr);
+                append_stats_entry(entries, filename, stats);
+            }
+            if (stats_file.is_open())
+            {
+                stats_file << entries;
+            }
+            return result;
         }
 
-        // Main playback loop
-        while (!player.get_reader().eos())
+        // every track is opened in the background while the one before it plays
+        mc::Playlist playlist(filenames, crc_policy, static_cast<uint8_t>(cue_track));
+        std::unique_ptr<mc::Decode_stats[]> track_stats;
+        if (stats_file.is_open() || live_stats)
+        {
+            track_stats = std::make_unique<mc::Decode_stats[]>(filenames.size());
+        }
+        mc::Output_stats output_stats;
+        bool more = playlist.advance();
+        bool first = true;
+        while (more)
         {
-            player.decode_frame();
-            std::vector<int32_t> buffer = convert_to_32bit(player.get_audio_buffer());
+            mc::Flac &player = playlist.get_decoder();
+            uint32_t sample_rate = player.get_stream_info().sample_rate;
+            uint8_t channels = player.get_stream_info().channels;
+            uint8_t bit_depth = player.get_stream_info().bits_per_sample;
+
+            // Sample format: the narrowest one that holds the stream's bit depth
+            Pcm_format pcm_format = bit_depth <= 16 ? Pcm_format::S16_LE : bit_depth <= 24 ? Pcm_format::S24_3LE : Pcm_format::S32_LE;
+            mc::Alsa_output output("default", pcm_format, channels, sample_rate);
+            size_t device_bits = pcm_format_bytes(output.get_format()) * 8;
+            if (output.get_sample_rate() != sample_rate)
+            {
+                std::cerr << "Resampling " << sample_rate << " Hz to " << output.get_sample_rate() << " Hz\n";
+            }
 
-            snd_pcm_sframes_t frames = snd_pcm_writei(handle, buffer.data(), buffer.size() / channels);
+            size_t track_number = playlist.get_track_number();
+            print_now_playing(playlist.get_entry(track_number));
+            if (track_stats)
+            {
+                player.set_stats(&track_stats[track_number - 1]);
+            }
 
-            if (frames < 0)
+            // tracks the open device can play follow without a gap; any other one reopens it
+            mc::Playback_tracks tracks;
+            tracks.next = [&]() -> mc::Flac *
             {
-                frames = snd_pcm_recover(handle, frames, 0);
-                if (frames < 0)
+                const Stream_info *next = playlist.peek_next();
+                if (next == nullptr || next->sample_rate != sample_rate || next->channels != channels || next->bits_per_sample > device_bits)
+                {
+                    return nullptr;
+                }
+                playlist.advance();
+                if (track_stats)
                 {
-                    std::cerr << "Write failed: " << snd_strerror(frames) << "\n";
-                    break;
+                    playlist.get_decoder().set_stats(&track_stats[playlist.get_track_number() - 1]);
                 }
+                return &playlist.get_decoder();
+            };
+            tracks.started = [&]
+            { print_now_playing(playlist.get_entry(++track_number)); };
+
+            config.start_sample = first ? static_cast<uint64_t>(start_seconds * sample_rate) : 0;
+            first = false;
+
+            // Decode on a separate thread, feeding the device through a ring of periods
+            mc::Playback_engine engine(player, output, config, tracks);
+
+            // the counters are only read here, so the live view costs the decoder nothing
+            auto show_stats = [&](std::stop_token stop)
+            {
+                for (size_t tick = 1; !stop.stop_requested(); tick++)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    if (tick % 10 == 0)
+                    {
+                        mc::Decode_stats decode;
+                        for (size_t i = 0; i < filenames.size(); i++)
+                        {
+                            decode.add(track_stats[i]);
+                        }
+                        mc::Output_stats writes;
+                        writes.add(output_stats);
+                        writes.add(output.get_stats());
+                        print_live_stats(decode, writes, sample_rate);
+                    }
+                }
+            };
+            std::jthread live_view;
+            if (live_stats)
+            {
+                live_view = std::jthread(show_stats);
             }
+            engine.run();
+            output.drain();
+            if (live_view.joinable())
+            {
+                live_view.request_stop();
+                live_view.join();
+                std::cerr << '\n';
+            }
+            output_stats.add(output.get_stats());
+
+            mc::Playback_stats stats = engine.get_stats();
+            if (stats.ring_underruns > 0 || stats.device_underruns > 0)
+            {
+                std::cerr << "Underruns: " << stats.ring_underruns << " ring, " << stats.device_underruns << " device"
+                          << " (lowest ring occupancy " << stats.min_ring_occupancy << "/" << stats.ring_capacity << ")\n";
+            }
+            more = !engine.stopped() && playlist.advance();
         }
+        print_decode_errors(playlist.get_decode_errors());
 
-        // Drain the buffer and close
-        snd_pcm_drain(handle);
-        snd_pcm_close(handle);
+        if (stats_file.is_open())
+        {
+            std::string entries;
+            for (size_t track = 1; track <= playlist.get_track_number(); track++)
+            {
+                append_stats_entry(entries, playlist.get_entry(track).path, track_stats[track - 1]);
+            }
+            entries += "{\"output\":";
+            mc::append_stats_json(entries, output_stats);
+            entries += "}\n";
+            stats_file << entries;
+        }
+
+        for (const auto &[path, error] : playlist.get_failures())
+        {
+            std::cerr << "Skipped " << path << ": " << error << '\n';
+        }
+        if (!playlist.get_failures().empty())
+        {
+            return 1;
+        }
     }
     catch (const std::exception &e)
     {
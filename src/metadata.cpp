@@ -0,0 +1,169 @@
+#include "metadata.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void mc::read_stream_info(Buffered_bit_reader &reader, Stream_info &stream_info)
+{
+    stream_info.min_block_size = reader.read_bits_unsigned(16);
+    stream_info.max_block_size = reader.read_bits_unsigned(16);
+    stream_info.min_frame_size = reader.read_bits_unsigned(24);
+    stream_info.max_frame_size = reader.read_bits_unsigned(24);
+    stream_info.sample_rate = reader.read_bits_unsigned(20);
+    stream_info.channels = reader.read_bits_unsigned(3) + 1;
+    stream_info.bits_per_sample = reader.read_bits_unsigned(5) + 1;
+    stream_info.total_samples = reader.read_bits_unsigned(36);
+
+    reader.read_bytes(stream_info.md5_signature.data(), stream_info.md5_signature.size());
+}
+
+void mc::read_vorbis_comment(Buffered_bit_reader &reader, Metadata_arena &arena, Vorbis_comment &vorbis_comment)
+{
+    uint32_t vendor_length = reader.read_uint32_le();
+
+    std::span<const uint8_t> vendor_data = reader.read_view(vendor_length);
+    vorbis_comment.vendor_string = arena.store({reinterpret_cast<const char *>(vendor_data.data()), vendor_data.size()});
+
+    uint32_t user_comment_count = reader.read_uint32_le();
+
+    vorbis_comment.user_comments.clear();
+    for (uint32_t i = 0; i < user_comment_count; i++)
+    {
+        uint32_t comment_length = reader.read_uint32_le();
+
+        std::span<const uint8_t> comment_data = reader.read_view(comment_length);
+        std::string_view comment(reinterpret_cast<const char *>(comment_data.data()), comment_data.size());
+
+        size_t delimiter_pos = comment.find('=');
+        if (delimiter_pos != std::string_view::npos)
+        {
+            comment = arena.store(comment);
+            vorbis_comment.user_comments.emplace_back(comment.substr(0, delimiter_pos), comment.substr(delimiter_pos + 1));
+        }
+    }
+}
+
+void mc::read_picture(Buffered_bit_reader &reader, Metadata_arena &arena, uint64_t block_offset, uint32_t block_length, Picture &picture)
+{
+    // type, two string lengths, four dimensions and the data length
+    constexpr uint64_t fixed_size = 32;
+    uint64_t start = reader.byte_position();
+
+    picture.type = reader.read_bits_unsigned(32);
+
+    uint32_t mime_length = reader.read_bits_unsigned(32);
+    if (fixed_size + mime_length > block_length)
+    {
+        throw std::runtime_error("PICTURE block has inconsistent lengths");
+    }
+    std::span<const uint8_t> mime_data = reader.read_view(mime_length);
+    picture.mime_type = arena.store({reinterpret_cast<const char *>(mime_data.data()), mime_data.size()});
+
+    uint32_t description_length = reader.read_bits_unsigned(32);
+    if (fixed_size + mime_length + description_length > block_length)
+    {
+        throw std::runtime_error("PICTURE block has inconsistent lengths");
+    }
+    std::span<const uint8_t> description_data = reader.read_view(description_length);
+    picture.description = arena.store({reinterpret_cast<const char *>(description_data.data()), description_data.size()});
+
+    picture.width = reader.read_bits_unsigned(32);
+    picture.height = reader.read_bits_unsigned(32);
+    picture.color_depth = reader.read_bits_unsigned(32);
+    picture.color_count = reader.read_bits_unsigned(32);
+    picture.data_length = reader.read_bits_unsigned(32);
+
+    uint64_t header_length = reader.byte_position() - start;
+    if (header_length + picture.data_length > block_length)
+    {
+        throw std::runtime_error("PICTURE block has inconsistent lengths");
+    }
+    picture.data_offset = block_offset + header_length;
+}
+
+void mc::read_cue_sheet(Buffered_bit_reader &reader, Metadata_arena &arena, uint32_t block_length, Cue_sheet &cue_sheet)
+{
+    // catalog number, lead-in, flags and reserved bytes, track count; then the sizes per track and index point
+    constexpr uint64_t header_size = 396;
+    constexpr uint64_t track_size = 36;
+    constexpr uint64_t index_size = 12;
+
+    auto trim = [](std::span<const uint8_t> bytes)
+    {
+        std::string_view text(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+        return text.substr(0, text.find('\0'));
+    };
+
+    if (block_length < header_size)
+    {
+        throw std::runtime_error("CUESHEET block is too short");
+    }
+    cue_sheet.media_catalog_number = arena.store(trim(reader.read_view(128)));
+    cue_sheet.lead_in_samples = reader.read_bits_unsigned(64);
+    cue_sheet.is_cd = reader.read_bits_unsigned(1);
+    reader.read_bits_unsigned(7);
+    reader.skip_bytes(258);
+    uint8_t track_count = reader.read_bits_unsigned(8);
+
+    uint64_t size = header_size;
+    cue_sheet.tracks.clear();
+    cue_sheet.tracks.reserve(track_count);
+    for (uint8_t i = 0; i < track_count; i++)
+    {
+        size += track_size;
+        if (size > block_length)
+        {
+            throw std::runtime_error("CUESHEET tracks exceed the block");
+        }
+        Cue_track &track = cue_sheet.tracks.emplace_back();
+        track.offset = reader.read_bits_unsigned(64);
+        track.number = reader.read_bits_unsigned(8);
+        track.isrc = arena.store(trim(reader.read_view(12)));
+        track.audio = reader.read_bits_unsigned(1) == 0;
+        track.pre_emphasis = reader.read_bits_unsigned(1);
+        reader.read_bits_unsigned(6);
+        reader.skip_bytes(13);
+        uint8_t index_count = reader.read_bits_unsigned(8);
+
+        size += index_size * index_count;
+        if (size > block_length)
+        {
+            throw std::runtime_error("CUESHEET index points exceed the block");
+        }
+        track.indices.resize(index_count);
+        for (Cue_index &index : track.indices)
+        {
+            index.offset = reader.read_bits_unsigned(64);
+            index.number = reader.read_bits_unsigned(8);
+            reader.skip_bytes(3);
+        }
+    }
+    reader.skip_bytes(block_length - size);
+}
+
+bool mc::find_cue_track(const Cue_sheet &cue_sheet, uint8_t track_number, uint64_t &first_sample, uint64_t &end_sample)
+{
+    auto start_of = [](const Cue_track &track, bool proper)
+    {
+        if (track.indices.empty())
+        {
+            return track.offset;
+        }
+        auto index = std::find_if(track.indices.begin(), track.indices.end(), [](const Cue_index &point)
+                                  { return point.number == 1; });
+        return track.offset + (proper && index != track.indices.end() ? index->offset : track.indices.front().offset);
+    };
+
+    // the last entry is the lead-out, which ends the last track
+    for (size_t i = 0; i + 1 < cue_sheet.tracks.size(); i++)
+    {
+        const Cue_track &track = cue_sheet.tracks[i];
+        if (track.number == track_number && track.audio)
+        {
+            first_sample = start_of(track, true);
+            end_sample = start_of(cue_sheet.tracks[i + 1], false);
+            return first_sample < end_sample;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,482 @@
+#include "predictors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MC_X86_SIMD 1
+#endif
+
+namespace
+{
+    using Lpc_kernel_32 = void (*)(int32_t *, size_t, const int32_t *, uint8_t);
+    using Lpc_kernel_64 = void (*)(int64_t *, size_t, const int32_t *, uint8_t);
+    using Lpc_kernel_table = std::array<Lpc_kernel_32, 32>;
+
+    // The accumulator widths are only safe for samples within the subframe bit depth. A
+    // damaged residual breaks that before the CRC-16 is checked, so all sums are taken in
+    // unsigned arithmetic, which wraps like the hardware instead of being undefined.
+    template <typename Sample, typename Value>
+    inline Sample add_wrapping(Sample sample, Value prediction)
+    {
+        using Unsigned = std::make_unsigned_t<Sample>;
+        return static_cast<Sample>(static_cast<Unsigned>(sample) + static_cast<Unsigned>(prediction));
+    }
+
+    template <typename Sample, typename Accumulator, uint8_t Order>
+    void restore_lpc_order(Sample *samples, size_t count, const int32_t *coefficients, uint8_t shift)
+    {
+        using Unsigned = std::make_unsigned_t<Accumulator>;
+        Unsigned c[Order];
+        for (uint8_t j = 0; j < Order; j++)
+        {
+            c[j] = static_cast<Unsigned>(static_cast<Accumulator>(coefficients[j]));
+        }
+
+        for (size_t i = Order; i < count; i++)
+        {
+            Unsigned prediction{};
+            for (uint8_t j = 0; j < Order; j++)
+            {
+                prediction += c[j] * static_cast<Unsigned>(static_cast<Accumulator>(samples[i - 1 - j]));
+            }
+            samples[i] = add_wrapping(samples[i], static_cast<Accumulator>(prediction) >> shift);
+        }
+    }
+
+    template <typename Sample, typename Accumulator>
+    void restore_fixed_order(Sample *samples, size_t count, uint8_t order)
+    {
+        // closed forms of Flac_constants::fixed_prediction_coefficients
+        using A = std::make_unsigned_t<Accumulator>;
+        auto a = [](Sample sample)
+        { return static_cast<A>(static_cast<Accumulator>(sample)); };
+        switch (order)
+        {
+        case 1:
+            for (size_t i = 1; i < count; i++)
+            {
+                samples[i] = add_wrapping(samples[i], samples[i - 1]);
+            }
+            break;
+        case 2:
+            for (size_t i = 2; i < count; i++)
+            {
+                samples[i] = add_wrapping(samples[i], 2 * a(samples[i - 1]) - a(samples[i - 2]));
+            }
+            break;
+        case 3:
+            for (size_t i = 3; i < count; i++)
+            {
+                samples[i] = add_wrapping(samples[i], 3 * (a(samples[i - 1]) - a(samples[i - 2])) + a(samples[i - 3]));
+            }
+            break;
+        case 4:
+            for (size_t i = 4; i < count; i++)
+            {
+                samples[i] = add_wrapping(samples[i], 4 * (a(samples[i - 1]) + a(samples[i - 3])) -
+                                                          6 * a(samples[i - 2]) - a(samples[i - 4]));
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    template <typename Sample, typename Accumulator, size_t... Orders>
+    constexpr auto make_lpc_table(std::index_sequence<Orders...>)
+    {
+        return std::array<void (*)(Sample *, size_t, const int32_t *, uint8_t), sizeof...(Orders)>{
+            &restore_lpc_order<Sample, Accumulator, Orders + 1>...};
+    }
+
+    constexpr Lpc_kernel_table scalar_narrow_kernels = make_lpc_table<int32_t, int32_t>(std::make_index_sequence<32>{});
+    constexpr Lpc_kernel_table scalar_wide_kernels = make_lpc_table<int32_t, int64_t>(std::make_index_sequence<32>{});
+    constexpr std::array<Lpc_kernel_64, 32> scalar_64bit_kernels = make_lpc_table<int64_t, int64_t>(std::make_index_sequence<32>{});
+
+#ifdef MC_X86_SIMD
+    // The SIMD kernels handle the three newest taps in scalar code and keep the samples
+    // of the older taps in registers, oldest first, multiplied with the reversed
+    // coefficients. The vector part of a prediction then only depends on samples that
+    // are at least three iterations old, which keeps the multiply and horizontal sum off
+    // the loop-carried dependency. Missing lanes are padded with zero coefficients.
+    constexpr uint8_t scalar_taps = 3;
+
+    template <uint8_t Order, size_t Lanes>
+    void load_reversed_history(const int32_t *samples, const int32_t *coefficients, int32_t *reversed, int32_t *history)
+    {
+        constexpr size_t padded = (Order - scalar_taps + Lanes - 1) / Lanes * Lanes;
+        for (size_t k = 0; k < padded; k++)
+        {
+            reversed[k] = 0;
+            history[k] = 0;
+        }
+        for (size_t j = scalar_taps; j < Order; j++)
+        {
+            reversed[padded - 1 - (j - scalar_taps)] = coefficients[j];
+            history[padded - 1 - (j - scalar_taps)] = samples[Order - 1 - j];
+        }
+    }
+
+    template <uint8_t Order>
+    __attribute__((target("sse4.1"))) void restore_lpc_order_sse41(int32_t *samples, size_t count, const int32_t *coefficients, uint8_t shift)
+    {
+        constexpr size_t vectors = (Order - scalar_taps + 3) / 4;
+
+        alignas(16) int32_t reversed[vectors * 4];
+        alignas(16) int32_t initial[vectors * 4];
+        load_reversed_history<Order, 4>(samples, coefficients, reversed, initial);
+
+        __m128i c[vectors];
+        __m128i history[vectors];
+        for (size_t v = 0; v < vectors; v++)
+        {
+            c[v] = _mm_load_si128(reinterpret_cast<const __m128i *>(reversed + v * 4));
+            history[v] = _mm_load_si128(reinterpret_cast<const __m128i *>(initial + v * 4));
+        }
+
+        const uint32_t c0 = coefficients[0], c1 = coefficients[1], c2 = coefficients[2];
+        int32_t s1 = samples[Order - 1], s2 = samples[Order - 2], s3 = samples[Order - 3];
+
+        for (size_t i = Order; i < count; i++)
+        {
+            __m128i sum = _mm_mullo_epi32(c[0], history[0]);
+            for (size_t v = 1; v < vectors; v++)
+            {
+                sum = _mm_add_epi32(sum, _mm_mullo_epi32(c[v], history[v]));
+            }
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+            uint32_t prediction = static_cast<uint32_t>(_mm_cvtsi128_si32(sum)) + c2 * static_cast<uint32_t>(s3) +
+                                  c1 * static_cast<uint32_t>(s2) + c0 * static_cast<uint32_t>(s1);
+            int32_t value = add_wrapping(samples[i], static_cast<int32_t>(prediction) >> shift);
+            samples[i] = value;
+
+            for (size_t v = 0; v + 1 < vectors; v++)
+            {
+                history[v] = _mm_alignr_epi8(history[v + 1], history[v], 4);
+            }
+            history[vectors - 1] = _mm_alignr_epi8(_mm_cvtsi32_si128(s3), history[vectors - 1], 4);
+            s3 = s2;
+            s2 = s1;
+            s1 = value;
+        }
+    }
+
+    template <uint8_t Order>
+    __attribute__((target("avx2"))) void restore_lpc_order_avx2(int32_t *samples, size_t count, const int32_t *coefficients, uint8_t shift)
+    {
+        constexpr size_t vectors = (Order - scalar_taps + 7) / 8;
+
+        alignas(32) int32_t reversed[vectors * 8];
+        alignas(32) int32_t initial[vectors * 8];
+        load_reversed_history<Order, 8>(samples, coefficients, reversed, initial);
+
+        __m256i c[vectors];
+        __m256i history[vectors];
+        for (size_t v = 0; v < vectors; v++)
+        {
+            c[v] = _mm256_load_si256(reinterpret_cast<const __m256i *>(reversed + v * 8));
+            history[v] = _mm256_load_si256(reinterpret_cast<const __m256i *>(initial + v * 8));
+        }
+
+        const uint32_t c0 = coefficients[0], c1 = coefficients[1], c2 = coefficients[2];
+        int32_t s1 = samples[Order - 1], s2 = samples[Order - 2], s3 = samples[Order - 3];
+
+        for (size_t i = Order; i < count; i++)
+        {
+            __m256i sum = _mm256_mullo_epi32(c[0], history[0]);
+            for (size_t v = 1; v < vectors; v++)
+            {
+                sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(c[v], history[v]));
+            }
+            __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+
+            uint32_t prediction = static_cast<uint32_t>(_mm_cvtsi128_si32(half)) + c2 * static_cast<uint32_t>(s3) +
+                                  c1 * static_cast<uint32_t>(s2) + c0 * static_cast<uint32_t>(s1);
+            int32_t value = add_wrapping(samples[i], static_cast<int32_t>(prediction) >> shift);
+            samples[i] = value;
+
+            // shift every vector down by one lane, pulling in the oldest lane of the next one
+            for (size_t v = 0; v + 1 < vectors; v++)
+            {
+                __m256i crossed = _mm256_permute2x128_si256(history[v], history[v + 1], 0x21);
+                history[v] = _mm256_alignr_epi8(crossed, history[v], 4);
+            }
+            __m256i newest = _mm256_castsi128_si256(_mm_cvtsi32_si128(s3));
+            __m256i crossed = _mm256_permute2x128_si256(history[vectors - 1], newest, 0x21);
+            history[vectors - 1] = _mm256_alignr_epi8(crossed, history[vectors - 1], 4);
+            s3 = s2;
+            s2 = s1;
+            s1 = value;
+        }
+    }
+
+    // 64-bit accumulator variants: every lane holds one sign-extended sample, of which
+    // _mm_mul_epi32 multiplies the low 32 bits into a 64-bit product.
+    template <uint8_t Order>
+    __attribute__((target("sse4.1"))) void restore_lpc_order_wide_sse41(int32_t *samples, size_t count, const int32_t *coefficients, uint8_t shift)
+    {
+        constexpr size_t vectors = (Order - scalar_taps + 1) / 2;
+
+        alignas(16) int32_t reversed[vectors * 2];
+        alignas(16) int32_t initial[vectors * 2];
+        load_reversed_history<Order, 2>(samples, coefficients, reversed, initial);
+
+        __m128i c[vectors];
+        __m128i history[vectors];
+        for (size_t v = 0; v < vectors; v++)
+        {
+            c[v] = _mm_set_epi64x(reversed[v * 2 + 1], reversed[v * 2]);
+            history[v] = _mm_set_epi64x(initial[v * 2 + 1], initial[v * 2]);
+        }
+
+        const int64_t c0 = coefficients[0], c1 = coefficients[1], c2 = coefficients[2];
+        int64_t s1 = samples[Order - 1], s2 = samples[Order - 2], s3 = samples[Order - 3];
+
+        for (size_t i = Order; i < count; i++)
+        {
+            __m128i sum = _mm_mul_epi32(c[0], history[0]);
+            for (size_t v = 1; v < vectors; v++)
+            {
+                sum = _mm_add_epi64(sum, _mm_mul_epi32(c[v], history[v]));
+            }
+            sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+
+            int64_t prediction = _mm_cvtsi128_si64(sum) + c2 * s3 + c1 * s2 + c0 * s1;
+            int32_t value = add_wrapping(samples[i], prediction >> shift);
+            samples[i] = value;
+
+            for (size_t v = 0; v + 1 < vectors; v++)
+            {
+                history[v] = _mm_alignr_epi8(history[v + 1], history[v], 8);
+            }
+            history[vectors - 1] = _mm_alignr_epi8(_mm_cvtsi64_si128(s3), history[vectors - 1], 8);
+            s3 = s2;
+            s2 = s1;
+            s1 = value;
+        }
+    }
+
+    template <uint8_t Order>
+    __attribute__((target("avx2"))) void restore_lpc_order_wide_avx2(int32_t *samples, size_t count, const int32_t *coefficients, uint8_t shift)
+    {
+        constexpr size_t vectors = (Order - scalar_taps + 3) / 4;
+
+        alignas(32) int32_t reversed[vectors * 4];
+        alignas(32) int32_t initial[vectors * 4];
+        load_reversed_history<Order, 4>(samples, coefficients, reversed, initial);
+
+        __m256i c[vectors];
+        __m256i history[vectors];
+        for (size_t v = 0; v < vectors; v++)
+        {
+            c[v] = _mm256_cvtepi32_epi64(_mm_load_si128(reinterpret_cast<const __m128i *>(reversed + v * 4)));
+            history[v] = _mm256_cvtepi32_epi64(_mm_load_si128(reinterpret_cast<const __m128i *>(initial + v * 4)));
+        }
+
+        const int64_t c0 = coefficients[0], c1 = coefficients[1], c2 = coefficients[2];
+        int64_t s1 = samples[Order - 1], s2 = samples[Order - 2], s3 = samples[Order - 3];
+
+        for (size_t i = Order; i < count; i++)
+        {
+            __m256i sum = _mm256_mul_epi32(c[0], history[0]);
+            for (size_t v = 1; v < vectors; v++)
+            {
+                sum = _mm256_add_epi64(sum, _mm256_mul_epi32(c[v], history[v]));
+            }
+            __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            half = _mm_add_epi64(half, _mm_unpackhi_epi64(half, half));
+
+            int64_t prediction = _mm_cvtsi128_si64(half) + c2 * s3 + c1 * s2 + c0 * s1;
+            int32_t value = add_wrapping(samples[i], prediction >> shift);
+            samples[i] = value;
+
+            for (size_t v = 0; v + 1 < vectors; v++)
+            {
+                __m256i crossed = _mm256_permute2x128_si256(history[v], history[v + 1], 0x21);
+                history[v] = _mm256_alignr_epi8(crossed, history[v], 8);
+            }
+            __m256i newest = _mm256_castsi128_si256(_mm_cvtsi64_si128(s3));
+            __m256i crossed = _mm256_permute2x128_si256(history[vectors - 1], newest, 0x21);
+            history[vectors - 1] = _mm256_alignr_epi8(crossed, history[vectors - 1], 8);
+            s3 = s2;
+            s2 = s1;
+            s1 = value;
+        }
+    }
+
+    // Below these orders the next lower level is as fast or faster.
+    // The thresholds come from bench/prediction_bench.cpp.
+    constexpr uint8_t sse41_min_order = 8;
+    constexpr uint8_t avx2_min_order = 28;
+    constexpr uint8_t wide_sse41_min_order = 8;
+    constexpr uint8_t wide_avx2_min_order = 12;
+    static_assert(std::min({sse41_min_order, avx2_min_order, wide_sse41_min_order, wide_avx2_min_order}) > scalar_taps);
+
+    template <size_t Order>
+    constexpr Lpc_kernel_32 sse41_kernel(bool wide)
+    {
+        if (wide)
+        {
+            if constexpr (Order >= wide_sse41_min_order)
+            {
+                return &restore_lpc_order_wide_sse41<Order>;
+            }
+            return scalar_wide_kernels[Order - 1];
+        }
+        if constexpr (Order >= sse41_min_order)
+        {
+            return &restore_lpc_order_sse41<Order>;
+        }
+        return scalar_narrow_kernels[Order - 1];
+    }
+
+    template <size_t Order>
+    constexpr Lpc_kernel_32 avx2_kernel(bool wide)
+    {
+        if (wide)
+        {
+            if constexpr (Order >= wide_avx2_min_order)
+            {
+                return &restore_lpc_order_wide_avx2<Order>;
+            }
+            return sse41_kernel<Order>(true);
+        }
+        if constexpr (Order >= avx2_min_order)
+        {
+            return &restore_lpc_order_avx2<Order>;
+        }
+        return sse41_kernel<Order>(false);
+    }
+
+    template <size_t... Orders>
+    constexpr Lpc_kernel_table make_sse41_table(bool wide, std::index_sequence<Orders...>)
+    {
+        return {sse41_kernel<Orders + 1>(wide)...};
+    }
+
+    template <size_t... Orders>
+    constexpr Lpc_kernel_table make_avx2_table(bool wide, std::index_sequence<Orders...>)
+    {
+        return {avx2_kernel<Orders + 1>(wide)...};
+    }
+
+    constexpr Lpc_kernel_table sse41_narrow_kernels = make_sse41_table(false, std::make_index_sequence<32>{});
+    constexpr Lpc_kernel_table sse41_wide_kernels = make_sse41_table(true, std::make_index_sequence<32>{});
+    constexpr Lpc_kernel_table avx2_narrow_kernels = make_avx2_table(false, std::make_index_sequence<32>{});
+    constexpr Lpc_kernel_table avx2_wide_kernels = make_avx2_table(true, std::make_index_sequence<32>{});
+#endif
+
+    struct Lpc_kernels
+    {
+        const Lpc_kernel_table *narrow; ///< 32-bit accumulator kernels
+        const Lpc_kernel_table *wide;   ///< 64-bit accumulator kernels
+    };
+
+    Lpc_kernels kernels_for(mc::Simd_level level)
+    {
+#ifdef MC_X86_SIMD
+        switch (level)
+        {
+        case mc::Simd_level::AVX2:
+            return {&avx2_narrow_kernels, &avx2_wide_kernels};
+        case mc::Simd_level::SSE4_1:
+            return {&sse41_narrow_kernels, &sse41_wide_kernels};
+        default:
+            break;
+        }
+#endif
+        (void)level;
+        return {&scalar_narrow_kernels, &scalar_wide_kernels};
+    }
+
+    mc::Simd_level g_simd_level = mc::detect_simd_level();
+    Lpc_kernels g_kernels = kernels_for(g_simd_level);
+} // namespace
+
+mc::Simd_level mc::detect_simd_level()
+{
+#ifdef MC_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Simd_level::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return Simd_level::SSE4_1;
+    }
+#endif
+    return Simd_level::SCALAR;
+}
+
+mc::Simd_level mc::get_simd_level()
+{
+    return g_simd_level;
+}
+
+void mc::set_simd_level(Simd_level level)
+{
+    g_simd_level = std::min(level, detect_simd_level());
+    g_kernels = kernels_for(g_simd_level);
+}
+
+void mc::restore_fixed(int32_t *samples, size_t count, uint8_t order, uint8_t bits_per_sample)
+{
+    // the largest fixed predictor sums 16 times the sample magnitude
+    if (bits_per_sample + 4 < 32)
+    {
+        restore_fixed_order<int32_t, int32_t>(samples, count, order);
+    }
+    else
+    {
+        restore_fixed_order<int32_t, int64_t>(samples, count, order);
+    }
+}
+
+void mc::restore_fixed(int64_t *samples, size_t count, uint8_t order)
+{
+    restore_fixed_order<int64_t, int64_t>(samples, count, order);
+}
+
+void mc::restore_lpc(int32_t *samples, size_t count, const int32_t *coefficients, uint8_t order,
+                     uint8_t shift, uint8_t bits_per_sample)
+{
+    if (order == 0 || order > 32)
+    {
+        return;
+    }
+
+    // |prediction| <= sum(|coefficient|) * 2^(bits_per_sample - 1), which has to stay below 2^31
+    uint64_t coefficient_magnitude = 0;
+    for (uint8_t j = 0; j < order; j++)
+    {
+        coefficient_magnitude += static_cast<uint64_t>(std::abs(static_cast<int64_t>(coefficients[j])));
+    }
+
+    if (bits_per_sample < 32 && coefficient_magnitude < (1ULL << (32 - bits_per_sample)))
+    {
+        (*g_kernels.narrow)[order - 1](samples, count, coefficients, shift);
+    }
+    else
+    {
+        (*g_kernels.wide)[order - 1](samples, count, coefficients, shift);
+    }
+}
+
+void mc::restore_lpc(int64_t *samples, size_t count, const int32_t *coefficients, uint8_t order, uint8_t shift)
+{
+    if (order == 0 || order > 32)
+    {
+        return;
+    }
+    scalar_64bit_kernels[order - 1](samples, count, coefficients, shift);
+}
@@ -0,0 +1,129 @@
+#include "Flac.hpp"
+#include "Flac_decoder.hpp"
+#include "frame_scanner.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <vector>
+
+#ifndef FLAC_TEST_AUDIO_DIR
+#define FLAC_TEST_AUDIO_DIR "audio/input"
+#endif
+
+/**
+ * Seeks under Crc_policy::SKIP in files with one damaged frame and checks the samples
+ * found there against an undamaged decode. Frames dropped during the forward decode
+ * of a seek must not shift the position of the frames after them.
+ */
+
+std::vector<uint8_t> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), {}};
+}
+
+/**
+ * Decodes the whole stream into interleaved samples.
+ */
+std::vector<int32_t> decode_all(std::span<const uint8_t> data)
+{
+    mc::Flac decoder(data);
+    decoder.initialize();
+    std::vector<int32_t> samples;
+    while (!decoder.eos())
+    {
+        decoder.decode_frame();
+        const auto &buffer = decoder.get_audio_buffer();
+        samples.insert(samples.end(), buffer.begin(), buffer.end());
+    }
+    return samples;
+}
+
+/**
+ * Decodes a damaged stream from the start and marks the samples that survive.
+ */
+std::vector<bool> surviving_samples(std::span<const uint8_t> data)
+{
+    mc::Flac decoder(data);
+    decoder.initialize();
+    decoder.set_crc_policy(Crc_policy::SKIP);
+    const Stream_info &info = decoder.get_stream_info();
+    std::vector<bool> present(info.total_samples);
+    while (!decoder.eos())
+    {
+        decoder.decode_frame();
+        const Frame_info &frame = decoder.get_frame_info();
+        uint64_t first = frame.blocking_strategy ? frame.frame_or_sample_number : frame.frame_or_sample_number * info.max_block_size;
+        std::fill_n(present.begin() + first, frame.block_size, true);
+    }
+    return present;
+}
+
+int main()
+{
+    int failures = 0;
+    for (const char *name : {"8bit.flac", "12bit.flac", "16bit.flac", "24bit.flac"})
+    {
+        std::vector<uint8_t> data = read_file(std::string(FLAC_TEST_AUDIO_DIR "/") + name);
+        std::vector<int32_t> reference = decode_all(data);
+
+        mc::Flac probe(data);
+        probe.initialize();
+        uint8_t channels = probe.get_stream_info().channels;
+        size_t frames_offset = probe.get_reader().byte_position();
+        std::vector<mc::Frame_location> frames = mc::scan_frames(std::span(data).subspan(frames_offset), probe.get_stream_info());
+
+        for (size_t damaged : {size_t(1), frames.size() / 3, frames.size() / 2, frames.size() - 2})
+        {
+            // break the frame's CRC-16 without touching its header
+            std::vector<uint8_t> copy = data;
+            const mc::Frame_location &frame = frames[damaged];
+            copy[frames_offset + frame.offset + frame.size / 2] ^= 0x01;
+            std::vector<bool> present = surviving_samples(copy);
+
+            mc::Flac decoder(copy);
+            decoder.initialize();
+            decoder.set_crc_policy(Crc_policy::SKIP);
+            mc::Flac_decoder pcm_decoder;
+            pcm_decoder.open(copy, Pcm_format::S16_LE, Crc_policy::SKIP);
+
+            // into the damaged frame and every sample of the two frames after it, wherever they survive
+            const mc::Frame_location &last = frames[damaged + 1];
+            for (uint64_t target = frame.first_sample + 1; target < last.first_sample + last.block_size; target += 97)
+            {
+                // a dropped target lands on the next sample that survived
+                uint64_t expected = std::find(present.begin() + target, present.end(), true) - present.begin();
+                if (expected == present.size())
+                {
+                    continue;
+                }
+
+                uint16_t offset = decoder.seek_to_sample(target);
+                const auto &buffer = decoder.get_audio_buffer();
+                size_t count = buffer.size() - offset * channels;
+                if (count == 0 || expected * channels + count > reference.size() ||
+                    !std::equal(buffer.begin() + offset * channels, buffer.end(), reference.begin() + expected * channels))
+                {
+                    std::printf("%s: seek to %llu with frame %zu damaged gave wrong samples\n", name,
+                                static_cast<unsigned long long>(target), damaged);
+                    failures++;
+                }
+
+                pcm_decoder.seek(target);
+                if (pcm_decoder.tell() != expected)
+                {
+                    std::printf("%s: seek to %llu with frame %zu damaged told %llu instead of %llu\n", name,
+                                static_cast<unsigned long long>(target), damaged,
+                                static_cast<unsigned long long>(pcm_decoder.tell()), static_cast<unsigned long long>(expected));
+                    failures++;
+                }
+            }
+        }
+    }
+
+    std::printf("%s\n", failures == 0 ? "All seeks OK" : "Seeks FAILED");
+    return failures == 0 ? 0 : 1;
+}